@@ -11,6 +11,8 @@ uniform int       hasColorTexture;
 uniform int       hasMetallicTexture;
 uniform int       hasRoughnessTexture;
 uniform int       hasNormalTexture;
+uniform int       roughnessChannel; // 1 when packed with metallic
+uniform int       normalTextureChannels; // 2 when Z must be reconstructed
 uniform sampler2D colorTexture;
 uniform sampler2D metallicTexture;
 uniform sampler2D roughnessTexture;
@@ -77,8 +79,12 @@ void main() {
     vec3  normalSample = vec3(0, 0, 1);
     if(hasColorTexture != 0) colorSample *= texture(colorTexture, interpTexCoord0);
     if(hasMetallicTexture != 0) metallicSample *= texture(metallicTexture, interpTexCoord0).x;
-    if(hasRoughnessTexture != 0) roughnessSample *= texture(roughnessTexture, interpTexCoord0).x;
-    if(hasNormalTexture != 0) normalSample = texture(normalTexture, interpTexCoord0).xyz * 2.0 - 1.0;
+    if(hasRoughnessTexture != 0) roughnessSample *= texture(roughnessTexture, interpTexCoord0)[roughnessChannel];
+    if(hasNormalTexture != 0) {
+        normalSample = texture(normalTexture, interpTexCoord0).xyz * 2.0 - 1.0;
+        if(normalTextureChannels == 2)
+            normalSample.z = sqrt(max(0.0, 1.0 - dot(normalSample.xy, normalSample.xy)));
+    }
     mat3 TBN = mat3(interpTangent.xyz, cross(interpNormal, interpTangent.xyz) * interpTangent.w, interpNormal);
     vec3 L = normalize(lightDir);
     vec3 N = normalize(TBN * normalSample);
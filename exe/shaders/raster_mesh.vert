@@ -3,15 +3,54 @@ layout(location = 0) in vec4 vertexPosition;
 layout(location = 1) in vec2 vertexTexCoord0;
 layout(location = 2) in vec3 vertexNormal;
 layout(location = 3) in vec4 vertexTangent;
+layout(location = 4) in vec3 instanceColumn0;
+layout(location = 5) in vec3 instanceColumn1;
+layout(location = 6) in vec3 instanceColumn2;
+layout(location = 7) in vec3 instanceColumn3;
 out vec3 interpVertexPosition;
 out vec2 interpVertexTexCoord0;
 out vec3 interpVertexNormal;
 out vec4 interpVertexTangent;
+
+// Set for rtrtool::QuantizedMesh attributes: positions are unorm16 within the
+// mesh bounds and normals and tangents octahedral encoded
+uniform bool quantized;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+// Set for Mesh::drawInstanced(), where each copy has its own mat4x3 applied
+// before the modelView transform
+uniform bool instanced;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
 void main()
 {
-    interpVertexPosition = vertexPosition.xyz;
+    vec3 position = vertexPosition.xyz;
+    vec3 normal = vertexNormal;
+    vec4 tangent = vertexTangent;
+    if (quantized)
+    {
+        position = positionOffset + positionScale * vertexPosition.xyz;
+        normal = octDecode(vertexNormal.xy);
+        tangent = vec4(octDecode(vertexTangent.xy), vertexTangent.z);
+    }
+    if (instanced)
+    {
+        mat3 linear = mat3(instanceColumn0, instanceColumn1, instanceColumn2);
+        position = linear * position + instanceColumn3;
+        normal = normalize(transpose(inverse(linear)) * normal);
+        tangent.xyz = normalize(linear * tangent.xyz);
+    }
+    interpVertexPosition = position;
     interpVertexTexCoord0 = vertexTexCoord0;
-    interpVertexNormal = vertexNormal;
-    interpVertexTangent = vertexTangent;
-    gl_Position = vertexPosition;
+    interpVertexNormal = normal;
+    interpVertexTangent = tangent;
+    gl_Position = vec4(position, 1.0);
 }
@@ -68,6 +68,11 @@ void App::Impl::renderloop()
     glDebugMessageCallback(defaultDebugCallbackPrintStderr, 0);
     glEnable(GL_DEBUG_OUTPUT);
 
+    // Meshlet culling and level of detail results from the previous frame
+    glraii::ClusterCullStats cullStats;
+    size_t                   lodTriangles = 0;
+    size_t                   fullTriangles = 0;
+
     while(!glfwWindowShouldClose(m_window))
     {
         glfwPollEvents();
@@ -107,6 +112,21 @@ void App::Impl::renderloop()
         ImGui::Checkbox("Demo Window", &showDemoWindow);
 
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+        static bool cullClusters = true;
+        ImGui::Checkbox("Cull meshlets", &cullClusters);
+        // Materials do not record whether they are double sided, so back
+        // faces, and with them backfacing meshlets, are only culled on request
+        static bool cullBackfaces = false;
+        ImGui::Checkbox("Cull back faces", &cullBackfaces);
+        if (cullClusters)
+            ImGui::Text("Meshlets: %zu drawn, %zu offscreen, %zu backfacing", cullStats.drawn,
+                        cullStats.offscreen, cullStats.backfacing);
+        static bool  useLods = true;
+        static float lodPixelError = 1.0f;
+        ImGui::Checkbox("Levels of detail", &useLods);
+        ImGui::SliderFloat("LOD pixel error", &lodPixelError, 0.1f, 16.0f, "%.1f",
+                           ImGuiSliderFlags_Logarithmic);
+        ImGui::Text("Triangles: %zu of %zu at full detail", lodTriangles, fullTriangles);
         ImGui::End();
 
         if (showDemoWindow)
@@ -118,21 +138,37 @@ void App::Impl::renderloop()
         glClearColor(0.231f, 0.231f, 0.231f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glEnable(GL_DEPTH_TEST);
+        if (cullBackfaces)
+            glEnable(GL_CULL_FACE);
+        else
+            glDisable(GL_CULL_FACE);
 
         glUseProgram(meshProgram);
         auto worldToEye = camera.worldToEye();
+        cullStats = {};
+        lodTriangles = 0;
+        fullTriangles = 0;
+        const float pixelsPerUnit = display_h / (2.0f * tanf(projection.fovY * 0.5f));
         meshProgram.setUniform("lightDir", glm::mat3(camera.worldToEye()) * glm::vec3(1.0f));
         for(const auto& scene : m_scenes)
         {
-            for (const auto& instance : scene.instances()) {
-                auto localToEye = worldToEye * instance.localToWorld;
+            // Sets the transform, mesh decoding and material uniforms shared by
+            // plain and instanced draws
+            auto setupDraw = [&](const glm::mat4& localToEye, uint32_t meshIndex,
+                                 uint32_t materialIndex, bool instanced) -> const glraii::Mesh& {
                 meshProgram.setUniform("modelView", localToEye);
                 meshProgram.setUniform("modelViewProjection", projection.matrix() * localToEye);
                 meshProgram.setUniform("normalMatrix",
                                        glm::inverse(glm::transpose(glm::mat3(localToEye))));
+                // Mirroring transforms reverse the winding of front faces
+                glFrontFace(glm::determinant(glm::mat3(localToEye)) < 0.0f ? GL_CW : GL_CCW);
 
-                const glraii::Mesh& mesh = scene.meshes()[instance.meshIndex];
-                const rtr::common::Material& material = scene.materials()[instance.materialIndex];
+                const glraii::Mesh& mesh = scene.meshes()[meshIndex];
+                const rtr::common::Material& material = scene.materials()[materialIndex];
+                meshProgram.setUniform("instanced", instanced ? 1 : 0);
+                meshProgram.setUniform("quantized", mesh.quantized() ? 1 : 0);
+                meshProgram.setUniform("positionOffset", mesh.positionOffset());
+                meshProgram.setUniform("positionScale", mesh.positionScale());
                 auto bindTexture = [&meshProgram, &scene](uint32_t bindingIndex, const std::string& uniformHasName, const std::string& uniformSamplerName, rtr::optional_index32 sceneIndex)
                 {
                     meshProgram.setUniform(uniformHasName, sceneIndex ? 1 : 0);
@@ -149,10 +185,65 @@ void App::Impl::renderloop()
                 bindTexture(1, "hasMetallicTexture", "metallicTexture", material.textures.metallic);
                 bindTexture(2, "hasRoughnessTexture", "roughnessTexture", material.textures.roughness);
                 bindTexture(3, "hasNormalTexture", "normalTexture", material.textures.normal);
+                // Metallic and roughness share a texture when packed by the
+                // converter, with roughness in the second channel. Separate
+                // single channel textures with equal content may also have
+                // been merged into one, which is read from the first channel.
+                bool packedMetallicRoughness =
+                    material.textures.metallic && material.textures.roughness &&
+                    *material.textures.metallic == *material.textures.roughness &&
+                    scene.textureChannels()[*material.textures.roughness] >= 2;
+                meshProgram.setUniform("roughnessChannel", packedMetallicRoughness ? 1 : 0);
+                // BC5 normal maps only store XY
+                meshProgram.setUniform(
+                    "normalTextureChannels",
+                    material.textures.normal
+                        ? GLint(scene.textureChannels()[*material.textures.normal])
+                        : 3);
                 meshProgram.setUniform("color", material.factors.color);
                 meshProgram.setUniform("metallic", material.factors.metallic);
                 meshProgram.setUniform("roughness", material.factors.roughness);
-                mesh.draw();
+                return mesh;
+            };
+
+            for (const auto& instance : scene.instances()) {
+                auto localToEye = worldToEye * instance.localToWorld;
+                const glraii::Mesh& mesh =
+                    setupDraw(localToEye, instance.meshIndex, instance.materialIndex, false);
+                // Simplified levels index the full mesh's vertices but not its
+                // meshlets, so only the full mesh is drawn with culling
+                size_t lod = useLods ? mesh.selectLod(localToEye, pixelsPerUnit, projection.near,
+                                                      lodPixelError)
+                                     : 0;
+                lodTriangles += mesh.lodTriangles(lod);
+                fullTriangles += mesh.lodTriangles(0);
+                if (lod != 0)
+                    mesh.drawLod(lod);
+                else if (cullClusters)
+                    mesh.drawClusters(localToEye, projection.matrix(), cullBackfaces, cullStats);
+                else
+                    mesh.draw();
+            }
+
+            // Each copy's transform is applied in the vertex shader, so groups
+            // are drawn at full detail without culling. The front face is
+            // shared by all copies, so groups mixing mirrored and unmirrored
+            // copies are drawn without culling back faces.
+            for (const auto& group : scene.instanceGroups()) {
+                glm::mat4           localToEye = worldToEye * group.localToWorld;
+                const glraii::Mesh& mesh =
+                    setupDraw(localToEye, group.meshIndex, group.materialIndex, true);
+                bool mirrored = glm::determinant(glm::mat3(localToEye)) < 0.0f;
+                if (group.mirroredCount == group.count)
+                    glFrontFace(mirrored ? GL_CCW : GL_CW);
+                bool mixed = group.mirroredCount != 0 && group.mirroredCount != group.count;
+                if (mixed && cullBackfaces)
+                    glDisable(GL_CULL_FACE);
+                lodTriangles += mesh.lodTriangles(0) * size_t(group.count);
+                fullTriangles += mesh.lodTriangles(0) * size_t(group.count);
+                mesh.drawInstanced(scene.instanceBuffers()[group.bufferIndex], group.count);
+                if (mixed && cullBackfaces)
+                    glEnable(GL_CULL_FACE);
             }
         }
 
@@ -4,6 +4,7 @@
 #include <glad/gl.h>
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <app.hpp>
 #include <camera.hpp>
 #include <condition_variable>
@@ -12,12 +13,20 @@
 #include <looper.hpp>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <rtr/material.hpp>
 #include <rtr/mesh.hpp>
 #include <rtr/scene.hpp>
 #include <rtrtool/file.hpp>
+#include <rtrtool/instancing.hpp>
+#include <rtrtool/lods.hpp>
+#include <rtrtool/mesh_indices.hpp>
+#include <rtrtool/meshlets.hpp>
+#include <rtrtool/quantized_mesh.hpp>
+#include <rtrtool/world_transforms.hpp>
 #include <stdexcept>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 class Scene {
@@ -29,29 +38,96 @@ public:
           m_sceneHeader(m_file->findSupported<rtr::SceneHeader>()) {
         if(!m_meshHeader || !m_materialHeader || !m_sceneHeader)
             throw std::runtime_error("file missing required rtr headers");
-        for (const auto& mesh : m_meshHeader->meshes) {
-            m_meshes.emplace_back(mesh);
+        // Optional sub-headers. Compact triangles replace the mesh's own and
+        // must be used.
+        auto*  quantizedHeader = m_file->findSupported<rtrtool::QuantizedMeshHeader>();
+        auto*  indicesHeader = m_file->findSupported<rtrtool::MeshIndicesHeader>();
+        auto*  meshletHeader = m_file->findSupported<rtrtool::MeshletHeader>();
+        auto*  lodHeader = m_file->findSupported<rtrtool::LodHeader>();
+        size_t meshCount = m_meshHeader->meshes.size();
+        if ((quantizedHeader && quantizedHeader->meshes.size() != meshCount) ||
+            (indicesHeader && indicesHeader->meshes.size() != meshCount) ||
+            (meshletHeader && meshletHeader->meshes.size() != meshCount) ||
+            (lodHeader && lodHeader->meshes.size() != meshCount))
+            throw std::runtime_error("rtrtool mesh sub-header count does not match");
+        for (size_t i = 0; i < meshCount; ++i) {
+            m_meshes.emplace_back(
+                m_meshHeader->meshes[i],
+                glraii::MeshExtras{
+                    .quantized = quantizedHeader ? &quantizedHeader->meshes[i] : nullptr,
+                    .indices = indicesHeader ? &indicesHeader->meshes[i] : nullptr,
+                    .meshlets = meshletHeader ? &meshletHeader->meshes[i] : nullptr,
+                    .lods = lodHeader ? &lodHeader->meshes[i] : nullptr,
+                });
         }
         for (const auto& texture : m_materialHeader->textures) {
             m_textures.emplace_back(glraii::uploadTexture(*texture.ktx));
+            m_textureChannels.push_back(glraii::textureChannels(*texture.ktx));
         }
         m_instances.reserve(m_sceneHeader->instances.size());
-        for(auto& instance : m_sceneHeader->instances)
-        {
-            auto*     node = &m_sceneHeader->nodes[instance.node];
+
+        // Use flattened transforms when the file has them. Otherwise each
+        // instance walks up to its root.
+        auto*    worldHeader = m_file->findSupported<rtrtool::WorldTransformHeader>();
+        uint32_t firstRoot =
+            m_sceneHeader->scenes.size()
+                ? uint32_t(&*m_sceneHeader->scenes[0] - &m_sceneHeader->nodes[0])
+                : 0;
+        if (worldHeader && worldHeader->roots.size() != worldHeader->transforms.size())
+            throw std::runtime_error("rtrtool world transform count does not match");
+        // Instances from anything other than the first scene are ignored by
+        // checking if the instance's node's root is the first scene's root.
+        auto localToWorld = [&](uint32_t nodeIndex) -> std::optional<glm::mat4> {
+            if (worldHeader) {
+                if (nodeIndex >= worldHeader->transforms.size())
+                    throw std::runtime_error("rtrtool instance node has no world transform");
+                if (worldHeader->roots[nodeIndex] != firstRoot)
+                    return std::nullopt;
+                return worldHeader->transforms[nodeIndex];
+            }
+            auto*     node = &m_sceneHeader->nodes[nodeIndex];
             glm::mat4 transform = node->transform;
-            // Inefficient traversal to the root for each instance
             while (node->parentOffset) {
                 node -= *node->parentOffset;
                 transform = node->transform * transform;
             }
-            // Ignore instances from anything other than the first scene by
-            // checking if the instance's node's root is the first scene's root.
             if (node != &*m_sceneHeader->scenes[0])
-                continue;
-            m_instances.push_back({.meshIndex = instance.mesh,
-                                   .materialIndex = instance.material,
-                                   .localToWorld = transform});
+                return std::nullopt;
+            return transform;
+        };
+        for(auto& instance : m_sceneHeader->instances)
+        {
+            if (auto transform = localToWorld(instance.node))
+                m_instances.push_back({.meshIndex = instance.mesh,
+                                       .materialIndex = instance.material,
+                                       .localToWorld = *transform});
+        }
+
+        // GPU instanced copies, uploaded once per transform array as groups
+        // from one node's primitives share them
+        if (auto* instancingHeader = m_file->findSupported<rtrtool::InstancingHeader>()) {
+            std::unordered_map<const glm::mat4x3*, std::pair<size_t, GLsizei>> buffers;
+            for (const rtrtool::InstanceGroup& group : instancingHeader->groups) {
+                auto transform = localToWorld(group.instance.node);
+                if (!transform || !group.transforms.size())
+                    continue;
+                auto [it, created] =
+                    buffers.try_emplace(group.transforms.data(), m_instanceBuffers.size(), 0);
+                if (created) {
+                    m_instanceBuffers.emplace_back(std::span<const glm::mat4x3>(
+                        group.transforms.data(), group.transforms.size()));
+                    it->second.second = GLsizei(
+                        std::ranges::count_if(group.transforms, [](const glm::mat4x3& copy) {
+                            return glm::determinant(glm::mat3(copy)) < 0.0f;
+                        }));
+                }
+                m_instanceGroups.push_back({.meshIndex = group.instance.mesh,
+                                            .materialIndex = group.instance.material,
+                                            .localToWorld = *transform,
+                                            .bufferIndex = it->second.first,
+                                            .count = GLsizei(group.transforms.size()),
+                                            .mirroredCount = it->second.second});
+            }
         }
     }
 
@@ -62,15 +138,34 @@ public:
         glm::mat4 localToWorld;
     };
 
+    // Drawn with Mesh::drawInstanced(), each copy transformed by a mat4x3 in
+    // instanceBuffers()[bufferIndex] before localToWorld. mirroredCount copies
+    // have a negative scale, which reverses their winding.
+    struct InstanceGroup
+    {
+        uint32_t  meshIndex;
+        uint32_t  materialIndex;
+        glm::mat4 localToWorld;
+        size_t    bufferIndex;
+        GLsizei   count;
+        GLsizei   mirroredCount;
+    };
+
     std::span<const glraii::Mesh>          meshes() const { return m_meshes; }
     std::span<const glraii::Texture>       textures() const { return m_textures; }
+    std::span<const uint32_t>              textureChannels() const { return m_textureChannels; }
     std::span<const rtr::common::Material> materials() const { return m_materialHeader->materials; }
     std::span<const Instance>              instances() const { return m_instances; }
+    std::span<const InstanceGroup>         instanceGroups() const { return m_instanceGroups; }
+    std::span<const glraii::Buffer>        instanceBuffers() const { return m_instanceBuffers; }
 
 private:
     std::vector<glraii::Mesh>    m_meshes;
     std::vector<glraii::Texture> m_textures;
+    std::vector<uint32_t>        m_textureChannels;
     std::vector<Instance>        m_instances;
+    std::vector<InstanceGroup>   m_instanceGroups;
+    std::vector<glraii::Buffer>  m_instanceBuffers;
     rtrtool::File                m_file;
     rtr::common::MeshHeader*     m_meshHeader;
     rtr::common::MaterialHeader* m_materialHeader;
@@ -8,6 +8,36 @@
 
 namespace glraii {
 
+// BC, ETC and ASTC formats are contiguous in VkFormat
+inline bool isBlockCompressed(VkFormat vkFormat) {
+    return vkFormat >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && vkFormat <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK;
+}
+
+// Number of channels stored in the texture, for the formats rtrtool writes
+inline uint32_t textureChannels(const rtr::ktx::Header& header) {
+    switch (static_cast<VkFormat>(header.vkFormat)) {
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R16_UNORM:
+    case VK_FORMAT_R32_UINT:
+    case VK_FORMAT_R32_SFLOAT:
+        return 1;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R32G32_UINT:
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 2;
+    case VK_FORMAT_R8G8B8_UNORM:
+    case VK_FORMAT_R16G16B16_UNORM:
+    case VK_FORMAT_R32G32B32_UINT:
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
 inline Texture uploadTexture(const rtr::ktx::Header& header) {
     if (!header.validateIdentifier())
         throw std::runtime_error("KTX texture failed validation");
@@ -16,12 +46,19 @@ inline Texture uploadTexture(const rtr::ktx::Header& header) {
     GLenum format = vkFormat2glFormat(vkFormat);
     GLenum dataType = vkFormat2glType(vkFormat);
     Texture result(GL_TEXTURE_2D, header.levelCount, internalFormat, header.pixelWidth, header.pixelHeight, header.pixelDepth);
+    // KTX rows are tightly packed, which matters for small mip levels
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    bool  compressed = isBlockCompressed(vkFormat);
     GLint level = 0;
     for (const auto& raw : header.levelsRaw()) {
         GLsizei levelWidth = std::max(1u, header.pixelWidth >> level);
         GLsizei levelHeight = std::max(1u, header.pixelHeight >> level);
-        glTextureSubImage2D(result, level++, 0, 0, levelWidth, levelHeight, format, dataType,
-                            raw.data());
+        if (compressed)
+            glCompressedTextureSubImage2D(result, level++, 0, 0, levelWidth, levelHeight,
+                                          internalFormat, GLsizei(raw.size()), raw.data());
+        else
+            glTextureSubImage2D(result, level++, 0, 0, levelWidth, levelHeight, format, dataType,
+                                raw.data());
     }
     if (header.levelsRaw().size() > 1)
         glTextureParameteri(result, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -1,5 +1,7 @@
 // Copyright (c) 2024 Pyarelal Knowles, MIT License
 
+#include <algorithm>
+#include <array>
 #include <glmesh.hpp>
 #include <mikktspace.h>
 #include <stdexcept>
@@ -10,10 +12,20 @@ inline MeshAux& udatMesh(const SMikkTSpaceContext* pContext) {
     return *reinterpret_cast<MeshAux*>(pContext->m_pUserData);
 }
 
-MeshAux::MeshAux(const rtr::common::Mesh& mesh)
+MeshAux::MeshAux(const rtr::common::Mesh& mesh, const rtrtool::MeshIndices* indices)
     : m_mesh(mesh) {
-    if (!m_mesh.triangleVertices.size())
+    bool replacedTriangles = indices && indices->triangleCount && !m_mesh.triangleVertices.size();
+    if (!m_mesh.triangleVertices.size() && !replacedTriangles)
         throw std::runtime_error("cannot generate topology");
+    if (replacedTriangles && (!m_mesh.vertexNormals.size() || !m_mesh.vertexTangents.size())) {
+        m_triangleVertices.resize(indices->triangleCount);
+        if (indices->encoded.size())
+            rtrtool::decodeTriangles(indices->encoded, m_triangleVertices);
+        else
+            std::ranges::transform(indices->triangles16, m_triangleVertices.begin(),
+                                   [](const glm::u16vec3& t) { return glm::uvec3(t); });
+        m_mesh.triangleVertices = m_triangleVertices;
+    }
     if (!m_mesh.vertexPositions.size())
         throw std::runtime_error("cannot generate positions");
     if (!m_mesh.vertexTexCoords0.size()) {
@@ -84,4 +96,197 @@ MeshAux::MeshAux(const rtr::common::Mesh& mesh)
     }
 }
 
+IndicesAux::IndicesAux(const rtr::common::Mesh& mesh, const MeshExtras& extras) {
+    const rtrtool::MeshIndices* indices = extras.indices;
+    bool                        narrow = mesh.vertexPositions.size() <= 65536;
+    if (extras.meshlets) {
+        const rtrtool::MeshletMesh& meshlets = *extras.meshlets;
+
+        auto expand = [&meshlets](auto& triangles) {
+            triangles.reserve(meshlets.triangles.size());
+            for (const rtrtool::Meshlet& meshlet : meshlets.meshlets) {
+                const uint32_t* vertices = &meshlets.vertices[meshlet.vertexOffset];
+                for (uint32_t i = 0; i < meshlet.triangleCount; ++i) {
+                    glm::u8vec3 local = meshlets.triangles[meshlet.triangleOffset + i];
+                    triangles.emplace_back(vertices[local.x], vertices[local.y], vertices[local.z]);
+                }
+            }
+        };
+        if (narrow) {
+            expand(m_triangles16);
+            m_data = std::as_bytes(std::span<const glm::u16vec3>(m_triangles16));
+            m_type = GL_UNSIGNED_SHORT;
+        } else {
+            expand(m_triangles32);
+            m_data = std::as_bytes(std::span<const glm::uvec3>(m_triangles32));
+        }
+        m_count = GLsizei(meshlets.triangles.size() * 3);
+    } else if (indices && indices->triangles16.size()) {
+        m_data = std::as_bytes(std::span<const glm::u16vec3>(indices->triangles16));
+        m_type = GL_UNSIGNED_SHORT;
+        m_count = GLsizei(indices->triangles16.size() * 3);
+    } else if (indices && indices->encoded.size()) {
+        if (narrow) {
+            m_triangles16.resize(indices->triangleCount);
+            rtrtool::decodeTriangles(indices->encoded, m_triangles16);
+            m_data = std::as_bytes(std::span<const glm::u16vec3>(m_triangles16));
+            m_type = GL_UNSIGNED_SHORT;
+        } else {
+            m_triangles32.resize(indices->triangleCount);
+            rtrtool::decodeTriangles(indices->encoded, m_triangles32);
+            m_data = std::as_bytes(std::span<const glm::uvec3>(m_triangles32));
+        }
+        m_count = GLsizei(indices->triangleCount * 3);
+    } else {
+        m_data = std::as_bytes(std::span<const glm::uvec3>(mesh.triangleVertices));
+        m_count = GLsizei(mesh.triangleVertices.size() * 3);
+    }
+}
+
+std::vector<Mesh::Cluster> Mesh::clusters(const rtrtool::MeshletMesh& meshlets) {
+    std::vector<Cluster> result;
+    result.reserve(meshlets.meshlets.size());
+    for (const rtrtool::Meshlet& meshlet : meshlets.meshlets)
+        result.push_back(Cluster{.center = meshlet.center,
+                                 .radius = meshlet.radius,
+                                 .coneAxis = meshlet.coneAxis,
+                                 .coneCutoff = meshlet.coneCutoff,
+                                 .firstIndex = GLsizei(meshlet.triangleOffset * 3),
+                                 .indexCount = GLsizei(meshlet.triangleCount * 3)});
+    return result;
+}
+
+void Mesh::drawClusters(const glm::mat4& localToEye, const glm::mat4& projection,
+                        bool cullBackfaces, ClusterCullStats& stats) const {
+    if (m_clusters.empty()) {
+        draw();
+        return;
+    }
+
+    // View frustum planes in eye space, from the projection matrix rows.
+    // Normalized so distances can be compared with radii.
+    glm::vec4 row3(projection[0][3], projection[1][3], projection[2][3], projection[3][3]);
+
+    std::array<glm::vec4, 6> planes;
+    for (int i = 0; i < 3; ++i) {
+        glm::vec4 row(projection[0][i], projection[1][i], projection[2][i], projection[3][i]);
+        planes[i * 2] = row3 + row;
+        planes[i * 2 + 1] = row3 - row;
+    }
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+
+    // Meshlet bounds are in mesh space
+    glm::mat3 linear(localToEye);
+    float     radiusScale = std::max(
+        {glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+    rtrtool::MeshletBackfaceTest backfacing(localToEye);
+
+    std::vector<GLsizei>     counts;
+    std::vector<const void*> offsets;
+    size_t                   indexBytes = m_indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    for (const Cluster& cluster : m_clusters) {
+        glm::vec3 center(localToEye * glm::vec4(cluster.center, 1.0f));
+        float     radius = cluster.radius * radiusScale;
+        if (std::ranges::any_of(planes, [&](const glm::vec4& plane) {
+                return glm::dot(glm::vec3(plane), center) + plane.w < -radius;
+            })) {
+            stats.offscreen++;
+            continue;
+        }
+        if (cullBackfaces && backfacing(center, radius, cluster.coneAxis, cluster.coneCutoff)) {
+            stats.backfacing++;
+            continue;
+        }
+        counts.push_back(cluster.indexCount);
+        offsets.push_back(reinterpret_cast<const void*>(size_t(cluster.firstIndex) * indexBytes));
+    }
+    stats.drawn += counts.size();
+    if (counts.empty())
+        return;
+    glBindVertexArray(m_vertexArray);
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), m_indexType, offsets.data(),
+                        GLsizei(counts.size()));
+    glBindVertexArray(0);
+}
+
+void Mesh::drawInstanced(const Buffer& transforms, GLsizei count) const {
+    // Per-instance columns follow the mesh's attributes 0 to 3 and are
+    // disabled again so plain draws of the same vertex array ignore them
+    constexpr GLuint binding = 4;
+    glVertexArrayVertexBuffer(m_vertexArray, binding, transforms, 0, sizeof(glm::mat4x3));
+    glVertexArrayBindingDivisor(m_vertexArray, binding, 1);
+    for (GLuint column = 0; column < 4; ++column) {
+        GLuint location = binding + column;
+        glVertexArrayAttribFormat(m_vertexArray, location, 3, GL_FLOAT, GL_FALSE,
+                                  column * sizeof(glm::vec3));
+        glVertexArrayAttribBinding(m_vertexArray, location, binding);
+        glEnableVertexArrayAttrib(m_vertexArray, location);
+    }
+    glBindVertexArray(m_vertexArray);
+    glDrawElementsInstanced(GL_TRIANGLES, m_indexCount, m_indexType, (void*)0, count);
+    glBindVertexArray(0);
+    for (GLuint column = 0; column < 4; ++column)
+        glDisableVertexArrayAttrib(m_vertexArray, binding + column);
+}
+
+void Mesh::setLods(const rtrtool::MeshLods& lods) {
+    std::vector<glm::uvec3> triangles;
+    for (const rtrtool::MeshLod& level : lods.levels) {
+        m_lods.push_back(Lod{.error = level.error,
+                             .firstIndex = GLsizei(triangles.size() * 3),
+                             .indexCount = GLsizei(level.triangles.size() * 3)});
+        triangles.insert(triangles.end(), level.triangles.begin(), level.triangles.end());
+    }
+    if (!triangles.empty())
+        m_lodElementBuffer.emplace(triangles);
+}
+
+void Mesh::setBounds(std::span<const glm::vec3> positions) {
+    if (positions.empty())
+        return;
+    glm::vec3 lo = positions[0];
+    glm::vec3 hi = lo;
+    for (const glm::vec3& p : positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    m_boundsCenter = (lo + hi) * 0.5f;
+    for (const glm::vec3& p : positions)
+        m_boundsRadius = std::max(m_boundsRadius, glm::length(p - m_boundsCenter));
+}
+
+size_t Mesh::selectLod(const glm::mat4& localToEye, float pixelsPerUnit, float near,
+                       float maxPixelError) const {
+    if (m_lods.empty())
+        return 0;
+
+    // Errors are in mesh units. The largest axis scale keeps the estimate
+    // conservative under non-uniform scale.
+    glm::mat3 linear(localToEye);
+    float     scale =
+        std::max({glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+    glm::vec3 center(localToEye * glm::vec4(m_boundsCenter, 1.0f));
+    float     distance = std::max(glm::length(center) - m_boundsRadius * scale, near);
+    float     pixelsPerError = scale * pixelsPerUnit / distance;
+    size_t    level = 0;
+    while (level < m_lods.size() && m_lods[level].error * pixelsPerError <= maxPixelError)
+        ++level;
+    return level;
+}
+
+void Mesh::drawLod(size_t level) const {
+    if (level == 0) {
+        draw();
+        return;
+    }
+    const Lod& lod = m_lods[level - 1];
+    glVertexArrayElementBuffer(m_vertexArray, *m_lodElementBuffer);
+    glBindVertexArray(m_vertexArray);
+    glDrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                   reinterpret_cast<const void*>(size_t(lod.firstIndex) * sizeof(uint32_t)));
+    glBindVertexArray(0);
+    glVertexArrayElementBuffer(m_vertexArray, m_elementBuffer);
+}
+
 } // namespace glraii
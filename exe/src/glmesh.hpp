@@ -6,6 +6,12 @@
 #include <glm/glm.hpp>
 #include <globjects.hpp>
 #include <rtr/mesh.hpp>
+#include <optional>
+#include <rtrtool/lods.hpp>
+#include <rtrtool/mesh_indices.hpp>
+#include <rtrtool/meshlets.hpp>
+#include <rtrtool/quantized_mesh.hpp>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
@@ -13,7 +19,9 @@ namespace glraii {
 
 struct MeshAux {
 public:
-    MeshAux(const rtr::common::Mesh& mesh);
+    // Triangles in 'indices', if given and not in the mesh, are only decoded
+    // when normals or tangents need to be generated
+    MeshAux(const rtr::common::Mesh& mesh, const rtrtool::MeshIndices* indices = nullptr);
     const rtr::common::Mesh& operator*() const { return m_mesh; };
     const rtr::common::Mesh* operator->() const { return &m_mesh; };
 
@@ -25,43 +33,188 @@ private:
     rtr::common::Mesh m_mesh;
 };
 
+// A mesh's entries in the optional rtrtool sub-headers, where the file has them
+struct MeshExtras {
+    const rtrtool::QuantizedMesh* quantized = nullptr;
+    const rtrtool::MeshIndices*   indices = nullptr;
+    const rtrtool::MeshletMesh*   meshlets = nullptr;
+    const rtrtool::MeshLods*      lods = nullptr;
+};
+
+// Element data from the mesh's 32-bit triangles or, where it has been
+// replaced, 16-bit or encoded triangles in rtrtool::MeshIndices. Encoded
+// triangles are decoded to 16-bit when the mesh has few enough vertices. With
+// meshlets, triangles are expanded from them instead so each meshlet is a
+// contiguous range.
+struct IndicesAux {
+public:
+    IndicesAux(const rtr::common::Mesh& mesh, const MeshExtras& extras);
+    std::span<const std::byte> data() const { return m_data; }
+    GLenum                     type() const { return m_type; }
+    GLsizei                    count() const { return m_count; }
+
+private:
+    std::vector<glm::uvec3>    m_triangles32;
+    std::vector<glm::u16vec3>  m_triangles16;
+    std::span<const std::byte> m_data;
+    GLenum                     m_type = GL_UNSIGNED_INT;
+    GLsizei                    m_count = 0;
+};
+
+// Meshlets rejected or drawn by Mesh::drawClusters()
+struct ClusterCullStats {
+    size_t drawn = 0;
+    size_t offscreen = 0;
+    size_t backfacing = 0;
+};
+
 class Mesh {
 public:
-    Mesh(const rtr::common::Mesh& mesh)
-        : m_mesh(mesh),
-          m_elementBuffer(m_mesh->triangleVertices),
-          m_vertexPositions(m_mesh->vertexPositions),
-          m_vertexTexCoords0(m_mesh->vertexTexCoords0),
-          m_vertexNormals(m_mesh->vertexNormals),
-          m_vertexTangents(m_mesh->vertexTangents),
+    // Quantized vertex arrays are uploaded as normalized and half float
+    // attributes, which the shader decodes when quantized() is set. Files
+    // converted without normals or tangents, e.g. with --no-generate-tangents,
+    // take the full precision path so they can be generated.
+    Mesh(const rtr::common::Mesh& mesh, const MeshExtras& extras = {})
+        : Mesh(completeQuantized(extras)
+                   ? Mesh(IndicesAux(mesh, extras), *extras.quantized)
+                   : Mesh(MeshAux(mesh, extras.indices), IndicesAux(mesh, extras))) {
+        if (extras.meshlets)
+            m_clusters = clusters(*extras.meshlets);
+        if (extras.lods)
+            setLods(*extras.lods);
+        setBounds(mesh.vertexPositions);
+    }
+    void draw() const {
+        glBindVertexArray(m_vertexArray);
+        glDrawElements(GL_TRIANGLES, m_indexCount, m_indexType, (void*)0);
+        glBindVertexArray(0);
+    }
+
+    // Draws 'count' copies, each transformed by a glm::mat4x3 from
+    // 'transforms' in the vertex shader when its instanced uniform is set.
+    // Levels of detail and meshlet culling are not applied.
+    void drawInstanced(const Buffer& transforms, GLsizei count) const;
+
+    // Draws only the meshlets inside the view frustum and, with
+    // cullBackfaces, those that may face the camera. Draws everything if the
+    // mesh has no meshlets. Backfacing meshlets must only be skipped when
+    // back faces are also culled, as double sided surfaces show them.
+    void drawClusters(const glm::mat4& localToEye, const glm::mat4& projection, bool cullBackfaces,
+                      ClusterCullStats& stats) const;
+
+    // Picks the coarsest level of detail whose error, projected at the
+    // nearest point of the mesh's bounding sphere, is at most maxPixelError.
+    // pixelsPerUnit is the projected size of one unit at distance one, e.g.
+    // height / (2 * tan(fovY / 2)). Zero is the full mesh.
+    size_t selectLod(const glm::mat4& localToEye, float pixelsPerUnit, float near,
+                     float maxPixelError) const;
+
+    // Draws a level from selectLod()
+    void drawLod(size_t level) const;
+
+    // Triangles drawn by drawLod()
+    size_t lodTriangles(size_t level) const {
+        return size_t(level == 0 ? m_indexCount : m_lods[level - 1].indexCount) / 3;
+    }
+
+    bool      quantized() const { return m_quantized; }
+    glm::vec3 positionOffset() const { return m_positionOffset; }
+    glm::vec3 positionScale() const { return m_positionScale; }
+
+private:
+    // Culling data and element range of a meshlet
+    struct Cluster {
+        glm::vec3 center;
+        float     radius;
+        glm::vec3 coneAxis;
+        float     coneCutoff;
+        GLsizei   firstIndex;
+        GLsizei   indexCount;
+    };
+    static std::vector<Cluster> clusters(const rtrtool::MeshletMesh& meshlets);
+
+    // True if every vertex attribute has a quantized array
+    static bool completeQuantized(const MeshExtras& extras) {
+        return extras.quantized && extras.quantized->vertexPositions.size() &&
+               extras.quantized->vertexNormals.size() && extras.quantized->vertexTangents.size() &&
+               extras.quantized->vertexTexCoords0.size();
+    }
+
+    // Element range of a simplified level in m_lodElementBuffer
+    struct Lod {
+        float   error;
+        GLsizei firstIndex;
+        GLsizei indexCount;
+    };
+
+    // Uploads every level to one 32-bit element buffer, swapped in by
+    // drawLod()
+    void setLods(const rtrtool::MeshLods& lods);
+    void setBounds(std::span<const glm::vec3> positions);
+
+    Mesh(const IndicesAux& indices, const rtrtool::QuantizedMesh& quantized)
+        : m_elementBuffer(indices.data()),
+          m_vertexPositions(quantized.vertexPositions),
+          m_vertexTexCoords0(quantized.vertexTexCoords0),
+          m_vertexNormals(quantized.vertexNormals),
+          m_vertexTangents(quantized.vertexTangents),
+          m_vertexArray(m_elementBuffer,
+                        {
+                            VertexArray::Attrib::contiguous<glm::u16vec4>(
+                                m_vertexPositions, 0, GL_UNSIGNED_SHORT, GL_TRUE),
+                            VertexArray::Attrib::contiguous<glm::u16vec2>(
+                                m_vertexTexCoords0, 1, GL_HALF_FLOAT, GL_FALSE),
+                            VertexArray::Attrib::contiguous<glm::i16vec2>(
+                                m_vertexNormals, 2, GL_SHORT, GL_TRUE),
+                            VertexArray::Attrib::contiguous<glm::i8vec4>(
+                                m_vertexTangents, 3, GL_BYTE, GL_TRUE),
+                        }),
+          m_indexType(indices.type()),
+          m_indexCount(indices.count()),
+          m_quantized(true),
+          m_positionOffset(quantized.positionOffset),
+          m_positionScale(quantized.positionScale) {}
+
+    // Buffers copy the data, so generated attributes and decoded indices are
+    // only needed during construction
+    Mesh(const MeshAux& mesh, const IndicesAux& indices)
+        : m_elementBuffer(indices.data()),
+          m_vertexPositions(mesh->vertexPositions),
+          m_vertexTexCoords0(mesh->vertexTexCoords0),
+          m_vertexNormals(mesh->vertexNormals),
+          m_vertexTangents(mesh->vertexTangents),
           m_vertexArray(
               m_elementBuffer,
               {
-                  VertexArray::Attrib::contiguous<decltype(*m_mesh->vertexPositions.data())>(
+                  VertexArray::Attrib::contiguous<decltype(*mesh->vertexPositions.data())>(
                       m_vertexPositions, 0),
-                  VertexArray::Attrib::contiguous<decltype(*m_mesh->vertexTexCoords0.data())>(
+                  VertexArray::Attrib::contiguous<decltype(*mesh->vertexTexCoords0.data())>(
                       m_vertexTexCoords0, 1),
-                  VertexArray::Attrib::contiguous<decltype(*m_mesh->vertexNormals.data())>(
+                  VertexArray::Attrib::contiguous<decltype(*mesh->vertexNormals.data())>(
                       m_vertexNormals, 2),
-                  VertexArray::Attrib::contiguous<decltype(*m_mesh->vertexTangents.data())>(
+                  VertexArray::Attrib::contiguous<decltype(*mesh->vertexTangents.data())>(
                       m_vertexTangents, 3),
               }),
-          m_triangleCount(uint32_t(mesh.triangleVertices.size())) {}
-    void draw() const {
-        glBindVertexArray(m_vertexArray);
-        glDrawElements(GL_TRIANGLES, m_triangleCount * 3, GL_UNSIGNED_INT, (void*)0);
-        glBindVertexArray(0);
-    }
+          m_indexType(indices.type()),
+          m_indexCount(indices.count()) {}
 
-private:
-    MeshAux     m_mesh;
     Buffer      m_elementBuffer;
     Buffer      m_vertexPositions;
     Buffer      m_vertexTexCoords0;
     Buffer      m_vertexNormals;
     Buffer      m_vertexTangents;
     VertexArray m_vertexArray;
-    GLuint      m_triangleCount = 0;
+    GLenum      m_indexType = GL_UNSIGNED_INT;
+    GLsizei     m_indexCount = 0;
+    bool        m_quantized = false;
+    glm::vec3   m_positionOffset = glm::vec3(0.0f);
+    glm::vec3   m_positionScale = glm::vec3(1.0f);
+
+    std::vector<Cluster>  m_clusters;
+    std::optional<Buffer> m_lodElementBuffer;
+    std::vector<Lod>      m_lods;
+    glm::vec3             m_boundsCenter = glm::vec3(0.0f);
+    float                 m_boundsRadius = 0.0f;
 };
 
 } // namespace glraii
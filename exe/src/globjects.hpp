@@ -372,6 +372,15 @@ public:
 
         template <class T>
         static Attrib contiguous(const Buffer& buffer, GLuint bindingIndex) {
+            return contiguous<T>(buffer, bindingIndex, gl_format_from_v<std::decay_t<T>>,
+                                 GL_FALSE);
+        }
+
+        // Tightly packed T, read as the given component type, e.g. normalized
+        // integers or GL_HALF_FLOAT stored in uint16_t
+        template <class T>
+        static Attrib contiguous(const Buffer& buffer, GLuint bindingIndex, GLenum type,
+                                 GLboolean normalized) {
             GLint size = 1;
             if constexpr (is_glm_vector<std::decay_t<T>>)
                 size = std::decay_t<T>::length();
@@ -380,8 +389,8 @@ public:
                           .offset = 0,
                           .stride = sizeof(std::decay_t<T>),
                           .format = Format{.size = size,
-                                           .type = gl_format_from_v<std::decay_t<T>>,
-                                           .normalized = GL_FALSE,
+                                           .type = type,
+                                           .normalized = normalized,
                                            .relativeoffset = 0}};
         }
     };
@@ -5,6 +5,10 @@
 #include <decodeless/pmr_writer.hpp>
 #include <filesystem>
 #include <rtrtool/converter.hpp>
+#include <rtrtool/optimizer.hpp>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace fs = std::filesystem;
 
@@ -15,9 +19,10 @@ namespace fs = std::filesystem;
 // validate? conversion fails? What about files that don't fit in resident
 // memory - waste of swap?
 struct RTRConvertedFile {
-    RTRConvertedFile(const fs::path& output, const fs::path& input)
+    RTRConvertedFile(const fs::path& output, const fs::path& input,
+                     const rtrtool::ConvertOptions& options, rtrtool::ConvertStats* stats)
         : m_file(output, MAX_FILE_SIZE) {
-        rtrtool::convertFromGltf(m_file.allocator(), input);
+        rtrtool::convertFromGltf(m_file.allocator(), input, options, stats);
     }
     const rtr::RootHeader& operator*() const {
         return *reinterpret_cast<const rtr::RootHeader*>(m_file.data());
@@ -26,9 +31,10 @@ struct RTRConvertedFile {
 };
 
 struct RTRConvertedMemory {
-    RTRConvertedMemory(const fs::path& input)
+    RTRConvertedMemory(const fs::path& input, const rtrtool::ConvertOptions& options,
+                       rtrtool::ConvertStats* stats)
         : m_memory(MAX_FILE_SIZE) {
-        rtrtool::convertFromGltf(m_memory.allocator(), input);
+        rtrtool::convertFromGltf(m_memory.allocator(), input, options, stats);
     }
     const rtr::RootHeader& operator*() const {
         return *reinterpret_cast<const rtr::RootHeader*>(m_memory.data());
@@ -36,13 +42,251 @@ struct RTRConvertedMemory {
     decodeless::pmr_memory_writer m_memory;
 };
 
+void printStats(const rtrtool::ConvertStats& stats) {
+    if (stats.duplicateTextures)
+        std::cout << "Deduplicated " << stats.duplicateTextures << " textures, saving "
+                  << stats.duplicateTextureBytes << " bytes\n";
+    if (stats.duplicateMeshes)
+        std::cout << "Deduplicated " << stats.duplicateMeshes << " meshes\n";
+    if (stats.duplicateArrays)
+        std::cout << "Deduplicated " << stats.duplicateArrays << " mesh arrays, saving "
+                  << stats.duplicateArrayBytes << " bytes\n";
+    if (stats.weldedVertices || stats.degenerateTriangles)
+        std::cout << "Welding removed " << stats.weldedVertices << " vertices and "
+                  << stats.degenerateTriangles << " degenerate triangles\n";
+    for (const rtrtool::VertexCacheReport& report : stats.vertexCache)
+        std::cout << "Vertex cache '" << report.mesh << "': ACMR " << report.acmrBefore << " -> "
+                  << report.acmrAfter << ", ATVR " << report.atvrBefore << " -> "
+                  << report.atvrAfter << "\n";
+    if (stats.quantizedPositionError > 0.0f || stats.quantizedNormalDegrees > 0.0f ||
+        stats.quantizedTangentDegrees > 0.0f || stats.quantizedTexCoordError > 0.0f)
+        std::cout << "Quantization error: position " << stats.quantizedPositionError
+                  << ", normal " << stats.quantizedNormalDegrees << " deg, tangent "
+                  << stats.quantizedTangentDegrees << " deg, texcoord "
+                  << stats.quantizedTexCoordError << "\n";
+    if (stats.meshlets)
+        std::cout << "Built " << stats.meshlets << " meshlets\n";
+    if (stats.lodLevels)
+        std::cout << "Generated " << stats.lodLevels << " levels of detail\n";
+    if (stats.staticBatches)
+        std::cout << "Static batching merged " << stats.batchedInstances << " instances into "
+                  << stats.staticBatches << " meshes, reducing draws from "
+                  << stats.drawsBeforeBatching << " to " << stats.drawsAfterBatching << "\n";
+    if (stats.bvhNodes)
+        std::cout << "Built an instance BVH with " << stats.bvhNodes << " nodes\n";
+    if (stats.instanceGroups)
+        std::cout << "Imported " << stats.gpuInstances << " GPU instances in "
+                  << stats.instanceGroups << " instanced draws\n";
+    if (stats.indexBytes != stats.indexBytesUncompacted)
+        std::cout << "Triangle indices: " << stats.indexBytes << " bytes, down from "
+                  << stats.indexBytesUncompacted << "\n";
+    if (stats.cacheHits || stats.cacheMisses)
+        std::cout << "Cache: " << stats.cacheHits << " hits, " << stats.cacheMisses
+                  << " misses, " << stats.cacheEvictedBytes << " bytes evicted\n";
+}
+
+void printStats(const rtrtool::OptimizeStats& stats) {
+    std::cout << "load: " << stats.loadMilliseconds << " ms\n";
+    for (const rtrtool::OptimizePassReport& report : stats.passes)
+        std::cout << rtrtool::optimizePassName(report.pass) << ": " << report.milliseconds
+                  << " ms, " << report.bytesBefore << " -> " << report.bytesAfter << " bytes ("
+                  << std::showpos << int64_t(report.bytesAfter) - int64_t(report.bytesBefore)
+                  << std::noshowpos << ")\n";
+    std::cout << "write: " << stats.writeMilliseconds << " ms\n";
+    if (stats.duplicateArrays)
+        std::cout << "Deduplicated " << stats.duplicateArrays << " mesh arrays, saving "
+                  << stats.duplicateArrayBytes << " bytes\n";
+    if (stats.droppedHeaders)
+        std::cout << "Dropped " << stats.droppedHeaders
+                  << " derived sub-headers, e.g. meshlets or levels of detail. Convert from the "
+                     "source to regenerate them.\n";
+}
+
+// rtrtool optimize <input> <output> [--passes=...]
+int optimize(int argc, char* argv[]) {
+    args::ArgumentParser parser("rtrtool optimize: Run optimization passes over an rtr file");
+    args::Group required(parser, "Required positional arguments:", args::Group::Validators::All);
+    args::Positional<std::string> input(required, "input", "Input rtr file");
+    args::Positional<std::string> output(required, "output", "Output rtr file to write");
+    args::ValueFlag<std::string> passes(
+        parser, "pass,...",
+        "Comma separated passes to run in order: weld, vertex-cache, dedupe-meshes, "
+        "dedupe-textures, prune and layout. Defaults to all of them.",
+        {"passes"}, "weld,vertex-cache,dedupe-meshes,dedupe-textures,prune,layout");
+    args::ValueFlag<unsigned> jobs(
+        parser, "N", "Threads to use for mesh passes. Defaults to one per hardware thread.",
+        {'j', "jobs"}, 0);
+    args::ValueFlag<float> weldEpsilon(
+        parser, "epsilon", "Merge vertex attributes this close together when welding.",
+        {"weld-epsilon"}, 0.0f);
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (const args::Help&) {
+        std::cout << parser;
+        return EXIT_SUCCESS;
+    } catch (args::ValidationError& e) {
+        std::cerr << e.what() << std::endl;
+        parser.Help(std::cerr);
+        return EXIT_FAILURE;
+    } catch (const args::ParseError& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return EXIT_FAILURE;
+    }
+
+    rtrtool::OptimizeOptions options{
+        .jobs = args::get(jobs),
+        .weldEpsilon = args::get(weldEpsilon),
+    };
+    std::string_view remaining = args::get(passes);
+    while (!remaining.empty()) {
+        std::string_view name = remaining.substr(0, remaining.find(','));
+        remaining.remove_prefix(std::min(remaining.size(), name.size() + 1));
+        std::optional<rtrtool::OptimizePass> pass = rtrtool::parseOptimizePass(name);
+        if (!pass) {
+            std::cerr << "Unknown pass: " << name << "\n";
+            return EXIT_FAILURE;
+        }
+        options.passes.push_back(*pass);
+    }
+
+    fs::path inputPath = args::get(input);
+    fs::path outputPath = args::get(output);
+    if (!fs::exists(inputPath)) {
+        std::cerr << "Input file not found: " << inputPath << "\n";
+        return EXIT_FAILURE;
+    }
+    if (fs::exists(outputPath) && fs::equivalent(inputPath, outputPath)) {
+        std::cerr << "Cannot optimize a file in place\n";
+        return EXIT_FAILURE;
+    }
+    try {
+        rtrtool::MappedFile         inputFile(inputPath);
+        decodeless::pmr_file_writer outputFile(outputPath, MAX_FILE_SIZE);
+        rtrtool::OptimizeStats      stats;
+        rtrtool::optimizeFile(outputFile.allocator(), *inputFile, options, &stats);
+        printStats(stats);
+    } catch (const rtrtool::MappedFile::Error& e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string_view(argv[1]) == "optimize")
+        return optimize(argc - 1, argv + 1);
+
     args::ArgumentParser parser("rtrtool: Ready to render (*.rtr) viewer and tool");
     args::Group required(parser, "Required positional arguments:", args::Group::Validators::All);
     args::Positional<std::string> output(parser, "output",
                                          "Output rtr file to write. Will view input if not given.");
     args::Positional<std::string> input(required, "input", "Input file to process");
     args::Flag     print(parser, "print", "Print a summary of the file and exit.", {'p', "print"});
+    args::ValueFlag<unsigned> jobs(
+        parser, "N", "Threads to use for conversion. Defaults to one per hardware thread.",
+        {'j', "jobs"}, 0);
+    args::Flag noGenerateTangents(
+        parser, "no-generate-tangents",
+        "Do not generate normals and MikkTSpace tangents for meshes without them.",
+        {"no-generate-tangents"});
+    args::Flag weld(parser, "weld",
+                    "Merge identical vertices and remove degenerate triangles when converting.",
+                    {"weld"});
+    args::ValueFlag<float> weldEpsilon(
+        parser, "epsilon",
+        "Merge vertex attributes this close together when welding. Implies --weld.",
+        {"weld-epsilon"}, 0.0f);
+    args::Flag optimizeVertexCache(
+        parser, "optimize-vertex-cache",
+        "Reorder triangles and vertices for GPU vertex reuse and report ACMR/ATVR per mesh.",
+        {"optimize-vertex-cache"});
+    args::Flag quantizeVertices(
+        parser, "quantize-vertices",
+        "Also write 16-bit positions, octahedral normals and tangents and half float texture "
+        "coordinates, which the viewer uses when present.",
+        {"quantize-vertices"});
+    std::unordered_map<std::string, rtrtool::IndexFormat> indexFormatNames{
+        {"uint32", rtrtool::IndexFormat::uint32},
+        {"compact", rtrtool::IndexFormat::compact},
+        {"encoded", rtrtool::IndexFormat::encoded},
+    };
+    args::MapFlag<std::string, rtrtool::IndexFormat> indexFormat(
+        parser, "uint32|compact|encoded",
+        "Triangle index storage. 'compact' uses 16-bit indices for meshes with up to 65536 "
+        "vertices. 'encoded' delta codes all indices for archival and decodes them on load.",
+        {"index-format"}, indexFormatNames, rtrtool::IndexFormat::uint32);
+    args::Flag meshlets(parser, "meshlets",
+                        "Also write meshlets with bounding spheres and normal cones, which the "
+                        "viewer uses to cull offscreen and backfacing clusters.",
+                        {"meshlets"});
+    args::ValueFlag<uint32_t> meshletMaxVertices(
+        parser, "N", "Maximum vertices per meshlet, up to 256. Implies --meshlets.",
+        {"meshlet-max-vertices"}, 64);
+    args::ValueFlag<uint32_t> meshletMaxTriangles(
+        parser, "N", "Maximum triangles per meshlet. Implies --meshlets.",
+        {"meshlet-max-triangles"}, 124);
+    args::Flag lods(parser, "lods",
+                    "Also write simplified levels of detail per mesh, which the viewer selects "
+                    "by projected screen-space error.",
+                    {"lods"});
+    args::ValueFlag<uint32_t> maxLodLevels(
+        parser, "N",
+        "Maximum levels of detail per mesh, each about half the previous. Implies --lods.",
+        {"max-lod-levels"}, 8);
+    args::Flag batchStatic(
+        parser, "batch-static",
+        "Merge static instances that share a material into pre-transformed meshes.",
+        {"batch-static"});
+    args::ValueFlag<float> batchCellSize(
+        parser, "size", "Also split static batches by a world space grid. Implies --batch-static.",
+        {"batch-cell-size"}, 0.0f);
+    args::ValueFlag<uint32_t> batchMaxVertices(
+        parser, "N", "Maximum vertices per static batch. Implies --batch-static.",
+        {"batch-max-vertices"}, 65536);
+    args::Flag dedupeArrays(parser, "dedupe-arrays",
+                            "Write bit-identical mesh arrays once and share them between meshes.",
+                            {"dedupe-arrays"});
+    args::Flag noBvh(parser, "no-bvh", "Convert without mesh bounds and an instance BVH.",
+                     {"no-bvh"});
+    args::Flag packMetallicRoughness(
+        parser, "pack-metallic-roughness",
+        "Convert glTF metallic/roughness textures to one two channel texture.",
+        {"pack-metallic-roughness"});
+    args::Flag noMipmaps(parser, "no-mipmaps", "Convert textures without generating mipmaps.",
+                         {"no-mipmaps"});
+    args::ValueFlag<uint32_t> maxTextureSize(
+        parser, "size",
+        "Drop texture mip levels larger than this in either dimension when converting.",
+        {"max-texture-size"}, 0);
+    std::unordered_map<std::string, rtrtool::TextureCompression> compressionNames{
+        {"none", rtrtool::TextureCompression::none},
+        {"bc", rtrtool::TextureCompression::bc},
+        {"astc", rtrtool::TextureCompression::astc},
+    };
+    args::MapFlag<std::string, rtrtool::TextureCompression> textureCompression(
+        parser, "none|bc|astc",
+        "GPU block compression for converted textures. 'bc' uses BC7 for color, BC5 for normals "
+        "and BC4 for single channel textures.",
+        {"texture-compression"}, compressionNames, rtrtool::TextureCompression::none);
+    std::unordered_map<std::string, rtrtool::TextureQuality> qualityNames{
+        {"fast", rtrtool::TextureQuality::fast},
+        {"balanced", rtrtool::TextureQuality::balanced},
+        {"quality", rtrtool::TextureQuality::quality},
+    };
+    args::MapFlag<std::string, rtrtool::TextureQuality> textureQuality(
+        parser, "fast|balanced|quality", "Texture block compression speed tier.",
+        {"texture-quality"}, qualityNames, rtrtool::TextureQuality::balanced);
+    args::ValueFlag<std::string> cacheDirectory(
+        parser, "dir",
+        "Cache encoded textures and converted meshes in this directory to speed up repeated "
+        "conversions.",
+        {"cache"});
+    args::ValueFlag<uint64_t> cacheSizeMb(
+        parser, "MB", "Evict least recently used cache entries beyond this size. Default 4096.",
+        {"cache-size"}, 4096);
     args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
     args::CompletionFlag completion(parser, {"complete"});
 
@@ -66,15 +310,44 @@ int main(int argc, char* argv[]) {
 
     fs::path inputPath = args::get(input);
 
+    rtrtool::ConvertOptions convertOptions{
+        .jobs = args::get(jobs),
+        .generateTangentSpace = !args::get(noGenerateTangents),
+        .weld = args::get(weld) || weldEpsilon,
+        .weldEpsilon = args::get(weldEpsilon),
+        .optimizeVertexCache = args::get(optimizeVertexCache),
+        .quantizeVertices = args::get(quantizeVertices),
+        .indexFormat = args::get(indexFormat),
+        .buildMeshlets = args::get(meshlets) || meshletMaxVertices || meshletMaxTriangles,
+        .meshletMaxVertices = args::get(meshletMaxVertices),
+        .meshletMaxTriangles = args::get(meshletMaxTriangles),
+        .generateLods = args::get(lods) || maxLodLevels,
+        .maxLodLevels = args::get(maxLodLevels),
+        .batchStaticInstances = args::get(batchStatic) || batchCellSize || batchMaxVertices,
+        .batchCellSize = args::get(batchCellSize),
+        .batchMaxVertices = args::get(batchMaxVertices),
+        .deduplicateArrays = args::get(dedupeArrays),
+        .buildBvh = !args::get(noBvh),
+        .packMetallicRoughness = args::get(packMetallicRoughness),
+        .mipmaps = !args::get(noMipmaps),
+        .maxTextureSize = args::get(maxTextureSize),
+        .textureCompression = args::get(textureCompression),
+        .textureQuality = args::get(textureQuality),
+        .cacheDirectory = args::get(cacheDirectory),
+        .cacheMaxBytes = args::get(cacheSizeMb) << 20,
+    };
+
     bool convert = inputPath.extension() == ".gltf";
     bool write = static_cast<bool>(output);
 
     if (write) {
         if (convert) {
             fs::path outputPath = args::get(output);
-            if (fs::exists(inputPath))
-                RTRConvertedFile(outputPath, inputPath);
-            else {
+            if (fs::exists(inputPath)) {
+                rtrtool::ConvertStats stats;
+                RTRConvertedFile(outputPath, inputPath, convertOptions, &stats);
+                printStats(stats);
+            } else {
                 std::cerr << "Input file not found: " << inputPath << "\n";
                 return EXIT_FAILURE;
             }
@@ -85,7 +358,9 @@ int main(int argc, char* argv[]) {
     } else {
         App app;
         if (convert) {
-            app.view(rtrtool::File(RTRConvertedMemory(inputPath)));
+            rtrtool::ConvertStats stats;
+            app.view(rtrtool::File(RTRConvertedMemory(inputPath, convertOptions, &stats)));
+            printStats(stats);
         } else {
             try {
                 app.view(rtrtool::File(rtrtool::MappedFile(inputPath)));
@@ -0,0 +1,208 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <decodeless/header.hpp>
+#include <decodeless/offset_span.hpp>
+#include <glm/glm.hpp>
+#include <limits>
+
+namespace rtrtool {
+
+// Axis aligned bounding box. Empty boxes have min greater than max.
+struct Aabb {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+
+    bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+    void extend(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void extend(const Aabb& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+
+    float halfArea() const {
+        glm::vec3 size = max - min;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+};
+
+// Bounds of a box after an affine transform, from the extremes of each
+// transformed axis
+inline Aabb transformAabb(const Aabb& box, const glm::mat4& transform) {
+    if (box.empty())
+        return box;
+    Aabb result;
+    result.min = result.max = glm::vec3(transform[3]);
+    for (int column = 0; column < 3; ++column) {
+        glm::vec3 a = glm::vec3(transform[column]) * box.min[column];
+        glm::vec3 b = glm::vec3(transform[column]) * box.max[column];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+    return result;
+}
+
+// A node of a bounding volume hierarchy, stored depth first. Interior nodes
+// have a count of zero, their left child directly after them and the index of
+// their right child in 'offset'. Leaves cover 'count' entries of
+// BvhHeader::instances starting at 'offset'.
+struct BvhNode {
+    Aabb     bounds;
+    uint32_t offset;
+    uint32_t count;
+};
+
+// Deepest a BVH is built, so queries can traverse it with a fixed size stack
+constexpr uint32_t BvhMaxDepth = 64;
+
+// Optional sub-header, written next to rtr::SceneHeader. Holds object space
+// bounds per mesh and a surface area heuristic BVH over the world space
+// bounds of every instance in every scene. Instances with empty meshes are
+// left out.
+struct BvhHeader : decodeless::Header {
+    static constexpr decodeless::Magic   HeaderIdentifier{"RTBV"};
+    static constexpr decodeless::Version VersionSupported{0, 1, 0};
+    BvhHeader() : decodeless::Header{HeaderIdentifier, VersionSupported} {}
+
+    // One per mesh in the rtr::common::MeshHeader
+    decodeless::offset_span<Aabb> meshBounds;
+
+    // One per instance in the rtr::SceneHeader
+    decodeless::offset_span<Aabb> instanceBounds;
+
+    // The root is the first node. Empty if there are no instances.
+    decodeless::offset_span<BvhNode> nodes;
+
+    // Indices of rtr::SceneHeader instances, referenced by leaves
+    decodeless::offset_span<uint32_t> instances;
+};
+
+// Planes of the view frustum of a clip space transform, e.g. projection *
+// view, facing inwards. Points p inside have dot(plane, vec4(p, 1)) >= 0 for
+// every plane. Assumes OpenGL's -w to w clip space depth.
+inline std::array<glm::vec4, 6> frustumPlanes(const glm::mat4& clipFromWorld) {
+    auto row = [&clipFromWorld](int i) {
+        return glm::vec4(clipFromWorld[0][i], clipFromWorld[1][i], clipFromWorld[2][i],
+                         clipFromWorld[3][i]);
+    };
+    return {row(3) + row(0), row(3) - row(0), row(3) + row(1),
+            row(3) - row(1), row(3) + row(2), row(3) - row(2)};
+}
+
+// Calls visit(node) for every BVH node accepted by test(bounds), depth first
+// and without allocating. Children of rejected nodes are skipped.
+template <class Test, class Visit>
+void traverseBvh(const BvhHeader& bvh, Test&& test, Visit&& visit) {
+    if (!bvh.nodes.size())
+        return;
+    std::array<uint32_t, BvhMaxDepth> stack;
+    uint32_t                          stackSize = 0;
+    uint32_t                          index = 0;
+    for (;;) {
+        const BvhNode& node = bvh.nodes[index];
+        if (test(node.bounds)) {
+            visit(node);
+            if (node.count == 0) {
+                stack[stackSize++] = node.offset;
+                index++;
+                continue;
+            }
+        }
+        if (stackSize == 0)
+            break;
+        index = stack[--stackSize];
+    }
+}
+
+// Calls fn(instance) for each instance whose bounds intersect the box
+template <class Fn>
+void queryBox(const BvhHeader& bvh, const Aabb& box, Fn&& fn) {
+    auto overlaps = [&box](const Aabb& bounds) {
+        return glm::all(glm::lessThanEqual(bounds.min, box.max)) &&
+               glm::all(glm::lessThanEqual(box.min, bounds.max));
+    };
+    traverseBvh(bvh, overlaps, [&](const BvhNode& node) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            if (overlaps(bvh.instanceBounds[bvh.instances[i]]))
+                fn(bvh.instances[i]);
+    });
+}
+
+// Calls fn(instance) for each instance whose bounds are within 'radius' of
+// 'center'
+template <class Fn>
+void queryRange(const BvhHeader& bvh, const glm::vec3& center, float radius, Fn&& fn) {
+    auto inRange = [&center, radius](const Aabb& bounds) {
+        glm::vec3 offset = glm::clamp(center, bounds.min, bounds.max) - center;
+        return glm::dot(offset, offset) <= radius * radius;
+    };
+    traverseBvh(bvh, inRange, [&](const BvhNode& node) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            if (inRange(bvh.instanceBounds[bvh.instances[i]]))
+                fn(bvh.instances[i]);
+    });
+}
+
+// Calls fn(instance) for each instance whose bounds are not entirely outside
+// any plane, e.g. from frustumPlanes(). May report boxes near frustum corners
+// that are outside it.
+template <class Fn>
+void queryFrustum(const BvhHeader& bvh, const std::array<glm::vec4, 6>& planes, Fn&& fn) {
+    auto inside = [&planes](const Aabb& bounds) {
+        for (const glm::vec4& plane : planes) {
+            // Corner furthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                             plane.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                             plane.z >= 0.0f ? bounds.max.z : bounds.min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    };
+    traverseBvh(bvh, inside, [&](const BvhNode& node) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            if (inside(bvh.instanceBounds[bvh.instances[i]]))
+                fn(bvh.instances[i]);
+    });
+}
+
+// Calls fn(instance, t) for each instance whose bounds the ray origin +
+// direction * t hits with t in [0, tMax], where t is the entry distance or
+// zero if the origin is inside. Instances are not reported in order of t.
+template <class Fn>
+void queryRay(const BvhHeader& bvh, const glm::vec3& origin, const glm::vec3& direction,
+              float tMax, Fn&& fn) {
+    glm::vec3 inverse = 1.0f / direction;
+    auto      entry = [&](const Aabb& bounds) {
+        glm::vec3 t0 = (bounds.min - origin) * inverse;
+        glm::vec3 t1 = (bounds.max - origin) * inverse;
+        glm::vec3 lower = glm::min(t0, t1);
+        glm::vec3 upper = glm::max(t0, t1);
+        float     tNear = std::max({lower.x, lower.y, lower.z, 0.0f});
+        float     tFar = std::min({upper.x, upper.y, upper.z, tMax});
+        return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+    };
+    auto hits = [&](const Aabb& bounds) {
+        return entry(bounds) != std::numeric_limits<float>::infinity();
+    };
+    traverseBvh(bvh, hits, [&](const BvhNode& node) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            float t = entry(bvh.instanceBounds[bvh.instances[i]]);
+            if (t != std::numeric_limits<float>::infinity())
+                fn(bvh.instances[i], t);
+        }
+    });
+}
+
+} // namespace rtrtool
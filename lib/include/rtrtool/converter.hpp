@@ -2,10 +2,14 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <decodeless/writer.hpp>
 #include <filesystem>
 #include <rtr/header.hpp>
 #include <memory_resource>
+#include <string>
+#include <vector>
 
 namespace rtrtool {
 
@@ -15,6 +19,194 @@ namespace fs = std::filesystem;
 // memory.
 using WriterAllocator = std::pmr::polymorphic_allocator<std::byte>;
 
-[[maybe_unused]] rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator, const fs::path& path);
+// GPU block compression presets. Each texture slot gets a suitable format: BC7
+// for color, BC5 for normals and packed metallic/roughness and BC4 for single
+// channel textures. ASTC uses 4x4 blocks for everything. HDR and 16-bit images
+// are always stored uncompressed.
+enum class TextureCompression {
+    none,
+    bc,
+    astc,
+};
+
+// Block compression speed tier
+enum class TextureQuality {
+    fast,
+    balanced,
+    quality,
+};
+
+// Storage for mesh triangles. compact moves the triangles of meshes with at
+// most 65536 vertices to 16-bit arrays. encoded delta and varint codes every
+// mesh's triangles, for archival files, and they are decoded on load. Both
+// write a rtrtool::MeshIndicesHeader and leave the replaced
+// rtr::common::Mesh::triangleVertices empty.
+enum class IndexFormat {
+    uint32,
+    compact,
+    encoded,
+};
+
+struct ConvertOptions {
+    // Threads used to convert meshes and decode and encode textures. Zero
+    // uses one per hardware thread. Output is identical regardless of the
+    // value.
+    unsigned jobs = 0;
+
+    // Generate smooth normals and MikkTSpace tangents for meshes without them
+    bool generateTangentSpace = true;
+
+    // Merge identical vertices and remove degenerate triangles. Attributes
+    // within weldEpsilon, in their own units, are snapped together. Zero only
+    // merges exact matches.
+    bool  weld = false;
+    float weldEpsilon = 0.0f;
+
+    // Reorder triangles for post-transform vertex cache hits and then
+    // vertices for fetch locality
+    bool optimizeVertexCache = false;
+
+    // Also write a rtrtool::QuantizedMeshHeader with compact vertex arrays.
+    // See quantized_mesh.hpp.
+    bool quantizeVertices = false;
+
+    IndexFormat indexFormat = IndexFormat::uint32;
+
+    // Also write a rtrtool::MeshletHeader, partitioning each mesh into
+    // clusters of at most these many vertices and triangles with culling
+    // bounds. See meshlets.hpp.
+    bool     buildMeshlets = false;
+    uint32_t meshletMaxVertices = 64;
+    uint32_t meshletMaxTriangles = 124;
+
+    // Also write a rtrtool::LodHeader with up to maxLodLevels simplified
+    // triangle lists per mesh, each with about half the triangles of the
+    // previous. The weights scale the cost of collapsing across normal and
+    // texture coordinate differences relative to geometric error. See lods.hpp.
+    bool     generateLods = false;
+    uint32_t maxLodLevels = 8;
+    float    lodNormalWeight = 1.0f;
+    float    lodTexCoordWeight = 1.0f;
+
+    // Merge static instances that share a material into pre-transformed
+    // meshes drawn from each scene's root, to reduce draw calls. Instances
+    // are static unless they or an ancestor node are animated, skinned or
+    // morphed. A non-zero batchCellSize also splits batches by a world space
+    // grid of that size so they can still be culled. Merged meshes have at
+    // most batchMaxVertices vertices, and instances of larger meshes are not
+    // merged.
+    bool     batchStaticInstances = false;
+    float    batchCellSize = 0.0f;
+    uint32_t batchMaxVertices = 65536;
+
+    // Write each unique mesh array once and point meshes with bit-identical
+    // arrays, e.g. from copied assets, at the same bytes. Meshes are then
+    // converted into owned memory and hashed before being written.
+    bool deduplicateArrays = false;
+
+    // Also write a rtrtool::BvhHeader with per-mesh bounds and a BVH over
+    // the world space bounds of every instance. See bvh.hpp.
+    bool buildBvh = true;
+
+    // Store the glTF metallic/roughness texture as a single two channel
+    // texture, referenced by both material slots. Metallic is in the red
+    // channel and roughness in the green channel. Otherwise two single channel
+    // textures are written.
+    bool packMetallicRoughness = false;
+
+    // Write a full mip chain for each texture
+    bool mipmaps = true;
+
+    // Drop the largest texture mip levels until each texture is no larger
+    // than this in either dimension. Zero keeps the full resolution.
+    uint32_t maxTextureSize = 0;
+
+    TextureCompression textureCompression = TextureCompression::none;
+    TextureQuality     textureQuality = TextureQuality::balanced;
+
+    // Directory to cache encoded textures and converted meshes in, keyed by
+    // their input bytes and these options. Empty disables the cache. Least
+    // recently used entries are evicted beyond cacheMaxBytes.
+    fs::path cacheDirectory;
+    uint64_t cacheMaxBytes = uint64_t(4) << 30;
+};
+
+// A mesh's simulated vertex cache efficiency before and after reordering. ACMR
+// is cache misses per triangle and ATVR cache misses per vertex.
+struct VertexCacheReport {
+    std::string mesh;
+    float       acmrBefore = 0.0f;
+    float       acmrAfter = 0.0f;
+    float       atvrBefore = 0.0f;
+    float       atvrAfter = 0.0f;
+};
+
+// Summary of what a conversion did, for reporting
+struct ConvertStats {
+    // Textures with the same content as an earlier texture, which were
+    // written once and shared
+    size_t duplicateTextures = 0;
+    size_t duplicateTextureBytes = 0;
+
+    // glTF primitives that read the same accessors as an earlier primitive and
+    // share its mesh
+    size_t duplicateMeshes = 0;
+
+    // Mesh arrays written by deduplicateArrays as references to an identical
+    // earlier array, and the bytes they would have taken
+    size_t   duplicateArrays = 0;
+    uint64_t duplicateArrayBytes = 0;
+
+    // Vertices merged or left unused by welding and triangles it removed
+    size_t weldedVertices = 0;
+    size_t degenerateTriangles = 0;
+
+    // One entry per mesh reordered by optimizeVertexCache. Meshes loaded from
+    // the cache are not reported.
+    std::vector<VertexCacheReport> vertexCache;
+
+    // Largest errors introduced by quantizeVertices across all meshes. Angles
+    // are in degrees and the rest in the attribute's own units.
+    float quantizedPositionError = 0.0f;
+    float quantizedNormalDegrees = 0.0f;
+    float quantizedTangentDegrees = 0.0f;
+    float quantizedTexCoordError = 0.0f;
+
+    // Total meshlets written by buildMeshlets
+    size_t meshlets = 0;
+
+    // Total levels written by generateLods, excluding the full meshes
+    size_t lodLevels = 0;
+
+    // Instances merged by batchStaticInstances, the meshes they were merged
+    // into and the total number of instances, i.e. draws, before and after
+    size_t batchedInstances = 0;
+    size_t staticBatches = 0;
+    size_t drawsBeforeBatching = 0;
+    size_t drawsAfterBatching = 0;
+
+    // Nodes in the instance BVH written by buildBvh
+    size_t bvhNodes = 0;
+
+    // Copies from EXT_mesh_gpu_instancing nodes and the groups, one per
+    // primitive, they are drawn in
+    size_t gpuInstances = 0;
+    size_t instanceGroups = 0;
+
+    // Bytes of triangle indices written with a compact indexFormat, and their
+    // size as 32-bit indices
+    uint64_t indexBytes = 0;
+    uint64_t indexBytesUncompacted = 0;
+
+    // Artifact cache activity, if enabled
+    size_t   cacheHits = 0;
+    size_t   cacheMisses = 0;
+    uint64_t cacheEvictedBytes = 0;
+};
+
+[[maybe_unused]] rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator,
+                                                  const fs::path&         path,
+                                                  const ConvertOptions&   options = {},
+                                                  ConvertStats*           stats = nullptr);
 
 } // namespace rtrtool
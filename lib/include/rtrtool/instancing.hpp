@@ -0,0 +1,34 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <decodeless/header.hpp>
+#include <decodeless/offset_span.hpp>
+#include <glm/glm.hpp>
+#include <rtr/scene.hpp>
+
+namespace rtrtool {
+
+// Copies of a mesh drawn with one instanced draw, from a glTF node with
+// EXT_mesh_gpu_instancing. Each copy is drawn like 'instance' with its own
+// transform applied before the node's world transform.
+struct InstanceGroup {
+    rtr::Instance instance;
+
+    // Affine transforms, column by column. Groups from the primitives of the
+    // same node share one array.
+    decodeless::offset_span<glm::mat4x3> transforms;
+};
+
+// Optional sub-header, written next to rtr::SceneHeader when the glTF has
+// instanced nodes. Their copies are only here and not in
+// rtr::SceneHeader::instances, nor in the rtrtool::BvhHeader.
+struct InstancingHeader : decodeless::Header {
+    static constexpr decodeless::Magic   HeaderIdentifier{"RTGI"};
+    static constexpr decodeless::Version VersionSupported{0, 1, 0};
+    InstancingHeader() : decodeless::Header{HeaderIdentifier, VersionSupported} {}
+
+    decodeless::offset_span<InstanceGroup> groups;
+};
+
+} // namespace rtrtool
@@ -0,0 +1,37 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <decodeless/header.hpp>
+#include <decodeless/offset_span.hpp>
+#include <glm/glm.hpp>
+
+namespace rtrtool {
+
+// A simplified version of a mesh's triangles, indexing its original vertices
+struct MeshLod {
+    decodeless::offset_span<glm::uvec3> triangles;
+
+    // Geometric error in the mesh's position units, e.g. to compare with a
+    // pixel threshold after projecting. Never less than the previous level's.
+    float error;
+};
+
+// Levels of detail of the mesh at the same index in the rtr::common::MeshHeader,
+// from the finest to the coarsest. The mesh itself is the implicit level zero
+// with no error. Empty for meshes that could not be simplified.
+struct MeshLods {
+    decodeless::offset_span<MeshLod> levels;
+};
+
+// Optional sub-header, written next to rtr::common::MeshHeader with one entry
+// per mesh
+struct LodHeader : decodeless::Header {
+    static constexpr decodeless::Magic   HeaderIdentifier{"RTLD"};
+    static constexpr decodeless::Version VersionSupported{0, 1, 0};
+    LodHeader() : decodeless::Header{HeaderIdentifier, VersionSupported} {}
+
+    decodeless::offset_span<MeshLods> meshes;
+};
+
+} // namespace rtrtool
@@ -0,0 +1,49 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <decodeless/header.hpp>
+#include <decodeless/offset_span.hpp>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace rtrtool {
+
+// Compact triangles for the mesh at the same index in the
+// rtr::common::MeshHeader. When either array is set, the mesh's own
+// triangleVertices is empty and triangleCount gives its size.
+struct MeshIndices {
+    // Triangles of meshes with at most 65536 vertices, for GL_UNSIGNED_SHORT
+    // draws
+    decodeless::offset_span<glm::u16vec3> triangles16;
+
+    // Archival encoding, see decodeTriangles()
+    decodeless::offset_span<uint8_t> encoded;
+
+    uint32_t triangleCount = 0;
+};
+
+// Optional sub-header, written next to rtr::common::MeshHeader with one entry
+// per mesh
+struct MeshIndicesHeader : decodeless::Header {
+    static constexpr decodeless::Magic   HeaderIdentifier{"RTIX"};
+    static constexpr decodeless::Version VersionSupported{0, 1, 0};
+    MeshIndicesHeader() : decodeless::Header{HeaderIdentifier, VersionSupported} {}
+
+    decodeless::offset_span<MeshIndices> meshes;
+};
+
+// Each index is stored as the zigzag coded difference from the previous
+// index in LEB128 varint bytes. Meshes ordered for the vertex cache and
+// vertex fetch mostly reference recent vertices, so most indices take one
+// byte.
+std::vector<uint8_t> encodeTriangles(std::span<const glm::uvec3> triangles);
+
+// Decodes exactly triangles.size() triangles, throwing if 'encoded' does not
+// hold that many or an index does not fit the result type
+void decodeTriangles(std::span<const uint8_t> encoded, std::span<glm::uvec3> triangles);
+void decodeTriangles(std::span<const uint8_t> encoded, std::span<glm::u16vec3> triangles);
+
+} // namespace rtrtool
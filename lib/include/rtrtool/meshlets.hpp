@@ -0,0 +1,85 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <decodeless/header.hpp>
+#include <decodeless/offset_span.hpp>
+#include <glm/glm.hpp>
+
+namespace rtrtool {
+
+// A cluster of a mesh's triangles with few enough vertices for 8-bit local
+// indices, plus bounds for culling it as a whole
+struct Meshlet {
+    // Ranges in MeshletMesh::vertices and MeshletMesh::triangles
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+
+    // Bounding sphere of the meshlet's vertices
+    glm::vec3 center;
+    float     radius;
+
+    // Cone containing every triangle's normal, for backface culling. The
+    // whole meshlet faces away from a camera at 'eye' when
+    //   dot(center - eye, coneAxis) >= coneCutoff * (length(center - eye) + radius) + radius
+    // coneCutoff is the sine of the cone's half angle. Meshlets with a cone
+    // too wide to be useful have a zero axis and a cutoff of one, so never
+    // pass.
+    glm::vec3 coneAxis;
+    float     coneCutoff;
+};
+
+// Backface test for meshlets drawn with a transform to eye space, where the
+// eye is at the origin. Cones transform like normals. A mirroring transform
+// also reverses the winding, but the renderer swaps its front face to match,
+// so the transformed cone still bounds the front faces' normals. Non-uniform
+// scale distorts the cone, so nothing is culled.
+struct MeshletBackfaceTest {
+    explicit MeshletBackfaceTest(const glm::mat4& localToEye) {
+        glm::mat3 linear(localToEye);
+        glm::vec3 scales(glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]));
+        float     minScale = glm::min(scales.x, glm::min(scales.y, scales.z));
+        float     maxScale = glm::max(scales.x, glm::max(scales.y, scales.z));
+        uniformScale = minScale > maxScale * 0.999f;
+        normalMatrix = glm::inverse(glm::transpose(linear));
+    }
+
+    // Takes the meshlet's bounding sphere already in eye space
+    bool operator()(const glm::vec3& center, float radius, const glm::vec3& coneAxis,
+                    float coneCutoff) const {
+        if (!uniformScale || coneCutoff >= 1.0f)
+            return false;
+        glm::vec3 axis = glm::normalize(normalMatrix * coneAxis);
+        return glm::dot(center, axis) >= coneCutoff * (glm::length(center) + radius) + radius;
+    }
+
+    glm::mat3 normalMatrix;
+    bool      uniformScale;
+};
+
+// Meshlets of the mesh at the same index in the rtr::common::MeshHeader. Every
+// triangle of the mesh is in exactly one meshlet.
+struct MeshletMesh {
+    decodeless::offset_span<Meshlet> meshlets;
+
+    // Mesh vertex indices, referenced by each meshlet's local indices
+    decodeless::offset_span<uint32_t> vertices;
+
+    // Local triangles, indexing vertices from the meshlet's vertexOffset
+    decodeless::offset_span<glm::u8vec3> triangles;
+};
+
+// Optional sub-header, written next to rtr::common::MeshHeader with one entry
+// per mesh
+struct MeshletHeader : decodeless::Header {
+    static constexpr decodeless::Magic   HeaderIdentifier{"RTML"};
+    static constexpr decodeless::Version VersionSupported{0, 1, 0};
+    MeshletHeader() : decodeless::Header{HeaderIdentifier, VersionSupported} {}
+
+    decodeless::offset_span<MeshletMesh> meshes;
+};
+
+} // namespace rtrtool
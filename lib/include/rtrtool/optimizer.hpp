@@ -0,0 +1,91 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <rtr/header.hpp>
+#include <rtrtool/converter.hpp>
+#include <string_view>
+#include <vector>
+
+namespace rtrtool {
+
+// Passes that optimizeFile() can run over an existing rtr file
+enum class OptimizePass {
+    // Merge identical vertices and remove degenerate triangles
+    weld,
+
+    // Reorder triangles for post-transform vertex cache hits and then
+    // vertices for fetch locality
+    vertexCache,
+
+    // Share one mesh between meshes with identical arrays
+    dedupeMeshes,
+
+    // Share one texture between textures with identical KTX files
+    dedupeTextures,
+
+    // Remove meshes and materials no instance uses and textures no material
+    // uses
+    prune,
+
+    // Reorder meshes, materials and textures by first use from the scene, so
+    // the file is read front to back when opened
+    layout,
+};
+
+// Command line names, e.g. "vertex-cache"
+std::string_view            optimizePassName(OptimizePass pass);
+std::optional<OptimizePass> parseOptimizePass(std::string_view name);
+
+struct OptimizeOptions {
+    // Threads used by per-mesh passes. Zero uses one per hardware thread.
+    unsigned jobs = 0;
+
+    // Passes to run, in order. The same pass may appear more than once.
+    std::vector<OptimizePass> passes;
+
+    // See ConvertOptions::weldEpsilon
+    float weldEpsilon = 0.0f;
+};
+
+// Time taken by a pass and the total size of the mesh, material, texture and
+// scene data before and after it
+struct OptimizePassReport {
+    OptimizePass pass;
+    double       milliseconds = 0.0;
+    uint64_t     bytesBefore = 0;
+    uint64_t     bytesAfter = 0;
+};
+
+struct OptimizeStats {
+    std::vector<OptimizePassReport> passes;
+    double                          loadMilliseconds = 0.0;
+    double                          writeMilliseconds = 0.0;
+
+    // Sub-headers in the input other than meshes, materials, the scene,
+    // instancing, world transforms and the instance BVH, which are rewritten
+    // from the scene.
+    // Derived data such as meshlets and levels of detail would be stale after
+    // mesh passes, so they are not written and must be regenerated from the
+    // source.
+    size_t droppedHeaders = 0;
+
+    // Mesh arrays written as references to an identical earlier array, see
+    // ConvertOptions::deduplicateArrays
+    size_t   duplicateArrays = 0;
+    uint64_t duplicateArrayBytes = 0;
+};
+
+// Copies the meshes, materials and scene of an rtr file into owned memory,
+// runs the passes in options over them and writes the result with the given
+// allocator, e.g. to a new file. Compact triangles from a
+// rtrtool::MeshIndicesHeader are expanded to 32-bit triangles. Each unique
+// mesh array is written once.
+const rtr::RootHeader* optimizeFile(const WriterAllocator& allocator,
+                                    const rtr::RootHeader& input, const OptimizeOptions& options,
+                                    OptimizeStats* stats = nullptr);
+
+} // namespace rtrtool
@@ -0,0 +1,41 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <decodeless/header.hpp>
+#include <decodeless/offset_span.hpp>
+#include <glm/glm.hpp>
+
+namespace rtrtool {
+
+// Compact copy of an rtr::common::Mesh's vertex arrays, 20 bytes per vertex
+// rather than 48. Triangles are not duplicated; use the mesh at the same index
+// in the rtr::common::MeshHeader. Every array is in the same vertex order as
+// the full precision mesh and is empty where it is.
+//
+// - Positions are unorm16 within the mesh's bounds: offset + scale * (v / 65535).
+//   w is padding, for 4-byte aligned vertex attributes.
+// - Normals are octahedral encoded snorm16.
+// - Tangents are octahedral encoded snorm8 in xy with the handedness in z as
+//   +/-127. w is padding.
+// - Texture coordinates are IEEE half floats.
+struct QuantizedMesh {
+    glm::vec3                             positionOffset;
+    glm::vec3                             positionScale;
+    decodeless::offset_span<glm::u16vec4> vertexPositions;
+    decodeless::offset_span<glm::i16vec2> vertexNormals;
+    decodeless::offset_span<glm::i8vec4>  vertexTangents;
+    decodeless::offset_span<glm::u16vec2> vertexTexCoords0;
+};
+
+// Optional sub-header, written next to rtr::common::MeshHeader with one entry
+// per mesh
+struct QuantizedMeshHeader : decodeless::Header {
+    static constexpr decodeless::Magic   HeaderIdentifier{"RTQM"};
+    static constexpr decodeless::Version VersionSupported{0, 1, 0};
+    QuantizedMeshHeader() : decodeless::Header{HeaderIdentifier, VersionSupported} {}
+
+    decodeless::offset_span<QuantizedMesh> meshes;
+};
+
+} // namespace rtrtool
@@ -0,0 +1,30 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <decodeless/header.hpp>
+#include <decodeless/offset_span.hpp>
+#include <glm/glm.hpp>
+
+namespace rtrtool {
+
+// Optional sub-header, written next to rtr::SceneHeader. Flattens the node
+// hierarchy so instances can be placed without walking up to the root. Both
+// arrays are in the order of rtr::SceneHeader::nodes and cover every node
+// written for a scene, which includes all nodes referenced by instances,
+// cameras and lights.
+struct WorldTransformHeader : decodeless::Header {
+    static constexpr decodeless::Magic   HeaderIdentifier{"RTWT"};
+    static constexpr decodeless::Version VersionSupported{0, 1, 0};
+    WorldTransformHeader() : decodeless::Header{HeaderIdentifier, VersionSupported} {}
+
+    // Each node's transform multiplied by those of all its ancestors
+    decodeless::offset_span<glm::mat4> transforms;
+
+    // Index of the root node of each node's scene, i.e. the node one of
+    // rtr::SceneHeader::scenes points to
+    decodeless::offset_span<uint32_t> roots;
+};
+
+} // namespace rtrtool
@@ -1,96 +1,923 @@
 // Copyright (c) 2024 Pyarelal Knowles, MIT License
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cgltf.h>
-#include <functional>
+#include <cstring>
 #include <glm/ext/matrix_transform.hpp>
+#include <map>
+#include <numeric>
 #include <optional>
 #include <rtr/material.hpp>
 #include <rtr/mesh.hpp>
 #include <rtr/scene.hpp>
 #include <rtr/write_mesh.hpp>
+#include <rtrtool/bvh.hpp>
 #include <rtrtool/converter.hpp>
+#include <rtrtool/instancing.hpp>
+#include <rtrtool/lods.hpp>
+#include <rtrtool/mesh_indices.hpp>
+#include <rtrtool/meshlets.hpp>
+#include <rtrtool/quantized_mesh.hpp>
+#include <rtrtool/world_transforms.hpp>
+#include <rtrtool_batch.hpp>
+#include <rtrtool_bvh.hpp>
+#include <rtrtool_cache.hpp>
 #include <rtrtool_cgltf.hpp>
+#include <rtrtool_hash.hpp>
+#include <rtrtool_kernels.hpp>
 #include <rtrtool_ktx.hpp>
+#include <rtrtool_mesh.hpp>
+#include <rtrtool_mesh_writer.hpp>
+#include <rtrtool_mesh_optimize.hpp>
+#include <rtrtool_meshlets.hpp>
+#include <rtrtool_parallel.hpp>
+#include <rtrtool_quantize.hpp>
+#include <rtrtool_scene.hpp>
+#include <rtrtool_simplify.hpp>
+#include <rtrtool_tangent_space.hpp>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <unordered_map>
 
 namespace rtrtool {
 
-struct MeshData {
-#define RTR_ARRAY(type, name) std::vector<type> name;
+// Element counts of each mesh array. Also the start of cached mesh payloads.
+struct MeshCounts {
+#define RTR_ARRAY(type, name) uint64_t name = 0;
     RTR_COMMON_MESH_FOREACH_ARRAY
 #undef RTR_ARRAY
 };
 
-using IndexedTexture = std::pair<uint32_t, rtr::common::Texture>;
-using TextureCache = std::unordered_map<std::string, IndexedTexture>;
+MeshArrays allocateMesh(const WriterAllocator& allocator, const MeshCounts& counts) {
+    MeshArrays result;
+#define RTR_ARRAY(type, name) result.name = decodeless::create::array<type>(allocator, counts.name);
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    return result;
+}
+
+MeshData allocateMesh(const MeshCounts& counts) {
+    MeshData result;
+#define RTR_ARRAY(type, name) result.name.resize(counts.name);
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    return result;
+}
+
+MeshArrays arraysOf(MeshData& mesh) {
+    MeshArrays result;
+#define RTR_ARRAY(type, name) result.name = mesh.name;
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    return result;
+}
+
+MeshCounts countsOf(const MeshData& mesh) {
+    MeshCounts result;
+#define RTR_ARRAY(type, name) result.name = mesh.name.size();
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    return result;
+}
+
+void copyMesh(const MeshData& source, const MeshArrays& destination) {
+#define RTR_ARRAY(type, name) std::ranges::copy(source.name, destination.name.begin());
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+}
+
+// The mode and accessors a primitive's mesh is converted from. Equal keys
+// produce identical meshes. Attributes are sorted so their order does not
+// matter.
+using PrimitiveKey = std::vector<std::tuple<cgltf_attribute_type, int, const cgltf_accessor*>>;
+
+PrimitiveKey primitiveKey(const cgltf_primitive& primitive) {
+    PrimitiveKey result;
+    result.emplace_back(cgltf_attribute_type_invalid, int(primitive.type), primitive.indices);
+    for (const auto& attrib : std::span(primitive.attributes, primitive.attributes_count)) {
+        switch (attrib.type) {
+        case cgltf_attribute_type_position:
+        case cgltf_attribute_type_normal:
+        case cgltf_attribute_type_texcoord:
+        case cgltf_attribute_type_tangent:
+            result.emplace_back(attrib.type, attrib.index, attrib.data);
+            break;
+        default:
+            break;
+        }
+    }
+    std::ranges::sort(result);
+    return result;
+}
+
+const cgltf_accessor* findAttribute(const cgltf_primitive& primitive, cgltf_attribute_type type,
+                                    int index = 0) {
+    for (const auto& attrib : std::span(primitive.attributes, primitive.attributes_count))
+        if (attrib.type == type && attrib.index == index)
+            return attrib.data;
+    return nullptr;
+}
+
+// Number of vertices a primitive draws: its index count or, if it has no
+// indices, its vertex count
+size_t drawnVertexCount(const cgltf_primitive& primitive) {
+    if (primitive.indices)
+        return primitive.indices->count;
+    const cgltf_accessor* positions = findAttribute(primitive, cgltf_attribute_type_position);
+    return positions ? positions->count : 0;
+}
+
+// Number of triangles a primitive draws. Strips and fans are triangulated.
+// Points and lines are rejected.
+size_t primitiveTriangleCount(const cgltf_primitive& primitive) {
+    size_t count = drawnVertexCount(primitive);
+    switch (primitive.type) {
+    case cgltf_primitive_type_triangles:
+        if (count % 3 != 0)
+            throw std::runtime_error("Triangle index count is not a multiple of 3");
+        return count / 3;
+    case cgltf_primitive_type_triangle_strip:
+    case cgltf_primitive_type_triangle_fan:
+        return count < 3 ? 0 : count - 2;
+    default:
+        throw std::runtime_error("glTF point and line primitives are not supported");
+    }
+}
+
+// Indices of the vertices a primitive draws, in order. Unindexed primitives
+// draw each vertex once.
+void convertDrawnVertices(const cgltf_primitive& primitive, std::span<uint32_t> result) {
+    if (primitive.indices)
+        convertInto(*primitive.indices, result);
+    else
+        std::iota(result.begin(), result.end(), 0u);
+}
+
+// Triangle lists of strips and fans, keeping their winding as in the glTF
+// spec
+void triangulate(cgltf_primitive_type type, std::span<const uint32_t> vertices,
+                 std::span<glm::uvec3> triangles) {
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        if (type == cgltf_primitive_type_triangle_strip)
+            triangles[i] = glm::uvec3(vertices[i], vertices[i + 1 + i % 2],
+                                      vertices[i + 2 - i % 2]);
+        else
+            triangles[i] = glm::uvec3(vertices[i + 1], vertices[i + 2], vertices[0]);
+    }
+}
+
+// Sizing pass: the array sizes of a primitive's mesh, from its accessors.
+// Normals and tangents that will be generated are included.
+MeshCounts primitiveCounts(const cgltf_primitive& primitive, const ConvertOptions& options) {
+    MeshCounts result;
+    result.triangleVertices = primitiveTriangleCount(primitive);
+    for (const auto& attrib : std::span(primitive.attributes, primitive.attributes_count)) {
+        switch (attrib.type) {
+        case cgltf_attribute_type_position:
+            result.vertexPositions = attrib.data->count;
+            break;
+        case cgltf_attribute_type_normal:
+            result.vertexNormals = attrib.data->count;
+            break;
+        case cgltf_attribute_type_texcoord:
+            if (attrib.index == 0)
+                result.vertexTexCoords0 = attrib.data->count;
+            break;
+        case cgltf_attribute_type_tangent:
+            result.vertexTangents = attrib.data->count;
+            break;
+        default:
+            break;
+        }
+    }
+    if (options.generateTangentSpace && result.vertexPositions) {
+        if (!result.vertexNormals)
+            result.vertexNormals = result.vertexPositions;
+        if (!result.vertexTangents && result.vertexTexCoords0)
+            result.vertexTangents = result.vertexPositions;
+    }
+    return result;
+}
+
+// Converts a primitive's accessors in place into arrays sized by
+// primitiveCounts()
+void convertPrimitive(const cgltf_primitive& primitive, const MeshArrays& mesh) {
+    if (primitive.type == cgltf_primitive_type_triangles) {
+        convertDrawnVertices(primitive,
+                             std::span(reinterpret_cast<uint32_t*>(mesh.triangleVertices.data()),
+                                       mesh.triangleVertices.size() * 3));
+    } else {
+        std::vector<uint32_t> vertices(drawnVertexCount(primitive));
+        convertDrawnVertices(primitive, vertices);
+        triangulate(primitive.type, vertices, mesh.triangleVertices);
+    }
+    for (const auto& attrib : std::span(primitive.attributes, primitive.attributes_count)) {
+        switch (attrib.type) {
+        case cgltf_attribute_type_position:
+            convertInto(*attrib.data, mesh.vertexPositions);
+            break;
+        case cgltf_attribute_type_normal:
+            convertInto(*attrib.data, mesh.vertexNormals);
+            break;
+        case cgltf_attribute_type_texcoord:
+            if (attrib.index == 0)
+                convertInto(*attrib.data, mesh.vertexTexCoords0);
+            break;
+        case cgltf_attribute_type_tangent:
+            convertInto(*attrib.data, mesh.vertexTangents);
+            break;
+        default:
+            // ignore unknown attributes
+            break;
+        }
+    }
+}
+
+// Fills in the normals and tangents that primitiveCounts() made room for but
+// the primitive does not have, so the viewer never has to
+void generateTangentSpace(const cgltf_primitive& primitive, const MeshArrays& mesh) {
+    if (!mesh.vertexNormals.empty() && !findAttribute(primitive, cgltf_attribute_type_normal))
+        generateNormals(mesh.triangleVertices, mesh.vertexPositions, mesh.vertexNormals);
+    if (!mesh.vertexTangents.empty() && !findAttribute(primitive, cgltf_attribute_type_tangent))
+        generateTangents(mesh.triangleVertices, mesh.vertexPositions, mesh.vertexNormals,
+                         mesh.vertexTexCoords0, mesh.vertexTangents);
+}
+
+// A mesh converted into owned memory so that passes that change array sizes
+// can run before its final size is allocated in the output file
+struct ProcessedMesh {
+    MeshData                        mesh;
+    size_t                          weldedVertices = 0;
+    size_t                          degenerateTriangles = 0;
+    std::optional<VertexCacheStats> cacheBefore = {};
+    std::optional<VertexCacheStats> cacheAfter = {};
+};
+
+bool needsProcessing(const ConvertOptions& options) {
+    return options.weld || options.optimizeVertexCache;
+}
+
+// Whether a mesh's triangles are written to the MeshIndicesHeader instead of
+// the rtr mesh
+bool replacesTriangles(const ConvertOptions& options, const MeshCounts& counts) {
+    switch (options.indexFormat) {
+    case IndexFormat::uint32:
+        return false;
+    case IndexFormat::compact:
+        return counts.vertexPositions <= 65536;
+    case IndexFormat::encoded:
+        return true;
+    }
+    return false;
+}
+
+void weldMesh(ProcessedMesh& mesh, const ConvertOptions& options) {
+    mesh.weldedVertices += weldVertices(mesh.mesh, options.weldEpsilon);
+    mesh.degenerateTriangles += removeDegenerateTriangles(mesh.mesh);
+    mesh.weldedVertices += removeUnusedVertices(mesh.mesh);
+}
+
+void reorderMesh(ProcessedMesh& mesh) {
+    mesh.cacheBefore = analyzeVertexCache(mesh.mesh);
+    optimizeVertexCache(mesh.mesh);
+    optimizeVertexFetch(mesh.mesh);
+    mesh.cacheAfter = analyzeVertexCache(mesh.mesh);
+}
+
+ProcessedMesh processPrimitive(const cgltf_primitive& primitive, const ConvertOptions& options) {
+    ProcessedMesh result{allocateMesh(primitiveCounts(primitive, options))};
+    convertPrimitive(primitive, arraysOf(result.mesh));
+    if (options.weld)
+        weldMesh(result, options);
+    // Generated after welding so that normals are smoothed across welded
+    // vertices
+    generateTangentSpace(primitive, arraysOf(result.mesh));
+    if (options.optimizeVertexCache)
+        reorderMesh(result);
+    return result;
+}
+
+// Static instances with the same material, vertex arrays and optional grid
+// cell, merged into one pre-transformed mesh drawn from the scene's root
+struct StaticBatch {
+    struct Part {
+        const cgltf_node*      node;
+        const cgltf_primitive* primitive;
+        glm::mat4              transform;
+    };
+    size_t                scene;
+    const cgltf_material* material;
+    std::vector<Part>     parts = {};
+    uint64_t              vertexCount = 0;
+};
+
+struct BatchPlan {
+    std::vector<StaticBatch> batches;
 
-rtr::common::Material convertGltfMaterial(const WriterAllocator& allocator,
-                                          const fs::path& basePath, const cgltf_material& material,
-                                          TextureCache& textureCache) {
+    // Per scene, whether the instance of each node primitive is replaced by a
+    // batch. Node primitives are numbered node by node.
+    std::vector<std::vector<bool>> batched;
+    size_t                         batchedInstances = 0;
+
+    // Per glTF primitive, numbered mesh by mesh, whether it is only drawn by
+    // batches and its own mesh is not written
+    std::vector<bool> batchedOnly;
+};
+
+// Groups the static instances in each scene into batches. Instances are
+// static if neither their node nor its ancestors are animated and they are
+// not skinned or morphed. Groups are filled in scene traversal order and
+// batches of a single instance are left alone.
+BatchPlan planStaticBatches(const cgltf_data& data, std::span<const size_t> meshFirstPrimitive,
+                            std::span<const size_t> nodeFirstPrimitive,
+                            const ConvertOptions&   options) {
+    std::vector<bool> animated(data.nodes_count, false);
+    for (const auto& animation : std::span(data.animations, data.animations_count))
+        for (const auto& channel : std::span(animation.channels, animation.channels_count))
+            if (channel.target_node)
+                animated[size_t(channel.target_node - data.nodes)] = true;
+
+    auto meshPrimitive = [&](const StaticBatch::Part& part) {
+        const cgltf_mesh& mesh = *part.node->mesh;
+        return meshFirstPrimitive[size_t(&mesh - data.meshes)] +
+               size_t(part.primitive - mesh.primitives);
+    };
+    auto nodePrimitive = [&](const StaticBatch::Part& part) {
+        return nodeFirstPrimitive[size_t(part.node - data.nodes)] +
+               size_t(part.primitive - part.node->mesh->primitives);
+    };
+
+    // Primitives drawn by any instance that is not batched
+    std::vector<bool> unbatched(meshFirstPrimitive.back(), false);
+
+    using GroupKey = std::tuple<const cgltf_material*, uint32_t, int, int, int>;
+    BatchPlan                      result;
+    std::vector<StaticBatch::Part> candidates;
+    result.batched.assign(data.scenes_count, std::vector<bool>(nodeFirstPrimitive.back(), false));
+
+    // Depth first, parents before children, with an explicit stack
+    struct Visit {
+        const cgltf_node* node;
+        glm::mat4         parentTransform;
+        bool              parentStatic;
+    };
+    std::vector<Visit> stack;
+    for (size_t scene = 0; scene < data.scenes_count; ++scene) {
+        candidates.clear();
+        std::span roots(data.scenes[scene].nodes, data.scenes[scene].nodes_count);
+        for (auto root = roots.rbegin(); root != roots.rend(); ++root)
+            stack.push_back(Visit{*root, glm::identity<glm::mat4>(), true});
+        size_t visited = 0;
+        while (!stack.empty()) {
+            Visit visit = stack.back();
+            stack.pop_back();
+            if (++visited > data.nodes_count)
+                throw std::runtime_error("glTF node hierarchy is not a set of trees");
+            const cgltf_node& node = *visit.node;
+            glm::mat4         transform = visit.parentTransform * cgltfTransform(node);
+            bool              isStatic =
+                visit.parentStatic && !animated[size_t(&node - data.nodes)] && !node.skin;
+            if (node.mesh) {
+                for (const auto& primitive :
+                     std::span(node.mesh->primitives, node.mesh->primitives_count)) {
+                    StaticBatch::Part part{&node, &primitive, transform};
+                    if (isStatic && !primitive.targets_count && !node.has_mesh_gpu_instancing)
+                        candidates.push_back(part);
+                    else
+                        unbatched[meshPrimitive(part)] = true;
+                }
+            }
+            for (size_t child = node.children_count; child-- > 0;)
+                stack.push_back(Visit{node.children[child], transform, isStatic});
+        }
+
+        std::map<GroupKey, size_t> openBatches;
+        std::vector<StaticBatch>   sceneBatches;
+        for (const StaticBatch::Part& candidate : candidates) {
+            MeshCounts counts = primitiveCounts(*candidate.primitive, options);
+            if (counts.vertexPositions > options.batchMaxVertices) {
+                unbatched[meshPrimitive(candidate)] = true;
+                continue;
+            }
+            uint32_t arrays = (counts.vertexNormals ? 1u : 0u) |
+                              (counts.vertexTexCoords0 ? 2u : 0u) |
+                              (counts.vertexTangents ? 4u : 0u);
+
+            // Cells are chosen by the world space center of the bounds
+            glm::ivec3 cell(0);
+            if (options.batchCellSize > 0.0f) {
+                glm::vec3             center(0.0f);
+                const cgltf_accessor* positions =
+                    findAttribute(*candidate.primitive, cgltf_attribute_type_position);
+                if (positions && positions->has_min && positions->has_max)
+                    center = (glm::make_vec3(positions->min) + glm::make_vec3(positions->max)) *
+                             0.5f;
+                center = glm::vec3(candidate.transform * glm::vec4(center, 1.0f));
+                cell = glm::ivec3(glm::floor(center / options.batchCellSize));
+            }
+
+            // Full batches are closed and a new one opened for the group
+            GroupKey key{candidate.primitive->material, arrays, cell.x, cell.y, cell.z};
+            auto     open = openBatches.find(key);
+            if (open == openBatches.end() ||
+                sceneBatches[open->second].vertexCount + counts.vertexPositions >
+                    options.batchMaxVertices) {
+                openBatches[key] = sceneBatches.size();
+                sceneBatches.push_back(
+                    StaticBatch{.scene = scene, .material = candidate.primitive->material});
+            }
+            StaticBatch& batch = sceneBatches[openBatches[key]];
+            batch.parts.push_back(candidate);
+            batch.vertexCount += counts.vertexPositions;
+        }
+        for (StaticBatch& batch : sceneBatches) {
+            if (batch.parts.size() == 1) {
+                unbatched[meshPrimitive(batch.parts[0])] = true;
+                continue;
+            }
+            for (const StaticBatch::Part& part : batch.parts)
+                result.batched[scene][nodePrimitive(part)] = true;
+            result.batchedInstances += batch.parts.size();
+            result.batches.push_back(std::move(batch));
+        }
+    }
+    result.batchedOnly.assign(unbatched.size(), false);
+    for (const StaticBatch& batch : result.batches)
+        for (const StaticBatch::Part& part : batch.parts)
+            if (!unbatched[meshPrimitive(part)])
+                result.batchedOnly[meshPrimitive(part)] = true;
+    return result;
+}
+
+// Converts and transforms each instance of a batch into one mesh in owned
+// memory. Tangent space is generated per part, before merging, as it depends
+// on each primitive's own attributes.
+ProcessedMesh processBatch(const StaticBatch& batch, const ConvertOptions& options) {
+    ProcessedMesh result;
+    for (const StaticBatch::Part& part : batch.parts) {
+        MeshData mesh = allocateMesh(primitiveCounts(*part.primitive, options));
+        convertPrimitive(*part.primitive, arraysOf(mesh));
+        generateTangentSpace(*part.primitive, arraysOf(mesh));
+        appendTransformed(result.mesh, mesh, part.transform);
+    }
+    if (options.weld)
+        weldMesh(result, options);
+    if (options.optimizeVertexCache)
+        reorderMesh(result);
+    return result;
+}
+
+// Textures are gathered while converting materials and encoded afterwards so
+// that the expensive decode and encode can run in parallel. Swizzled outputs
+// reference their source image so each image is only decoded once.
+struct TextureOutput {
+    uint32_t  source;
+    KtxOutput output;
+};
+
+struct TextureCache {
+    std::unordered_map<std::string, uint32_t> indices;
+    std::unordered_map<std::string, uint32_t> sourceIndices;
+    std::vector<fs::path>                     sources;
+    std::vector<TextureOutput>                textures;
+};
+
+rtr::common::Material convertGltfMaterial(const fs::path&        basePath,
+                                          const cgltf_material& material,
+                                          const ConvertOptions&  options,
+                                          TextureCache&          textureCache) {
     rtr::common::Material result;
     result.factors = {
         .color = glm::make_vec4(material.pbr_metallic_roughness.base_color_factor),
         .metallic = material.pbr_metallic_roughness.metallic_factor,
         .roughness = material.pbr_metallic_roughness.roughness_factor,
     };
-    auto convertTexture = [&allocator, &textureCache, &basePath](cgltf_texture*   cgltfTexture,
-                                                                 std::string_view swizzle = {}) {
+    // Per-slot block compression presets, given the slot's BC format
+    auto encoding = [&options](KtxEncoding bc) {
+        switch (options.textureCompression) {
+        case TextureCompression::bc: return bc;
+        case TextureCompression::astc: return KtxEncoding::astc;
+        default: return KtxEncoding::uncompressed;
+        }
+    };
+    auto convertTexture = [&textureCache, &basePath](cgltf_texture*   cgltfTexture,
+                                                     const KtxOutput& output) {
         rtr::optional_index32 result;
         if (cgltfTexture && cgltfTexture->image && cgltfTexture->image->uri) {
             std::string texturePath = cgltfTexture->image->uri;
             cgltf_decode_uri(texturePath.data()); // *facepalm*
             texturePath.resize(strlen(texturePath.data()));
-            auto key = (texturePath + ":") + std::string(swizzle);
+            auto key = texturePath + ":" + output.swizzle + ":" +
+                       std::to_string(int(output.encoding)) + (output.color ? ":color" : "");
             auto [it, created] =
-                textureCache.try_emplace(key, IndexedTexture{uint32_t(textureCache.size()), {}});
-            auto& [textureIndex, texture] = it->second;
+                textureCache.indices.try_emplace(key, uint32_t(textureCache.textures.size()));
             if (created) {
-                std::span<uint8_t> ktxData =
-                    convertToKtx(allocator, basePath / texturePath, swizzle);
-                texture = rtr::common::Texture{
-                    .ktx = reinterpret_cast<rtr::ktx::Header*>(ktxData.data())};
-                if (!texture.ktx->validateIdentifier())
-                    throw std::runtime_error("Converted KTX texture failed validation");
+                auto [sourceIt, sourceCreated] = textureCache.sourceIndices.try_emplace(
+                    texturePath, uint32_t(textureCache.sources.size()));
+                if (sourceCreated)
+                    textureCache.sources.push_back(basePath / texturePath);
+                textureCache.textures.push_back({sourceIt->second, output});
             }
-            result = textureIndex;
+            result = it->second;
         } else if (cgltfTexture && cgltfTexture->image && !cgltfTexture->image->uri) {
             fprintf(stderr, "Warning: skipping gltf image with no uri (possibly embedded)\n");
         }
         return result;
     };
     result.textures.color =
-        convertTexture(material.pbr_metallic_roughness.base_color_texture.texture);
-    result.textures.metallic =
-        convertTexture(material.pbr_metallic_roughness.metallic_roughness_texture.texture, "b");
-    result.textures.roughness =
-        convertTexture(material.pbr_metallic_roughness.metallic_roughness_texture.texture, "g");
-    result.textures.normal = convertTexture(material.normal_texture.texture);
+        convertTexture(material.pbr_metallic_roughness.base_color_texture.texture,
+                       {.swizzle = "", .encoding = encoding(KtxEncoding::bc7), .color = true});
+    cgltf_texture* metallicRoughness =
+        material.pbr_metallic_roughness.metallic_roughness_texture.texture;
+    if (options.packMetallicRoughness) {
+        result.textures.metallic = result.textures.roughness = convertTexture(
+            metallicRoughness, {.swizzle = "bg", .encoding = encoding(KtxEncoding::bc5)});
+    } else {
+        result.textures.metallic = convertTexture(
+            metallicRoughness, {.swizzle = "b", .encoding = encoding(KtxEncoding::bc4)});
+        result.textures.roughness = convertTexture(
+            metallicRoughness, {.swizzle = "g", .encoding = encoding(KtxEncoding::bc4)});
+    }
+
+    // BC5 normals keep XY only and the viewer reconstructs Z
+    KtxEncoding normalEncoding = encoding(KtxEncoding::bc5);
+    result.textures.normal = convertTexture(
+        material.normal_texture.texture,
+        {.swizzle = normalEncoding == KtxEncoding::bc5 ? "rg" : "", .encoding = normalEncoding});
+    return result;
+}
+
+// Decoded images are kept between hashing and encoding, up to this many bytes.
+// The remainder are decoded twice rather than holding every image in memory.
+constexpr size_t KeepDecodedBytes = size_t(1) << 30;
+
+// Bump whenever converted output changes, to invalidate cached artifacts
+constexpr uint32_t CacheVersion = 3;
+
+// Cache key for an encoded texture: the source file bytes plus everything that
+// affects encoding
+uint64_t textureCacheKey(uint64_t fileHash, const KtxOutput& output, const KtxOptions& options) {
+    struct Key {
+        uint32_t version;
+        uint32_t kind;
+        uint32_t encoding;
+        uint32_t color;
+        uint32_t mipmaps;
+        uint32_t maxSize;
+        uint32_t quality;
+        char     swizzle[4];
+        uint64_t fileHash;
+    } key{
+        .version = CacheVersion,
+        .kind = 0,
+        .encoding = uint32_t(output.encoding),
+        .color = output.color,
+        .mipmaps = options.mipmaps,
+        .maxSize = options.maxSize,
+        .quality = uint32_t(options.quality),
+        .swizzle = {},
+        .fileHash = fileHash,
+    };
+    std::ranges::copy(output.swizzle, key.swizzle);
+    return hashObject(key);
+}
+
+// Hashes the bytes an accessor references along with its layout. Returns
+// nothing for accessors that are not plain buffer views, e.g. sparse ones.
+std::optional<uint64_t> hashAccessor(const cgltf_accessor& accessor, uint64_t seed) {
+    if (accessor.is_sparse || !accessor.buffer_view || !accessor.buffer_view->buffer->data)
+        return std::nullopt;
+    const cgltf_buffer_view& view = *accessor.buffer_view;
+    struct Layout {
+        uint64_t count;
+        uint64_t stride;
+        uint64_t elementSize;
+        uint32_t componentType;
+        uint32_t type;
+        uint32_t normalized;
+        uint32_t reserved;
+    } layout{
+        .count = accessor.count,
+        .stride = view.stride ? view.stride : accessor.stride,
+        .elementSize = cgltf_calc_size(accessor.type, accessor.component_type),
+        .componentType = uint32_t(accessor.component_type),
+        .type = uint32_t(accessor.type),
+        .normalized = uint32_t(accessor.normalized),
+        .reserved = 0,
+    };
+    size_t bytes = layout.count ? layout.stride * (layout.count - 1) + layout.elementSize : 0;
+    return hash64({reinterpret_cast<const uint8_t*>(view.buffer->data) + view.offset +
+                       accessor.offset,
+                   bytes},
+                  hashObject(layout, seed));
+}
+
+// Cache key for a converted mesh: its mode, the bytes of every accessor it
+// reads and the options that affect it
+std::optional<uint64_t> primitiveCacheKey(const cgltf_primitive& primitive,
+                                          const ConvertOptions&  options) {
+    struct Key {
+        uint32_t version;
+        uint32_t kind;
+        uint32_t generateTangentSpace;
+        uint32_t weld;
+        uint32_t weldEpsilon;
+        uint32_t optimizeVertexCache;
+    } key{CacheVersion,
+          1,
+          options.generateTangentSpace,
+          options.weld,
+          std::bit_cast<uint32_t>(options.weldEpsilon),
+          options.optimizeVertexCache};
+    // Each accessor is hashed with its attribute's type and set index, in
+    // the sorted order of primitiveKey(), e.g. so swapped texture coordinate
+    // sets do not match. Its first entry is the mode and indices.
+    std::optional<uint64_t> result = hashObject(key);
+    for (const auto& [type, index, accessor] : primitiveKey(primitive)) {
+        if (!result)
+            break;
+        uint64_t seed = hashObject(std::array{uint32_t(type), uint32_t(index)}, *result);
+        result = accessor ? hashAccessor(*accessor, seed) : seed;
+    }
+    return result;
+}
+
+// Cached meshes are each array's element count followed by all array data
+void storeMesh(ArtifactCache& cache, uint64_t key, const MeshCounts& counts,
+               const MeshArrays& mesh) {
+    std::vector<std::span<const uint8_t>> parts;
+    parts.push_back(bytesOf(std::span(&counts, 1)));
+#define RTR_ARRAY(type, name) parts.push_back(bytesOf(std::span<const type>(mesh.name)));
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    cache.store(key, parts);
+}
+
+// Returns a cached mesh's array sizes, or nothing if the payload is damaged
+std::optional<MeshCounts> cachedMeshCounts(std::span<const uint8_t> payload) {
+    MeshCounts counts;
+    if (payload.size() < sizeof(counts))
+        return std::nullopt;
+    std::memcpy(&counts, payload.data(), sizeof(counts));
+    uint64_t bytes = sizeof(counts);
+#define RTR_ARRAY(type, name) bytes += counts.name * sizeof(type);
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    if (bytes != payload.size())
+        return std::nullopt;
+    return counts;
+}
+
+// Copies a cached mesh, validated by cachedMeshCounts(), into its arrays
+void loadMesh(std::span<const uint8_t> payload, const MeshArrays& mesh) {
+    payload = payload.subspan(sizeof(MeshCounts));
+#define RTR_ARRAY(type, name)                                                                      \
+    std::copy_n(payload.data(), mesh.name.size_bytes(),                                            \
+                reinterpret_cast<uint8_t*>(mesh.name.data()));                                     \
+    payload = payload.subspan(mesh.name.size_bytes());
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+}
+
+// Cached textures are their content hash followed by the KTX file. Returns
+// whether the payload holds a complete file.
+bool validCachedTexture(std::span<const uint8_t> payload) {
+    return payload.size() >= sizeof(Hash128) && validKtxFile(payload.subspan(sizeof(Hash128)));
+}
+
+// Textures with identical content, even from different URIs, are written once.
+// Each output is hashed from its decoded pixels and encoding, which determine
+// the KTX bytes exactly. Cached textures have no pixels to compare, so outputs
+// are merged on a 128-bit hash alone rather than risk a 64-bit collision
+// silently swapping one texture for another. Unique textures are then
+// allocated in the writer in index order, so the output does not depend on
+// thread timing, and encoded in place on a thread pool. 'remap' maps
+// TextureCache indices to the returned textures.
+//
+// With a cache, textures are first looked up by their source file bytes. Cache
+// entries hold the content hash and the KTX file, so hits are never decoded.
+// Damaged entries are treated as misses and re-encoded.
+std::vector<rtr::common::Texture> convertTextures(const WriterAllocator& allocator,
+                                                  const TextureCache&    textureCache,
+                                                  const ConvertOptions&  options,
+                                                  ArtifactCache*         cache,
+                                                  std::vector<uint32_t>& remap,
+                                                  ConvertStats&          stats) {
+    // Threads are split between images first. Any left over are given to the
+    // block compressor within each image.
+    const unsigned jobs = jobCount(options.jobs);
+    const size_t   concurrentImages = std::clamp<size_t>(textureCache.sources.size(), 1, jobs);
+    KtxOptions     ktxOptions{
+            .mipmaps = options.mipmaps,
+            .maxSize = options.maxTextureSize,
+            .quality = KtxQuality::balanced,
+            .encoderThreads = unsigned(jobs / concurrentImages),
+    };
+    switch (options.textureQuality) {
+    case TextureQuality::fast: ktxOptions.quality = KtxQuality::fast; break;
+    case TextureQuality::quality: ktxOptions.quality = KtxQuality::quality; break;
+    default: break;
+    }
+
+    std::vector<std::vector<uint32_t>> sourceTextures(textureCache.sources.size());
+    for (uint32_t i = 0; i < textureCache.textures.size(); ++i)
+        sourceTextures[textureCache.textures[i].source].push_back(i);
+
+    const size_t                           textureCount = textureCache.textures.size();
+    std::vector<std::optional<KtxSource>>  sources(textureCache.sources.size());
+    std::vector<size_t>                    outputIndices(textureCount);
+    std::vector<uint64_t>                  cacheKeys(textureCount);
+    std::vector<std::optional<CacheEntry>> cached(textureCount);
+    std::atomic<size_t>                    keptBytes = 0;
+    parallelFor(options.jobs, sources.size(), [&](size_t i) {
+        std::vector<uint32_t> misses;
+        if (cache) {
+            decodeless::file file(textureCache.sources[i]);
+            uint64_t         fileHash = hash64(
+                std::span(reinterpret_cast<const uint8_t*>(file.data()), file.size()));
+            for (uint32_t texture : sourceTextures[i]) {
+                cacheKeys[texture] =
+                    textureCacheKey(fileHash, textureCache.textures[texture].output, ktxOptions);
+                cached[texture] = cache->find(cacheKeys[texture]);
+                if (cached[texture] && !validCachedTexture(cached[texture]->payload()))
+                    cached[texture].reset();
+                if (!cached[texture])
+                    misses.push_back(texture);
+            }
+        } else {
+            misses = sourceTextures[i];
+        }
+        if (misses.empty())
+            return;
+
+        KtxSource& source = sources[i].emplace(textureCache.sources[i], ktxOptions);
+        for (uint32_t texture : misses)
+            outputIndices[texture] = source.addOutput(textureCache.textures[texture].output);
+        const size_t bytes = source.decodedBytes();
+        const bool   keep = keptBytes.fetch_add(bytes) + bytes <= KeepDecodedBytes;
+        if (!keep)
+            keptBytes -= bytes;
+        source.prepare(keep);
+    });
+
+    std::vector<rtr::common::Texture>      result;
+    std::map<Hash128, uint32_t>            uniqueIndices;
+    std::vector<std::span<uint8_t>>        uniqueFiles;
+    std::vector<Hash128>                   contentHashes(textureCount);
+    std::vector<std::span<uint8_t>>        cachedDestinations(textureCount);
+    remap.resize(textureCount);
+    for (uint32_t i = 0; i < textureCount; ++i) {
+        std::span<const uint8_t> cachedKtx;
+        if (cached[i]) {
+            std::span<const uint8_t> payload = cached[i]->payload();
+            std::memcpy(&contentHashes[i], payload.data(), sizeof(Hash128));
+            cachedKtx = payload.subspan(sizeof(Hash128));
+        } else {
+            contentHashes[i] =
+                sources[textureCache.textures[i].source]->outputHash(outputIndices[i]);
+        }
+        auto [it, created] = uniqueIndices.try_emplace(contentHashes[i], uint32_t(result.size()));
+        remap[i] = it->second;
+        if (!created) {
+            stats.duplicateTextures++;
+            stats.duplicateTextureBytes += uniqueFiles[it->second].size();
+            continue;
+        }
+
+        // Cached files are copied in later, in parallel
+        std::span<uint8_t> ktxData;
+        if (cached[i]) {
+            auto ptr = allocator.resource()->allocate(cachedKtx.size(), sizeof(std::max_align_t));
+            ktxData = {reinterpret_cast<uint8_t*>(ptr), cachedKtx.size()};
+            cachedDestinations[i] = ktxData;
+        } else {
+            ktxData = sources[textureCache.textures[i].source]->allocate(allocator,
+                                                                         outputIndices[i]);
+            if (!reinterpret_cast<const rtr::ktx::Header*>(ktxData.data())->validateIdentifier())
+                throw std::runtime_error("Converted KTX texture failed validation");
+        }
+        uniqueFiles.push_back(ktxData);
+        result.push_back(
+            rtr::common::Texture{.ktx = reinterpret_cast<rtr::ktx::Header*>(ktxData.data())});
+    }
+
+    parallelFor(options.jobs, sources.size(), [&](size_t i) {
+        if (sources[i]) {
+            sources[i]->write();
+            sources[i].reset();
+        }
+        for (uint32_t texture : sourceTextures[i]) {
+            if (!cachedDestinations[texture].empty())
+                std::ranges::copy(cached[texture]->payload().subspan(sizeof(Hash128)),
+                                  cachedDestinations[texture].begin());
+        }
+    });
+
+    if (cache) {
+        parallelFor(options.jobs, textureCount, [&](size_t i) {
+            if (cached[i])
+                return;
+            std::span<const uint8_t> parts[] = {
+                bytesOf(std::span<const Hash128>(&contentHashes[i], 1)), uniqueFiles[remap[i]]};
+            cache->store(cacheKeys[i], parts);
+        });
+    }
     return result;
 }
 
+// EXT_mesh_gpu_instancing attributes are not known to cgltf, so are found by
+// name
+const cgltf_accessor* findInstancingAttribute(const cgltf_node& node, std::string_view name) {
+    for (const auto& attrib : std::span(node.mesh_gpu_instancing.attributes,
+                                        node.mesh_gpu_instancing.attributes_count))
+        if (attrib.name && name == attrib.name)
+            return attrib.data;
+    return nullptr;
+}
+
+constexpr std::array<std::string_view, 3> InstancingAttributes{"TRANSLATION", "ROTATION", "SCALE"};
+
+size_t gpuInstanceCount(const cgltf_node& node) {
+    std::optional<size_t> result;
+    for (std::string_view name : InstancingAttributes) {
+        if (const cgltf_accessor* accessor = findInstancingAttribute(node, name)) {
+            if (result && *result != accessor->count)
+                throw std::runtime_error("EXT_mesh_gpu_instancing accessor counts do not match");
+            result = accessor->count;
+        }
+    }
+    return result.value_or(0);
+}
+
+// Converts a node's instance translations, rotations and scales, which may be
+// normalized integers, to floats and composes them. Missing attributes are
+// the identity.
+void convertGpuInstances(const cgltf_node& node, std::span<glm::mat4x3> transforms) {
+    std::vector<glm::vec3> translations(transforms.size(), glm::vec3(0.0f));
+    std::vector<glm::vec4> rotations(transforms.size(), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    std::vector<glm::vec3> scales(transforms.size(), glm::vec3(1.0f));
+    if (const cgltf_accessor* accessor = findInstancingAttribute(node, "TRANSLATION"))
+        convertInto(*accessor, std::span(translations));
+    if (const cgltf_accessor* accessor = findInstancingAttribute(node, "ROTATION"))
+        convertInto(*accessor, std::span(rotations));
+    if (const cgltf_accessor* accessor = findInstancingAttribute(node, "SCALE"))
+        convertInto(*accessor, std::span(scales));
+    static_assert(sizeof(glm::mat4x3) == sizeof(float) * 12);
+    composeTransforms(reinterpret_cast<const float*>(translations.data()),
+                      reinterpret_cast<const float*>(rotations.data()),
+                      reinterpret_cast<const float*>(scales.data()), transforms.size(),
+                      reinterpret_cast<float*>(transforms.data()));
+}
+
 using NodeIterator = decodeless::offset_span<rtr::Node>::iterator;
 
-NodeIterator
-writeNodesRecursive(const WriterAllocator& allocator, std::span<const cgltf_node* const> inputs,
-                    std::function<void(const cgltf_node&, const NodeIterator&)> visitor,
-                    const NodeIterator& parent, NodeIterator output) {
-    for (const cgltf_node* const gltfNode : inputs) {
+// Writes the trees under 'roots' after 'output', parents before children, and
+// calls visitor(gltfNode, rtrNode) once each node's subtree is written. An
+// explicit stack replaces recursion so deep hierarchies cannot overflow the
+// call stack. Cycles and nodes reached too many times throw rather than
+// writing past 'end'.
+template <class Visitor>
+NodeIterator writeNodes(std::span<const cgltf_node* const> roots, NodeIterator parent,
+                        NodeIterator output, NodeIterator end, Visitor&& visitor) {
+    struct Frame {
+        const cgltf_node* gltfNode;
+        NodeIterator      rtrNode;
+        size_t            nextChild;
+    };
+    std::vector<Frame> stack;
+    auto               push = [&](const cgltf_node& gltfNode, NodeIterator parentNode) {
+        if (output == end)
+            throw std::runtime_error("glTF node hierarchy is not a set of trees");
         auto rtrNode = output++;
         *rtrNode = {};
-        rtrNode->transform = cgltfTransform(*gltfNode);
-        rtrNode->parentOffset = uint32_t(rtrNode - parent);
-        std::span children(gltfNode->children, gltfNode->children_count);
-        output = writeNodesRecursive(allocator, children, visitor, rtrNode, output);
-        rtrNode->descendantCount = uint32_t(output - rtrNode) - 1;
-        visitor(*gltfNode, rtrNode);
+        rtrNode->transform = cgltfTransform(gltfNode);
+        rtrNode->parentOffset = uint32_t(rtrNode - parentNode);
+        stack.push_back(Frame{&gltfNode, rtrNode, 0});
+    };
+    for (const cgltf_node* root : roots) {
+        push(*root, parent);
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            if (frame.nextChild < frame.gltfNode->children_count) {
+                push(*frame.gltfNode->children[frame.nextChild++], frame.rtrNode);
+                continue;
+            }
+            frame.rtrNode->descendantCount = uint32_t(output - frame.rtrNode) - 1;
+            visitor(*frame.gltfNode, frame.rtrNode);
+            stack.pop_back();
+        }
     }
     return output;
 }
 
-rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator, const fs::path& path) {
+rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator, const fs::path& path,
+                                 const ConvertOptions& options, ConvertStats* stats) {
+    ConvertStats     localStats;
     cgltf_options    gltfOptions{};
     decodeless::file gltfFile(path);
     std::span        gltfData(reinterpret_cast<const std::byte*>(gltfFile.data()), gltfFile.size());
@@ -125,89 +952,69 @@ rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator, const fs::pat
         }
     }
 
-    std::unordered_map<const cgltf_primitive*, size_t> meshIndices;
-    std::unordered_map<const cgltf_material*, size_t>  materialIndices;
-
-    // Build mesh arrays to pass to rtr::common::MeshHeader::create()
-    std::vector<rtr::common::Mesh> meshes;
-    std::vector<std::string_view>  meshNames;
-    std::vector<MeshData>          temporary;
-    std::vector<std::string>       meshNamesTmp;
-    for (const auto& mesh : std::span(data->meshes, data->meshes_count)) {
-        temporary.emplace_back();
-        uint32_t primitiveIndex = 0;
-        for (const auto& primitive : std::span(mesh.primitives, mesh.primitives_count)) {
-            // TODO: sometimes primitives can be duplicated to reference the
-            // same mesh with multiple materials. Need a primitive equality
-            // operator and hash.
-            meshIndices[&primitive] = meshes.size();
-            meshes.emplace_back();
-            materialIndices.try_emplace(primitive.material, materialIndices.size());
-            meshes.back().triangleVertices = rtrtool::convert<uint32_t, const glm::uvec3>(
-                *primitive.indices, temporary.back().triangleVertices);
-            for (const auto& attrib : std::span(primitive.attributes, primitive.attributes_count)) {
-                // Why do I need an explicit "const" here. GCC 13.2.1 bug?
-                switch (attrib.type) {
-                case cgltf_attribute_type_position:
-                    meshes.back().vertexPositions = rtrtool::convert<glm::vec3, const glm::vec3>(
-                        *attrib.data, temporary.back().vertexPositions);
-                    break;
-                case cgltf_attribute_type_normal:
-                    meshes.back().vertexNormals = rtrtool::convert<glm::vec3, const glm::vec3>(
-                        *attrib.data, temporary.back().vertexNormals);
-                    break;
-                case cgltf_attribute_type_texcoord:
-                    meshes.back().vertexTexCoords0 = rtrtool::convert<glm::vec2, const glm::vec2>(
-                        *attrib.data, temporary.back().vertexTexCoords0);
-                    break;
-                case cgltf_attribute_type_tangent:
-                    meshes.back().vertexTangents = rtrtool::convert<glm::vec4, const glm::vec4>(
-                        *attrib.data, temporary.back().vertexTangents);
-                    break;
-                default:
-                    // ignore unknown attributes
-                    break;
-                }
-            }
-            if (mesh.primitives_count == 1)
-                meshNames.push_back(mesh.name);
-            else {
-                meshNamesTmp.push_back(std::string(mesh.name) + std::to_string(primitiveIndex++));
-                meshNames.push_back(meshNamesTmp.back());
-            }
-        }
+    // Mesh and material indices of each glTF primitive and material, by their
+    // position in cgltf's arrays rather than hashing pointers. Primitives are
+    // numbered mesh by mesh, followed by one slot per static batch, and a null
+    // material takes the last slot.
+    std::vector<size_t> meshFirstPrimitive(data->meshes_count + 1, 0);
+    for (size_t i = 0; i < data->meshes_count; ++i)
+        meshFirstPrimitive[i + 1] = meshFirstPrimitive[i] + data->meshes[i].primitives_count;
+    const size_t primitiveCount = meshFirstPrimitive.back();
+
+    auto primitiveIndex = [&](const cgltf_mesh& mesh, const cgltf_primitive& primitive) {
+        return meshFirstPrimitive[size_t(&mesh - data->meshes)] +
+               size_t(&primitive - mesh.primitives);
+    };
+    auto materialSlot = [&](const cgltf_material* material) {
+        return material ? size_t(material - data->materials) : data->materials_count;
+    };
+
+    // Primitives of each node, numbered node by node, for per-instance flags
+    std::vector<size_t> nodeFirstPrimitive(data->nodes_count + 1, 0);
+    for (size_t i = 0; i < data->nodes_count; ++i) {
+        const cgltf_mesh* mesh = data->nodes[i].mesh;
+        nodeFirstPrimitive[i + 1] = nodeFirstPrimitive[i] + (mesh ? mesh->primitives_count : 0);
     }
 
+    std::optional<ArtifactCache> cache;
+    if (!options.cacheDirectory.empty())
+        cache.emplace(options.cacheDirectory, options.cacheMaxBytes);
+
+    // Static batches are written as extra meshes, drawn from the scene roots
+    BatchPlan batchPlan;
+    if (options.batchStaticInstances)
+        batchPlan = planStaticBatches(*data, meshFirstPrimitive, nodeFirstPrimitive, options);
+
+    // Data is laid out in the order a viewer first reads it: the sub-header
+    // table, the scene and its instances, the meshes in order of first use,
+    // each with its streams together, then materials and textures. KTX files
+    // already store their smallest levels first. Everything is allocated from
+    // this thread in a fixed order, so the output does not depend on thread
+    // timing or hash table iteration.
+    // The sub-headers written depend only on the options and whether any node
+    // is instanced, so the table can be allocated before them.
+    bool gpuInstancing =
+        std::ranges::any_of(std::span(data->nodes, data->nodes_count), [](const cgltf_node& node) {
+            return node.mesh && node.has_mesh_gpu_instancing;
+        });
+
+    size_t headerCount = 4 + size_t(options.buildMeshlets) + size_t(options.generateLods) +
+                         size_t(options.indexFormat != IndexFormat::uint32) +
+                         size_t(options.quantizeVertices) + size_t(options.buildBvh) +
+                         size_t(gpuInstancing);
+
     // File root header. Must be the first object allocated!
     rtr::RootHeader* header = decodeless::create::object<rtr::RootHeader>(allocator);
     std::vector<decodeless::offset_ptr<decodeless::Header>> subHeaders;
 
-    // Write meshes
-    subHeaders.push_back(rtr::common::createMeshHeader(allocator, meshes, meshNames));
-
-    // Write materials
-    rtr::common::MaterialHeader* materialHeader =
-        decodeless::create::object<rtr::common::MaterialHeader>(allocator);
-    materialHeader->materials =
-        decodeless::create::array<rtr::common::Material>(allocator, materialIndices.size());
-    TextureCache textureCache;
-    for (const auto& [cgltfMaterial, materialIndex] : materialIndices) {
-        if (cgltfMaterial) {
-            materialHeader->materials[materialIndex] =
-                convertGltfMaterial(allocator, path.parent_path(), *cgltfMaterial, textureCache);
-        } else {
-            // Default material
-            materialHeader->materials[materialIndex] = rtr::common::Material{};
-        }
-    }
-    materialHeader->textures =
-        decodeless::create::array<rtr::common::Texture>(allocator, textureCache.size());
-    for (const auto& [key, value] : textureCache) {
-        const auto& [textureIndex, texture] = value;
-        materialHeader->textures[textureIndex] = texture;
-    }
-    subHeaders.push_back(materialHeader);
+    // Sub-header table, filled in once they are all written
+    std::span<decodeless::offset_ptr<decodeless::Header>> headerTable =
+        decodeless::create::array<decodeless::offset_ptr<decodeless::Header>>(allocator,
+                                                                               headerCount);
 
+    // Write the scene. Instances first hold the glTF primitive, or
+    // primitiveCount plus the batch, and the material slot they draw. These
+    // are replaced with mesh and material indices once meshes are numbered.
     rtr::SceneHeader* sceneHeader = decodeless::create::object<rtr::SceneHeader>(allocator);
     subHeaders.push_back(sceneHeader);
     std::span<cgltf_scene> gltfScenes{data->scenes, data->scenes_count};
@@ -216,22 +1023,46 @@ rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator, const fs::pat
     sceneHeader->scenes = decodeless::create::array<decodeless::offset_ptr<rtr::Node>>(
         allocator, data->nodes_count + data->scenes_count);
     std::vector<rtr::Instance>         instances;
+    std::vector<InstanceGroup>         instanceGroups;
     std::vector<rtr::Camera>           cameras;
     std::vector<rtr::offset_string>    cameraNames;
     std::vector<rtr::DirectionalLight> directionalLights;
     std::vector<rtr::PointLight>       pointLights;
     std::vector<rtr::SpotLight>        spotLights;
     std::vector<rtr::MeshLight>        meshLights;
+    size_t currentScene = 0;
+
     auto makeAttachments = [&](const cgltf_node& gltfNode, const NodeIterator& rtrNode) {
         uint32_t nodeIndex(rtrNode - sceneHeader->nodes.begin());
         if (gltfNode.mesh) {
+            // Instanced nodes are never batched. Their primitives share one
+            // transform array.
+            std::span<glm::mat4x3> gpuInstances;
+            if (gltfNode.has_mesh_gpu_instancing) {
+                gpuInstances = decodeless::create::array<glm::mat4x3>(allocator,
+                                                                      gpuInstanceCount(gltfNode));
+                convertGpuInstances(gltfNode, gpuInstances);
+                localStats.gpuInstances += gpuInstances.size();
+            }
+            const size_t firstPrimitive = nodeFirstPrimitive[size_t(&gltfNode - data->nodes)];
             for (auto& primitive :
                  std::span(gltfNode.mesh->primitives, gltfNode.mesh->primitives_count)) {
-                instances.push_back(rtr::Instance{
+                size_t nodePrimitive =
+                    firstPrimitive + size_t(&primitive - gltfNode.mesh->primitives);
+                if (!batchPlan.batched.empty() && batchPlan.batched[currentScene][nodePrimitive])
+                    continue;
+                rtr::Instance instance{
                     .node = nodeIndex,
-                    .mesh = uint32_t(meshIndices[&primitive]),
-                    .material = uint32_t(materialIndices[primitive.material]),
-                });
+                    .mesh = uint32_t(primitiveIndex(*gltfNode.mesh, primitive)),
+                    .material = uint32_t(materialSlot(primitive.material)),
+                };
+                if (gltfNode.has_mesh_gpu_instancing) {
+                    InstanceGroup& group = instanceGroups.emplace_back();
+                    group.instance = instance;
+                    group.transforms = gpuInstances;
+                } else {
+                    instances.push_back(instance);
+                }
             }
         }
         if (gltfNode.camera && gltfNode.camera->type == cgltf_camera_type_perspective) {
@@ -274,14 +1105,116 @@ rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator, const fs::pat
     auto nextSceneRootPtr = sceneHeader->scenes.begin();
     auto nextSceneRoot = sceneHeader->nodes.begin();
     for (auto& scene : gltfScenes) {
+        currentScene = size_t(&scene - gltfScenes.data());
+        if (nextSceneRoot == sceneHeader->nodes.end())
+            throw std::runtime_error("glTF node hierarchy is not a set of trees");
         auto sceneRoot = nextSceneRoot++;
         *sceneRoot = {};
         sceneRoot->transform = glm::identity<glm::mat4>();
-        nextSceneRoot = writeNodesRecursive(allocator, std::span(scene.nodes, scene.nodes_count),
-                                            makeAttachments, sceneRoot, nextSceneRoot);
-        sceneRoot->descendantCount = uint32_t(sceneRoot - nextSceneRoot) - 1;
+        nextSceneRoot = writeNodes(std::span(scene.nodes, scene.nodes_count), sceneRoot,
+                                   nextSceneRoot, sceneHeader->nodes.end(), makeAttachments);
+        sceneRoot->descendantCount = uint32_t(nextSceneRoot - sceneRoot) - 1;
         *nextSceneRootPtr++ = &*sceneRoot;
+
+        // Batches are already in world space, so hang off the scene's root
+        for (size_t batch = 0; batch < batchPlan.batches.size(); ++batch)
+            if (batchPlan.batches[batch].scene == currentScene)
+                instances.push_back(rtr::Instance{
+                    .node = uint32_t(sceneRoot - sceneHeader->nodes.begin()),
+                    .mesh = uint32_t(primitiveCount + batch),
+                    .material = uint32_t(materialSlot(batchPlan.batches[batch].material)),
+                });
+    }
+    if (options.batchStaticInstances) {
+        localStats.batchedInstances = batchPlan.batchedInstances;
+        localStats.staticBatches = batchPlan.batches.size();
+        localStats.drawsAfterBatching = instances.size();
+        localStats.drawsBeforeBatching =
+            instances.size() + batchPlan.batchedInstances - batchPlan.batches.size();
     }
+
+    // Number meshes and materials in order of first use by the instances
+    // above. Unused primitives follow so their materials are still written.
+    std::vector<std::pair<const cgltf_mesh*, const cgltf_primitive*>> gltfPrimitives;
+    gltfPrimitives.reserve(primitiveCount);
+    for (const auto& mesh : std::span(data->meshes, data->meshes_count))
+        for (const auto& primitive : std::span(mesh.primitives, mesh.primitives_count))
+            gltfPrimitives.emplace_back(&mesh, &primitive);
+    std::vector<uint32_t> uses;
+    uses.reserve(instances.size() + instanceGroups.size());
+    for (const rtr::Instance& instance : instances)
+        uses.push_back(instance.mesh);
+    for (const InstanceGroup& group : instanceGroups)
+        uses.push_back(group.instance.mesh);
+
+    constexpr uint32_t                 NoIndex = ~0u;
+    const size_t                       meshSlots = primitiveCount + batchPlan.batches.size();
+    std::vector<uint32_t>              meshIndices(meshSlots, NoIndex);
+    std::vector<uint32_t>              materialIndices(data->materials_count + 1, NoIndex);
+    std::vector<const cgltf_material*> materialsByIndex;
+
+    auto useMaterial = [&](const cgltf_material* material) {
+        uint32_t& materialIndex = materialIndices[materialSlot(material)];
+        if (materialIndex == NoIndex) {
+            materialIndex = uint32_t(materialsByIndex.size());
+            materialsByIndex.push_back(material);
+        }
+    };
+
+    // Write meshes. Geometry is converted straight into arrays allocated in the
+    // output file, so each byte is written once. A sizing pass first finds each
+    // array's size from the accessors or the cache. Arrays are then allocated
+    // in mesh order, so the output does not depend on thread timing, and
+    // filled in parallel. Optional passes that change array sizes, e.g.
+    // welding or array deduplication, convert into owned memory during the
+    // sizing pass instead.
+    // Static batches have a null primitive and their index in meshBatches.
+    std::vector<const cgltf_primitive*> meshPrimitives;
+    std::vector<size_t>                 meshBatches;
+    std::vector<std::string>            meshNamesStorage;
+    std::map<PrimitiveKey, size_t>      primitiveMeshes;
+    for (uint32_t use : firstUseOrder(uses, meshSlots)) {
+        if (use >= primitiveCount) {
+            size_t batch = use - primitiveCount;
+            useMaterial(batchPlan.batches[batch].material);
+            meshIndices[use] = uint32_t(meshPrimitives.size());
+            meshPrimitives.push_back(nullptr);
+            meshBatches.push_back(batch);
+            meshNamesStorage.push_back("batch" + std::to_string(batch));
+            continue;
+        }
+
+        // Primitives are often duplicated to reference the same geometry
+        // with different materials. These share one mesh and each instance
+        // carries its own material.
+        auto [mesh, primitive] = gltfPrimitives[use];
+        useMaterial(primitive->material);
+        if (!batchPlan.batchedOnly.empty() && batchPlan.batchedOnly[use])
+            continue;
+        auto [unique, created] =
+            primitiveMeshes.try_emplace(primitiveKey(*primitive), meshPrimitives.size());
+        meshIndices[use] = uint32_t(unique->second);
+        if (!created) {
+            localStats.duplicateMeshes++;
+            continue;
+        }
+        meshPrimitives.push_back(primitive);
+        meshBatches.push_back(0);
+        std::string name = mesh->name ? mesh->name : "";
+        if (mesh->primitives_count == 1)
+            meshNamesStorage.push_back(name);
+        else
+            meshNamesStorage.push_back(name + std::to_string(primitive - mesh->primitives));
+    }
+    auto renumber = [&](rtr::Instance& instance) {
+        instance.mesh = meshIndices[instance.mesh];
+        instance.material = materialIndices[instance.material];
+    };
+    for (rtr::Instance& instance : instances)
+        renumber(instance);
+    for (InstanceGroup& group : instanceGroups)
+        renumber(group.instance);
+
     sceneHeader->instances = decodeless::create::array<rtr::Instance>(allocator, instances);
     sceneHeader->cameras = decodeless::create::array<rtr::Camera>(allocator, cameras);
     sceneHeader->cameraNames =
@@ -292,13 +1225,360 @@ rtr::RootHeader* convertFromGltf(const WriterAllocator& allocator, const fs::pat
     sceneHeader->spotLights = decodeless::create::array<rtr::SpotLight>(allocator, spotLights);
     sceneHeader->meshLights = decodeless::create::array<rtr::MeshLight>(allocator, meshLights);
 
-    // Write sub-headers
+    // Optional EXT_mesh_gpu_instancing copies
+    if (gpuInstancing) {
+        InstancingHeader* instancingHeader =
+            decodeless::create::object<InstancingHeader>(allocator);
+        instancingHeader->groups =
+            decodeless::create::array<InstanceGroup>(allocator, instanceGroups);
+        subHeaders.push_back(instancingHeader);
+        localStats.instanceGroups = instanceGroups.size();
+    }
+
+    // Flattened world transforms of the nodes written above
+    WorldTransforms worldTransforms = flattenHierarchy(std::span<const rtr::Node>(
+        sceneHeader->nodes.data(), size_t(nextSceneRoot - sceneHeader->nodes.begin())));
+    WorldTransformHeader* worldTransformHeader =
+        decodeless::create::object<WorldTransformHeader>(allocator);
+    worldTransformHeader->transforms =
+        decodeless::create::array<glm::mat4>(allocator, worldTransforms.transforms);
+    worldTransformHeader->roots =
+        decodeless::create::array<uint32_t>(allocator, worldTransforms.roots);
+    subHeaders.push_back(worldTransformHeader);
+
+    // The mesh table comes before the arrays. It is created with empty meshes
+    // and then pointed at the arrays below, rather than passing them in to be
+    // copied.
+    const size_t                   meshCount = meshPrimitives.size();
+    std::vector<rtr::common::Mesh> emptyMeshes(meshCount);
+    std::vector<std::string_view>  meshNames(meshNamesStorage.begin(), meshNamesStorage.end());
+    rtr::common::MeshHeader*       meshHeader =
+        rtr::common::createMeshHeader(allocator, emptyMeshes, meshNames);
+
+    std::vector<MeshCounts>                   meshCounts(meshCount);
+    std::vector<std::optional<uint64_t>>      meshCacheKeys(meshCount);
+    std::vector<std::optional<CacheEntry>>    cachedMeshes(meshCount);
+    std::vector<std::optional<ProcessedMesh>> processedMeshes(meshCount);
+    parallelFor(options.jobs, meshCount, [&](size_t i) {
+        if (!meshPrimitives[i]) {
+            processedMeshes[i] = processBatch(batchPlan.batches[meshBatches[i]], options);
+            meshCounts[i] = countsOf(processedMeshes[i]->mesh);
+            return;
+        }
+        if (cache && (meshCacheKeys[i] = primitiveCacheKey(*meshPrimitives[i], options))) {
+            cachedMeshes[i] = cache->find(*meshCacheKeys[i]);
+            std::optional<MeshCounts> counts;
+            if (cachedMeshes[i] && (counts = cachedMeshCounts(cachedMeshes[i]->payload()))) {
+                meshCounts[i] = *counts;
+                if (options.deduplicateArrays) {
+                    processedMeshes[i] = ProcessedMesh{allocateMesh(*counts)};
+                    loadMesh(cachedMeshes[i]->payload(), arraysOf(processedMeshes[i]->mesh));
+                    cachedMeshes[i].reset();
+                    meshCacheKeys[i].reset();
+                }
+                return;
+            }
+            cachedMeshes[i].reset();
+        }
+        if (needsProcessing(options) || options.deduplicateArrays) {
+            processedMeshes[i] = processPrimitive(*meshPrimitives[i], options);
+            meshCounts[i] = countsOf(processedMeshes[i]->mesh);
+        } else {
+            meshCounts[i] = primitiveCounts(*meshPrimitives[i], options);
+        }
+    });
+    for (size_t i = 0; i < meshCount; ++i) {
+        if (const auto& processed = processedMeshes[i]) {
+            localStats.weldedVertices += processed->weldedVertices;
+            localStats.degenerateTriangles += processed->degenerateTriangles;
+            if (processed->cacheBefore)
+                localStats.vertexCache.push_back(VertexCacheReport{
+                    .mesh = meshNamesStorage[i],
+                    .acmrBefore = processed->cacheBefore->acmr,
+                    .acmrAfter = processed->cacheAfter->acmr,
+                    .atvrBefore = processed->cacheBefore->atvr,
+                    .atvrAfter = processed->cacheAfter->atvr,
+                });
+        }
+    }
+    // Triangles moved to a MeshIndicesHeader are converted into owned memory
+    // rather than the file. With deduplicateArrays, every mesh was converted
+    // during the sizing pass and is written here, sharing identical arrays.
+    std::vector<std::vector<glm::uvec3>> ownedTriangles(meshCount);
+    std::vector<MeshArrays>              meshArrays;
+    ArrayDeduplicator                    deduplicator(allocator);
+    for (size_t i = 0; i < meshCount; ++i) {
+        MeshCounts counts = meshCounts[i];
+        bool       replaced = replacesTriangles(options, counts);
+        if (options.deduplicateArrays) {
+            MeshData& mesh = processedMeshes[i]->mesh;
+            if (replaced)
+                ownedTriangles[i] = std::move(mesh.triangleVertices);
+            meshArrays.push_back(deduplicator.write(mesh));
+            processedMeshes[i].reset();
+        } else {
+            if (replaced) {
+                ownedTriangles[i].resize(counts.triangleVertices);
+                counts.triangleVertices = 0;
+            }
+            meshArrays.push_back(allocateMesh(allocator, counts));
+        }
+        if (!ownedTriangles[i].empty())
+            meshArrays[i].triangleVertices = ownedTriangles[i];
+    }
+    localStats.duplicateArrays = deduplicator.duplicates();
+    localStats.duplicateArrayBytes = deduplicator.duplicateBytes();
+    parallelFor(options.jobs, meshCount, [&](size_t i) {
+        if (cachedMeshes[i]) {
+            loadMesh(cachedMeshes[i]->payload(), meshArrays[i]);
+            cachedMeshes[i].reset();
+            return;
+        }
+        if (processedMeshes[i]) {
+            copyMesh(processedMeshes[i]->mesh, meshArrays[i]);
+            processedMeshes[i].reset();
+        } else if (!options.deduplicateArrays) {
+            convertPrimitive(*meshPrimitives[i], meshArrays[i]);
+            generateTangentSpace(*meshPrimitives[i], meshArrays[i]);
+        }
+        if (meshCacheKeys[i])
+            storeMesh(*cache, *meshCacheKeys[i], meshCounts[i], meshArrays[i]);
+    });
+
+    // Optional object space bounds. glTF requires position min and max, but
+    // they are only trusted for plain float positions. Welding keeps the
+    // first of each group of vertices unmodified, so they stay conservative.
+    std::vector<Aabb> meshBounds(options.buildBvh ? meshCount : 0);
+    if (options.buildBvh) {
+        parallelFor(options.jobs, meshCount, [&](size_t i) {
+            const cgltf_accessor* positions =
+                meshPrimitives[i] ? findAttribute(*meshPrimitives[i], cgltf_attribute_type_position)
+                                  : nullptr;
+            if (positions && positions->has_min && positions->has_max &&
+                positions->type == cgltf_type_vec3 &&
+                positions->component_type == cgltf_component_type_r_32f &&
+                !positions->normalized) {
+                meshBounds[i].extend(glm::make_vec3(positions->min));
+                meshBounds[i].extend(glm::make_vec3(positions->max));
+            } else {
+                meshBounds[i] = computeBounds(meshArrays[i].vertexPositions);
+            }
+        });
+    }
+
+    // Optional meshlets, built from the full triangles before compact index
+    // formats replace them
+    if (options.buildMeshlets) {
+        std::vector<MeshletData> meshlets(meshCount);
+        parallelFor(options.jobs, meshCount, [&](size_t i) {
+            meshlets[i] = buildMeshlets(meshArrays[i].triangleVertices,
+                                        meshArrays[i].vertexPositions, options.meshletMaxVertices,
+                                        options.meshletMaxTriangles);
+        });
+        MeshletHeader* meshletHeader = decodeless::create::object<MeshletHeader>(allocator);
+        std::span<MeshletMesh> meshletMeshes =
+            decodeless::create::array<MeshletMesh>(allocator, meshCount);
+        for (size_t i = 0; i < meshCount; ++i) {
+            meshletMeshes[i].meshlets = std::span<const Meshlet>(
+                decodeless::create::array<Meshlet>(allocator, meshlets[i].meshlets));
+            meshletMeshes[i].vertices = std::span<const uint32_t>(
+                decodeless::create::array<uint32_t>(allocator, meshlets[i].vertices));
+            meshletMeshes[i].triangles = std::span<const glm::u8vec3>(
+                decodeless::create::array<glm::u8vec3>(allocator, meshlets[i].triangles));
+            localStats.meshlets += meshlets[i].meshlets.size();
+        }
+        meshletHeader->meshes = std::span<const MeshletMesh>(meshletMeshes);
+        subHeaders.push_back(meshletHeader);
+    }
+
+    // Optional levels of detail, also from the full triangles. Tiny meshes
+    // are not worth simplifying.
+    if (options.generateLods) {
+        constexpr size_t minLodTriangles = 16;
+
+        std::vector<std::vector<LodLevel>> levels(meshCount);
+        LodWeights                         weights{.normal = options.lodNormalWeight,
+                                                   .texCoord = options.lodTexCoordWeight};
+        parallelFor(options.jobs, meshCount, [&](size_t i) {
+            levels[i] = buildLodChain(meshArrays[i].triangleVertices,
+                                      meshArrays[i].vertexPositions, meshArrays[i].vertexNormals,
+                                      meshArrays[i].vertexTexCoords0, weights, options.maxLodLevels,
+                                      minLodTriangles);
+        });
+        LodHeader*          lodHeader = decodeless::create::object<LodHeader>(allocator);
+        std::span<MeshLods> meshLods = decodeless::create::array<MeshLods>(allocator, meshCount);
+        for (size_t i = 0; i < meshCount; ++i) {
+            std::span<MeshLod> meshLevels =
+                decodeless::create::array<MeshLod>(allocator, levels[i].size());
+            for (size_t level = 0; level < levels[i].size(); ++level) {
+                meshLevels[level].triangles = std::span<const glm::uvec3>(
+                    decodeless::create::array<glm::uvec3>(allocator, levels[i][level].triangles));
+                meshLevels[level].error = levels[i][level].error;
+            }
+            meshLods[i].levels = std::span<const MeshLod>(meshLevels);
+            localStats.lodLevels += levels[i].size();
+        }
+        lodHeader->meshes = std::span<const MeshLods>(meshLods);
+        subHeaders.push_back(lodHeader);
+    }
+
+    // Optional compact triangles. Meshes not replaced keep their 32-bit
+    // triangles in the rtr mesh and have an empty entry.
+    if (options.indexFormat != IndexFormat::uint32) {
+        MeshIndicesHeader* indicesHeader = decodeless::create::object<MeshIndicesHeader>(allocator);
+        std::span<MeshIndices> indices =
+            decodeless::create::array<MeshIndices>(allocator, meshCount);
+        std::vector<std::vector<uint8_t>> encoded(meshCount);
+        if (options.indexFormat == IndexFormat::encoded)
+            parallelFor(options.jobs, meshCount, [&](size_t i) {
+                encoded[i] = encodeTriangles(meshArrays[i].triangleVertices);
+            });
+        std::vector<std::span<glm::u16vec3>> triangles16(meshCount);
+        for (size_t i = 0; i < meshCount; ++i) {
+            uint64_t bytes32 = meshCounts[i].triangleVertices * sizeof(glm::uvec3);
+            localStats.indexBytesUncompacted += bytes32;
+            if (ownedTriangles[i].empty()) {
+                localStats.indexBytes += bytes32;
+                continue;
+            }
+            indices[i].triangleCount = uint32_t(meshCounts[i].triangleVertices);
+            if (options.indexFormat == IndexFormat::encoded) {
+                indices[i].encoded = std::span<const uint8_t>(
+                    decodeless::create::array<uint8_t>(allocator, encoded[i]));
+                localStats.indexBytes += encoded[i].size();
+            } else {
+                triangles16[i] = decodeless::create::array<glm::u16vec3>(
+                    allocator, meshCounts[i].triangleVertices);
+                indices[i].triangles16 = std::span<const glm::u16vec3>(triangles16[i]);
+                localStats.indexBytes += triangles16[i].size_bytes();
+            }
+        }
+        parallelFor(options.jobs, meshCount, [&](size_t i) {
+            if (!triangles16[i].empty())
+                std::ranges::transform(meshArrays[i].triangleVertices, triangles16[i].begin(),
+                                       [](const glm::uvec3& t) { return glm::u16vec3(t); });
+        });
+        for (size_t i = 0; i < meshCount; ++i)
+            if (!ownedTriangles[i].empty())
+                meshArrays[i].triangleVertices = {};
+        ownedTriangles.clear();
+        indicesHeader->meshes = std::span<const MeshIndices>(indices);
+        subHeaders.push_back(indicesHeader);
+    }
+
+    // Point the mesh table at the arrays
+    for (size_t i = 0; i < meshCount; ++i) {
+#define RTR_ARRAY(type, name)                                                                      \
+    meshHeader->meshes[i].name = std::span<const type>(meshArrays[i].name);
+        RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    }
+    subHeaders.push_back(meshHeader);
+
+    // Optional compact copy of the vertex arrays, quantized from the full
+    // precision arrays written above
+    if (options.quantizeVertices) {
+        QuantizedMeshHeader* quantizedHeader =
+            decodeless::create::object<QuantizedMeshHeader>(allocator);
+        std::span<QuantizedMesh> quantizedMeshes =
+            decodeless::create::array<QuantizedMesh>(allocator, meshCount);
+        std::vector<std::span<glm::u16vec4>> positions;
+        std::vector<std::span<glm::i16vec2>> normals;
+        std::vector<std::span<glm::i8vec4>>  tangents;
+        std::vector<std::span<glm::u16vec2>> texCoords;
+        for (const MeshCounts& counts : meshCounts) {
+            positions.push_back(
+                decodeless::create::array<glm::u16vec4>(allocator, counts.vertexPositions));
+            normals.push_back(
+                decodeless::create::array<glm::i16vec2>(allocator, counts.vertexNormals));
+            tangents.push_back(
+                decodeless::create::array<glm::i8vec4>(allocator, counts.vertexTangents));
+            texCoords.push_back(
+                decodeless::create::array<glm::u16vec2>(allocator, counts.vertexTexCoords0));
+        }
+        std::vector<std::array<float, 4>> errors(meshCount);
+        parallelFor(options.jobs, meshCount, [&](size_t i) {
+            QuantizedMesh& quantized = quantizedMeshes[i];
+            errors[i] = {
+                quantizePositions(meshArrays[i].vertexPositions, positions[i],
+                                  quantized.positionOffset, quantized.positionScale),
+                quantizeNormals(meshArrays[i].vertexNormals, normals[i]),
+                quantizeTangents(meshArrays[i].vertexTangents, tangents[i]),
+                quantizeTexCoords(meshArrays[i].vertexTexCoords0, texCoords[i]),
+            };
+            quantized.vertexPositions = std::span<const glm::u16vec4>(positions[i]);
+            quantized.vertexNormals = std::span<const glm::i16vec2>(normals[i]);
+            quantized.vertexTangents = std::span<const glm::i8vec4>(tangents[i]);
+            quantized.vertexTexCoords0 = std::span<const glm::u16vec2>(texCoords[i]);
+        });
+        for (const auto& [position, normal, tangent, texCoord] : errors) {
+            localStats.quantizedPositionError =
+                std::max(localStats.quantizedPositionError, position);
+            localStats.quantizedNormalDegrees =
+                std::max(localStats.quantizedNormalDegrees, normal);
+            localStats.quantizedTangentDegrees =
+                std::max(localStats.quantizedTangentDegrees, tangent);
+            localStats.quantizedTexCoordError =
+                std::max(localStats.quantizedTexCoordError, texCoord);
+        }
+        quantizedHeader->meshes = std::span<const QuantizedMesh>(quantizedMeshes);
+        subHeaders.push_back(quantizedHeader);
+    }
+
+    // Write materials
+    rtr::common::MaterialHeader* materialHeader =
+        decodeless::create::object<rtr::common::MaterialHeader>(allocator);
+    materialHeader->materials =
+        decodeless::create::array<rtr::common::Material>(allocator, materialsByIndex.size());
+    TextureCache textureCache;
+    for (size_t materialIndex = 0; materialIndex < materialsByIndex.size(); ++materialIndex) {
+        if (const cgltf_material* cgltfMaterial = materialsByIndex[materialIndex]) {
+            materialHeader->materials[materialIndex] =
+                convertGltfMaterial(path.parent_path(), *cgltfMaterial, options, textureCache);
+        } else {
+            // Default material
+            materialHeader->materials[materialIndex] = rtr::common::Material{};
+        }
+    }
+    std::vector<uint32_t>             textureRemap;
+    std::vector<rtr::common::Texture> textures = convertTextures(
+        allocator, textureCache, options, cache ? &*cache : nullptr, textureRemap, localStats);
+    for (rtr::common::Material& material : materialHeader->materials) {
+        for (rtr::optional_index32* slot :
+             {&material.textures.color, &material.textures.metallic, &material.textures.roughness,
+              &material.textures.normal})
+            if (*slot)
+                *slot = textureRemap[**slot];
+    }
+    materialHeader->textures = decodeless::create::array<rtr::common::Texture>(allocator, textures);
+    subHeaders.push_back(materialHeader);
+
+    // Optional instance BVH
+    if (options.buildBvh) {
+        BvhHeader* bvhHeader =
+            writeBvhHeader(allocator, meshBounds, instances, worldTransforms.transforms);
+        subHeaders.push_back(bvhHeader);
+        localStats.bvhNodes = bvhHeader->nodes.size();
+    }
+
+    // Fill the sub-header table
+    if (subHeaders.size() != headerTable.size())
+        throw std::runtime_error("Sub-headers written do not match the planned layout");
     std::ranges::sort(subHeaders, decodeless::RootHeader::HeaderPtrComp());
-    header->headers = decodeless::create::array<decodeless::offset_ptr<decodeless::Header>>(
-        allocator, subHeaders);
+    std::ranges::copy(subHeaders, headerTable.begin());
+    header->headers = headerTable;
+
+    if (cache) {
+        cache->trim();
+        localStats.cacheHits = cache->hits();
+        localStats.cacheMisses = cache->misses();
+        localStats.cacheEvictedBytes = cache->evictedBytes();
+    }
 
     // TODO: raii
     cgltf_free(data);
+    if (stats)
+        *stats = localStats;
     return header;
 }
 
@@ -0,0 +1,48 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <rtrtool_batch.hpp>
+#include <stdexcept>
+
+namespace rtrtool {
+
+namespace {
+
+glm::vec3 normalizeOrZero(glm::vec3 v) {
+    float length = glm::length(v);
+    return length > 0.0f ? v / length : v;
+}
+
+} // namespace
+
+void appendTransformed(MeshData& destination, const MeshData& source, const glm::mat4& transform) {
+    size_t base = vertexCount(destination);
+    vertexCount(source);
+    if ((base != 0 || !destination.triangleVertices.empty()) &&
+        (destination.vertexNormals.empty() != source.vertexNormals.empty() ||
+         destination.vertexTexCoords0.empty() != source.vertexTexCoords0.empty() ||
+         destination.vertexTangents.empty() != source.vertexTangents.empty()))
+        throw std::runtime_error("Batched meshes must have the same vertex arrays");
+
+    glm::mat3 linear(transform);
+    glm::mat3 normalMatrix = glm::inverse(glm::transpose(linear));
+    bool      mirrored = glm::determinant(linear) < 0.0f;
+    for (glm::uvec3 triangle : source.triangleVertices) {
+        triangle += glm::uvec3(uint32_t(base));
+        destination.triangleVertices.push_back(mirrored ? glm::uvec3(triangle.x, triangle.z,
+                                                                     triangle.y)
+                                                        : triangle);
+    }
+    for (const glm::vec3& position : source.vertexPositions)
+        destination.vertexPositions.push_back(glm::vec3(transform * glm::vec4(position, 1.0f)));
+    for (const glm::vec3& normal : source.vertexNormals)
+        destination.vertexNormals.push_back(normalizeOrZero(normalMatrix * normal));
+    destination.vertexTexCoords0.insert(destination.vertexTexCoords0.end(),
+                                        source.vertexTexCoords0.begin(),
+                                        source.vertexTexCoords0.end());
+    for (const glm::vec4& tangent : source.vertexTangents)
+        destination.vertexTangents.push_back(
+            glm::vec4(normalizeOrZero(linear * glm::vec3(tangent)),
+                      mirrored ? -tangent.w : tangent.w));
+}
+
+} // namespace rtrtool
@@ -0,0 +1,17 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <rtrtool_mesh.hpp>
+
+namespace rtrtool {
+
+// Appends 'source' to 'destination' with positions transformed by 'transform',
+// normals by its inverse transpose and tangent directions by its upper 3x3.
+// Mirroring transforms flip the triangle winding and tangent handedness so the
+// result still faces outwards. Both meshes must have the same vertex arrays,
+// unless 'destination' is empty.
+void appendTransformed(MeshData& destination, const MeshData& source, const glm::mat4& transform);
+
+} // namespace rtrtool
@@ -0,0 +1,149 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <rtr/write_mesh.hpp>
+#include <rtrtool_bvh.hpp>
+
+namespace rtrtool {
+
+namespace {
+
+constexpr int BinCount = 16;
+
+struct BvhBuilder {
+    BvhBuilder(std::span<const Aabb> bounds, uint32_t maxLeafSize)
+        : bounds(bounds), maxLeafSize(maxLeafSize) {}
+
+    std::span<const Aabb>  bounds;
+    std::vector<glm::vec3> centers;
+    uint32_t               maxLeafSize;
+    BvhData                result;
+
+    void build(uint32_t begin, uint32_t end, uint32_t depth) {
+        uint32_t index = uint32_t(result.nodes.size());
+        Aabb     nodeBounds;
+        Aabb     centerBounds;
+        for (uint32_t i = begin; i < end; ++i) {
+            nodeBounds.extend(bounds[result.items[i]]);
+            centerBounds.extend(centers[result.items[i]]);
+        }
+        result.nodes.push_back(
+            BvhNode{.bounds = nodeBounds, .offset = begin, .count = end - begin});
+        if (end - begin <= maxLeafSize || depth + 1 >= BvhMaxDepth)
+            return;
+        uint32_t middle = split(begin, end, centerBounds);
+        build(begin, middle, depth + 1);
+        result.nodes[index].offset = uint32_t(result.nodes.size());
+        result.nodes[index].count = 0;
+        build(middle, end, depth + 1);
+    }
+
+    // Partitions items by the cheapest binned split along the longest axis of
+    // their centers and returns the first item on the right
+    uint32_t split(uint32_t begin, uint32_t end, const Aabb& centerBounds) {
+        auto      items = result.items.begin();
+        glm::vec3 extent = centerBounds.max - centerBounds.min;
+        int       axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                         : extent.y >= extent.z                       ? 1
+                                                                      : 2;
+
+        // Coincident centers can only be split by count
+        uint32_t middle = begin + (end - begin) / 2;
+        if (!(extent[axis] > 0.0f))
+            return middle;
+
+        struct Bin {
+            Aabb     bounds;
+            uint32_t count = 0;
+        };
+        std::array<Bin, BinCount> bins;
+        float                     scale = float(BinCount) / extent[axis];
+        auto                      binOf = [&](uint32_t item) {
+            return std::min(BinCount - 1,
+                            int((centers[item][axis] - centerBounds.min[axis]) * scale));
+        };
+        for (uint32_t i = begin; i < end; ++i) {
+            Bin& bin = bins[binOf(items[i])];
+            bin.bounds.extend(bounds[items[i]]);
+            bin.count++;
+        }
+
+        // Sweep from the right for the cost of each right side, then from the
+        // left to find the cheapest split with items on both sides
+        std::array<float, BinCount> rightCosts;
+        Aabb                        right;
+        uint32_t                    rightCount = 0;
+        for (int bin = BinCount - 1; bin > 0; --bin) {
+            right.extend(bins[bin].bounds);
+            rightCount += bins[bin].count;
+            rightCosts[bin] = rightCount ? right.halfArea() * float(rightCount) : 0.0f;
+        }
+        float    bestCost = std::numeric_limits<float>::infinity();
+        int      bestBin = -1;
+        Aabb     left;
+        uint32_t leftCount = 0;
+        for (int bin = 1; bin < BinCount; ++bin) {
+            left.extend(bins[bin - 1].bounds);
+            leftCount += bins[bin - 1].count;
+            if (leftCount == 0 || leftCount == end - begin)
+                continue;
+            float cost = left.halfArea() * float(leftCount) + rightCosts[bin];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestBin = bin;
+            }
+        }
+        if (bestBin < 0) {
+            std::nth_element(items + begin, items + middle, items + end,
+                             [&](uint32_t a, uint32_t b) {
+                                 return centers[a][axis] < centers[b][axis];
+                             });
+            return middle;
+        }
+        return uint32_t(std::partition(items + begin, items + end,
+                                       [&](uint32_t item) { return binOf(item) < bestBin; }) -
+                        items);
+    }
+};
+
+} // namespace
+
+BvhData buildBvh(std::span<const Aabb> bounds, uint32_t maxLeafSize) {
+    BvhBuilder builder(bounds, std::max(1u, maxLeafSize));
+    for (uint32_t i = 0; i < bounds.size(); ++i) {
+        builder.centers.push_back(bounds[i].center());
+        if (!bounds[i].empty())
+            builder.result.items.push_back(i);
+    }
+    if (!builder.result.items.empty())
+        builder.build(0, uint32_t(builder.result.items.size()), 0);
+    return std::move(builder.result);
+}
+
+Aabb computeBounds(std::span<const glm::vec3> positions) {
+    Aabb result;
+    for (const glm::vec3& position : positions)
+        result.extend(position);
+    return result;
+}
+
+BvhHeader* writeBvhHeader(const WriterAllocator& allocator, std::span<const Aabb> meshBounds,
+                          std::span<const rtr::Instance> instances,
+                          std::span<const glm::mat4>     worldTransforms) {
+    std::vector<Aabb> instanceBounds;
+    instanceBounds.reserve(instances.size());
+    for (const rtr::Instance& instance : instances)
+        instanceBounds.push_back(
+            transformAabb(meshBounds[instance.mesh], worldTransforms[instance.node]));
+    BvhData    bvh = buildBvh(instanceBounds, 4);
+    BvhHeader* result = decodeless::create::object<BvhHeader>(allocator);
+    result->meshBounds = decodeless::create::array<Aabb>(allocator, meshBounds);
+    result->instanceBounds = decodeless::create::array<Aabb>(allocator, instanceBounds);
+    result->nodes = decodeless::create::array<BvhNode>(allocator, bvh.nodes);
+    result->instances = decodeless::create::array<uint32_t>(allocator, bvh.items);
+    return result;
+}
+
+} // namespace rtrtool
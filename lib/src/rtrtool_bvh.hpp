@@ -0,0 +1,34 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <rtr/scene.hpp>
+#include <rtrtool/bvh.hpp>
+#include <rtrtool/converter.hpp>
+#include <span>
+#include <vector>
+
+namespace rtrtool {
+
+// Owned BVH arrays, matching BvhHeader
+struct BvhData {
+    std::vector<BvhNode>  nodes;
+    std::vector<uint32_t> items;
+};
+
+// Builds a BVH over the given boxes with binned surface area heuristic splits
+// along the longest centroid axis. Leaves hold at most maxLeafSize items,
+// unless BvhMaxDepth is reached. Empty boxes are left out.
+BvhData buildBvh(std::span<const Aabb> bounds, uint32_t maxLeafSize);
+
+// Bounds of the positions, e.g. a mesh's vertices
+Aabb computeBounds(std::span<const glm::vec3> positions);
+
+// Writes a BvhHeader over the world space bounds of the instances, given the
+// object space bounds of each mesh and the world transform of each node
+BvhHeader* writeBvhHeader(const WriterAllocator& allocator, std::span<const Aabb> meshBounds,
+                          std::span<const rtr::Instance> instances,
+                          std::span<const glm::mat4>     worldTransforms);
+
+} // namespace rtrtool
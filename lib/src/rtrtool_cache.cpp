@@ -0,0 +1,139 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <rtrtool_cache.hpp>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace rtrtool {
+
+namespace {
+
+constexpr std::array<char, 8> EntryMagic = {'r', 't', 'r', 'c', 'a', 'c', 'h', 'e'};
+constexpr uint32_t            EntryVersion = 1;
+
+struct EntryHeader {
+    std::array<char, 8> magic;
+    uint32_t            version;
+    uint32_t            reserved;
+    uint64_t            key;
+    uint64_t            payloadBytes;
+};
+
+std::string hexKey(uint64_t key) {
+    char buffer[17];
+    for (int i = 15; i >= 0; --i, key >>= 4)
+        buffer[i] = "0123456789abcdef"[key & 0xF];
+    buffer[16] = '\0';
+    return buffer;
+}
+
+} // namespace
+
+ArtifactCache::ArtifactCache(const fs::path& directory, uint64_t maxBytes)
+    : m_directory(directory),
+      m_maxBytes(maxBytes) {
+    fs::create_directories(m_directory);
+}
+
+fs::path ArtifactCache::entryPath(uint64_t key) const {
+    return m_directory / (hexKey(key) + ".bin");
+}
+
+std::optional<CacheEntry> ArtifactCache::find(uint64_t key) {
+    fs::path        path = entryPath(key);
+    std::error_code ec;
+    if (fs::file_size(path, ec) < sizeof(EntryHeader) || ec) {
+        m_misses++;
+        return std::nullopt;
+    }
+    try {
+        decodeless::file file(path);
+        EntryHeader      header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != EntryMagic || header.version != EntryVersion || header.key != key ||
+            header.payloadBytes != file.size() - sizeof(header)) {
+            m_misses++;
+            return std::nullopt;
+        }
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec); // LRU
+        m_hits++;
+        return CacheEntry(std::move(file), sizeof(header));
+    } catch (const std::exception&) {
+        // E.g. evicted by another process in the meantime
+        m_misses++;
+        return std::nullopt;
+    }
+}
+
+void ArtifactCache::store(uint64_t key, std::span<const std::span<const uint8_t>> parts) {
+    EntryHeader header{
+        .magic = EntryMagic,
+        .version = EntryVersion,
+        .reserved = 0,
+        .key = key,
+        .payloadBytes = 0,
+    };
+    for (const auto& part : parts)
+        header.payloadBytes += part.size();
+
+    // Unique per thread and process so writers never share a temporary file
+    fs::path tmpPath = entryPath(key);
+    tmpPath += "." +
+               hexKey(std::hash<std::thread::id>{}(std::this_thread::get_id()) ^
+                      uint64_t(std::chrono::steady_clock::now().time_since_epoch().count())) +
+               ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& part : parts)
+        out.write(reinterpret_cast<const char*>(part.data()), std::streamsize(part.size()));
+    out.close();
+
+    // Failed writes, e.g. to a full disk, leave no temporary file, as trim()
+    // would never remove it
+    std::error_code ec;
+    if (out)
+        fs::rename(tmpPath, entryPath(key), ec);
+    if (!out || ec)
+        fs::remove(tmpPath, ec);
+}
+
+void ArtifactCache::trim() {
+    struct Entry {
+        fs::path           path;
+        uint64_t           size;
+        fs::file_time_type time;
+    };
+    std::vector<Entry> entries;
+    uint64_t           total = 0;
+    std::error_code    ec;
+    for (const auto& dirEntry : fs::directory_iterator(m_directory, ec)) {
+        if (!dirEntry.is_regular_file(ec) || dirEntry.path().extension() != ".bin")
+            continue;
+        Entry entry{dirEntry.path(), dirEntry.file_size(ec), dirEntry.last_write_time(ec)};
+        if (ec)
+            continue;
+        total += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    if (total <= m_maxBytes)
+        return;
+    std::ranges::sort(entries, std::less{}, &Entry::time);
+    for (const Entry& entry : entries) {
+        if (total <= m_maxBytes)
+            break;
+        if (fs::remove(entry.path, ec)) {
+            total -= entry.size;
+            m_evictedBytes += entry.size;
+        }
+    }
+}
+
+} // namespace rtrtool
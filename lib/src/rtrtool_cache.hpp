@@ -0,0 +1,67 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <decodeless/mappedfile.hpp>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+namespace rtrtool {
+
+namespace fs = std::filesystem;
+
+// A cached artifact, mapped from disk
+class CacheEntry {
+public:
+    CacheEntry(decodeless::file&& file, size_t payloadOffset)
+        : m_file(std::move(file)),
+          m_payloadOffset(payloadOffset) {}
+    std::span<const uint8_t> payload() const {
+        return std::span(reinterpret_cast<const uint8_t*>(m_file.data()), m_file.size())
+            .subspan(m_payloadOffset);
+    }
+
+private:
+    decodeless::file m_file;
+    size_t           m_payloadOffset;
+};
+
+// Content-addressed store of conversion artifacts that persists across runs.
+// Callers choose 64-bit keys that cover everything affecting an artifact. Each
+// entry is a file named by its key. Writes go to a temporary file that is
+// renamed into place, so concurrent runs can share a directory. Hits refresh
+// the file's modification time, which trim() uses to evict the least recently
+// used entries once the directory grows beyond its size limit. find() and
+// store() may be called from any thread.
+class ArtifactCache {
+public:
+    ArtifactCache(const fs::path& directory, uint64_t maxBytes);
+
+    // Returns the entry for a key, or nothing on a miss or a damaged entry
+    std::optional<CacheEntry> find(uint64_t key);
+
+    // Writes an entry whose payload is the concatenation of 'parts'. Failures
+    // are ignored; the cache is only an optimization.
+    void store(uint64_t key, std::span<const std::span<const uint8_t>> parts);
+
+    // Evicts the least recently used entries until within the size limit
+    void trim();
+
+    size_t   hits() const { return m_hits; }
+    size_t   misses() const { return m_misses; }
+    uint64_t evictedBytes() const { return m_evictedBytes; }
+
+private:
+    fs::path entryPath(uint64_t key) const;
+
+    fs::path              m_directory;
+    uint64_t              m_maxBytes;
+    std::atomic<size_t>   m_hits = 0;
+    std::atomic<size_t>   m_misses = 0;
+    std::atomic<uint64_t> m_evictedBytes = 0;
+};
+
+} // namespace rtrtool
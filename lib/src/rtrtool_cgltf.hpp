@@ -8,13 +8,17 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <limits>
 #include <ranges>
+#include <rtrtool_kernels.hpp>
 #include <vector>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
 
 namespace rtrtool {
 
-static const char* cgltfErrorString(cgltf_result result, cgltf_data* data) {
+inline const char* cgltfErrorString(cgltf_result result, cgltf_data* data) {
     switch (result) {
     case cgltf_result_file_not_found:
         return data ? "resource not found" : "file not found";
@@ -223,6 +227,15 @@ private:
     size_t m_stride;
 };
 
+template <class T>
+struct component_of {
+    using type = T;
+};
+template <glm::length_t L, class C, glm::qualifier Q>
+struct component_of<glm::vec<L, C, Q>> {
+    using type = C;
+};
+
 template<cgltf_component_type component_type, cgltf_type type, class U, std::ranges::output_range<U> Range>
 void convertCTT(const cgltf_accessor& accessor, Range& result)
 {
@@ -238,10 +251,29 @@ void convertCTT(const cgltf_accessor& accessor, Range& result)
     }
     else
     {
+        using CT = typename component_of<T>::type;
+        using CU = typename component_of<U>::type;
         cgltf_accessor_adapter<T> adapter(accessor);
         auto out = result.begin();
-        for(const T& v : adapter)
-            *out++ = static_cast<U>(v);
+        if(accessor.normalized)
+        {
+            // Same mapping as toFloat(): the largest value is 1 and signed
+            // values clamp to -1
+            if constexpr(std::is_integral_v<CT> && std::is_floating_point_v<CU>)
+            {
+                for(const T& v : adapter)
+                    *out++ = glm::max(static_cast<U>(v) / CU(std::numeric_limits<CT>::max()), U(CU(-1)));
+            }
+            else
+            {
+                throw std::runtime_error(std::string("Normalized cgltf accessor cannot be converted to ") + cgltf_type_traits<U>::name);
+            }
+        }
+        else
+        {
+            for(const T& v : adapter)
+                *out++ = static_cast<U>(v);
+        }
         //std::ranges::transform(adapter, result.begin(), [](const T& v){ return static_cast<U>(v); });
     }
 }
@@ -264,6 +296,116 @@ void convertCT(const cgltf_accessor& accessor, Range& result)
     // clang-format on
 }
 
+constexpr size_t cgltfComponentBytes(cgltf_component_type component_type) {
+    switch (component_type) {
+    case cgltf_component_type_r_8:
+    case cgltf_component_type_r_8u:
+        return 1;
+    case cgltf_component_type_r_16:
+    case cgltf_component_type_r_16u:
+        return 2;
+    case cgltf_component_type_r_32u:
+    case cgltf_component_type_r_32f:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Vectorized conversion for the common accessor layouts: 8 and 16-bit indices
+// and (normalized) integer attributes. Interleaved accessors are first gathered
+// into tightly packed storage. Returns false if there is no kernel for the
+// layout, leaving the generic per-element conversion to handle it.
+template <class T>
+bool convertFast(const cgltf_accessor& accessor, std::span<T> result) {
+    using C = typename component_of<T>::type;
+    constexpr size_t components = sizeof(T) / sizeof(C);
+    size_t           componentBytes = cgltfComponentBytes(accessor.component_type);
+    if (!accessor.buffer_view || accessor.is_sparse || componentBytes == 0 ||
+        cgltf_num_components(accessor.type) != components)
+        return false;
+    if constexpr (!std::is_same_v<C, float> && !std::is_same_v<C, uint32_t>)
+        return false;
+
+    const std::byte* src = reinterpret_cast<const std::byte*>(accessor.buffer_view->buffer->data) +
+                           accessor.buffer_view->offset + accessor.offset;
+
+    size_t stride = accessor.buffer_view->stride ? accessor.buffer_view->stride : accessor.stride;
+    size_t elementBytes = componentBytes * components;
+    size_t count = result.size() * components;
+
+    // Matching components only need the gather
+    if (cgltf_type_traits<C>::component_type == accessor.component_type) {
+        gather(src, stride, elementBytes, result.size(), result.data());
+        return true;
+    }
+    if (std::is_same_v<C, uint32_t> && (accessor.component_type == cgltf_component_type_r_8 ||
+                                        accessor.component_type == cgltf_component_type_r_16))
+        return false; // Signed indices are not valid glTF
+
+    std::vector<std::byte> packed;
+    if (stride != elementBytes) {
+        packed.resize(elementBytes * result.size());
+        gather(src, stride, elementBytes, result.size(), packed.data());
+        src = packed.data();
+    }
+    C* dst = reinterpret_cast<C*>(result.data());
+    if constexpr (std::is_same_v<C, uint32_t>) {
+        switch (accessor.component_type) {
+        case cgltf_component_type_r_8u:
+            widen(reinterpret_cast<const uint8_t*>(src), count, dst);
+            break;
+        case cgltf_component_type_r_16u:
+            widen(reinterpret_cast<const uint16_t*>(src), count, dst);
+            break;
+        default:
+            return false;
+        }
+    } else if constexpr (std::is_same_v<C, float>) {
+        switch (accessor.component_type) {
+        case cgltf_component_type_r_8:
+            toFloat(reinterpret_cast<const int8_t*>(src), count, accessor.normalized, dst);
+            break;
+        case cgltf_component_type_r_8u:
+            toFloat(reinterpret_cast<const uint8_t*>(src), count, accessor.normalized, dst);
+            break;
+        case cgltf_component_type_r_16:
+            toFloat(reinterpret_cast<const int16_t*>(src), count, accessor.normalized, dst);
+            break;
+        case cgltf_component_type_r_16u:
+            toFloat(reinterpret_cast<const uint16_t*>(src), count, accessor.normalized, dst);
+            break;
+        default:
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Converts an accessor into caller-provided storage, e.g. an array already
+// allocated in the output file, so no temporary copy is needed. 'result' must
+// have one element per accessor element.
+template <class T>
+void convertInto(const cgltf_accessor& accessor, std::span<T> result) {
+    if (result.size() != accessor.count)
+        throw std::runtime_error("cgltf accessor count does not match the output size");
+    if (convertFast(accessor, result))
+        return;
+    // clang-format off
+    switch (accessor.component_type) {
+    case cgltf_component_type_r_8:   convertCT<cgltf_component_type_r_8,   T>(accessor, result); break;
+    case cgltf_component_type_r_8u:  convertCT<cgltf_component_type_r_8u,  T>(accessor, result); break;
+    case cgltf_component_type_r_16:  convertCT<cgltf_component_type_r_16,  T>(accessor, result); break;
+    case cgltf_component_type_r_16u: convertCT<cgltf_component_type_r_16u, T>(accessor, result); break;
+    case cgltf_component_type_r_32u: convertCT<cgltf_component_type_r_32u, T>(accessor, result); break;
+    case cgltf_component_type_r_32f: convertCT<cgltf_component_type_r_32f, T>(accessor, result); break;
+    default: throw std::runtime_error("Invalid cgltf accessor component_type");
+    }
+    // clang-format on
+}
+
 template <class T, class U = T>
     requires(alignof(T) == alignof(U))
 std::span<U> convert(const cgltf_accessor& accessor, std::vector<std::remove_cv_t<U>>& temporary) {
@@ -279,18 +421,7 @@ std::span<U> convert(const cgltf_accessor& accessor, std::vector<std::remove_cv_
     } else {
         // Convert using 'temporary' storage
         temporary.resize((adapter.size() * sizeof(T)) / sizeof(U));
-        std::span<T> spanT = {reinterpret_cast<T*>(temporary.data()), adapter.size()};
-        // clang-format off
-        switch (accessor.component_type) {
-        case cgltf_component_type_r_8:   convertCT<cgltf_component_type_r_8,   T>(accessor, spanT); break;
-        case cgltf_component_type_r_8u:  convertCT<cgltf_component_type_r_8u,  T>(accessor, spanT); break;
-        case cgltf_component_type_r_16:  convertCT<cgltf_component_type_r_16,  T>(accessor, spanT); break;
-        case cgltf_component_type_r_16u: convertCT<cgltf_component_type_r_16u, T>(accessor, spanT); break;
-        case cgltf_component_type_r_32u: convertCT<cgltf_component_type_r_32u, T>(accessor, spanT); break;
-        case cgltf_component_type_r_32f: convertCT<cgltf_component_type_r_32f, T>(accessor, spanT); break;
-        default: throw std::runtime_error("Invalid cgltf accessor component_type");
-        }
-        // clang-format on
+        convertInto(accessor, std::span<T>{reinterpret_cast<T*>(temporary.data()), adapter.size()});
         result = temporary;
     }
     return result;
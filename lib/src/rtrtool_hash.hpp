@@ -0,0 +1,107 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+namespace rtrtool {
+
+// XXH64, a fast non-cryptographic hash used to find identical content. Values
+// are stable across runs and match the reference implementation on little
+// endian machines.
+namespace xxh64 {
+
+constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t result;
+    std::memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t result;
+    std::memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+    return std::rotl(acc + input * Prime2, 31) * Prime1;
+}
+
+inline uint64_t merge(uint64_t acc, uint64_t value) {
+    return (acc ^ round(0, value)) * Prime1 + Prime4;
+}
+
+} // namespace xxh64
+
+inline uint64_t hash64(std::span<const uint8_t> data, uint64_t seed = 0) {
+    using namespace xxh64;
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    uint64_t       h;
+    if (data.size() >= 32) {
+        uint64_t v1 = seed + Prime1 + Prime2;
+        uint64_t v2 = seed + Prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - Prime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    } else {
+        h = seed + Prime5;
+    }
+    h += uint64_t(data.size());
+    for (; p + 8 <= end; p += 8)
+        h = std::rotl(h ^ round(0, read64(p)), 27) * Prime1 + Prime4;
+    if (p + 4 <= end) {
+        h = std::rotl(h ^ (uint64_t(read32(p)) * Prime1), 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = std::rotl(h ^ (*p * Prime5), 11) * Prime1;
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// A second XXH64 seeded with the first, for content identified by its hash
+// alone where a 64-bit collision would silently merge different data, e.g.
+// textures. The second half only collides independently of the first.
+using Hash128 = std::array<uint64_t, 2>;
+
+inline Hash128 hash128(std::span<const uint8_t> data, uint64_t seed = 0) {
+    uint64_t first = hash64(data, seed);
+    return {first, hash64(data, first)};
+}
+
+// Hashes the bytes of an object, e.g. a key struct. Padding bytes are not
+// allowed, since their values are unspecified.
+template <class T>
+    requires std::has_unique_object_representations_v<T>
+uint64_t hashObject(const T& value, uint64_t seed = 0) {
+    return hash64(std::span(reinterpret_cast<const uint8_t*>(&value), sizeof(value)), seed);
+}
+
+} // namespace rtrtool
@@ -0,0 +1,392 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <rtrtool_kernels.hpp>
+#include <type_traits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define RTRTOOL_X86_KERNELS 1
+    #include <immintrin.h>
+    #define RTRTOOL_TARGET_SSE41 __attribute__((target("sse4.1")))
+    #define RTRTOOL_TARGET_AVX2  __attribute__((target("avx2")))
+#else
+    #define RTRTOOL_X86_KERNELS 0
+#endif
+
+namespace rtrtool {
+
+namespace {
+
+// Normalized unsigned values divide by the maximum. Signed values do too and
+// are clamped, since the minimum is one lower than -maximum.
+template <class T>
+struct ToFloatParams {
+    float divisor;
+    float lowest;
+    ToFloatParams(bool normalized)
+        : divisor(normalized ? float(std::numeric_limits<T>::max()) : 1.0f),
+          lowest(normalized && std::is_signed_v<T> ? -1.0f
+                                                   : -std::numeric_limits<float>::infinity()) {}
+};
+
+template <class T>
+void widenScalar(const T* src, size_t count, uint32_t* dst) {
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = src[i];
+}
+
+template <class T>
+void toFloatScalar(const T* src, size_t count, const ToFloatParams<T>& params, float* dst) {
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = std::max(float(src[i]) / params.divisor, params.lowest);
+}
+
+// Adds precomputed face normals, stored as separate x, y and z arrays, to
+// their triangles' vertices
+void scatterFaceNormals(const uint32_t* triangles, size_t count, const float* x, const float* y,
+                        const float* z, float* normals) {
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t v = 0; v < 3; ++v) {
+            float* normal = normals + size_t(triangles[i * 3 + v]) * 3;
+            normal[0] += x[i];
+            normal[1] += y[i];
+            normal[2] += z[i];
+        }
+    }
+}
+
+void accumulateFaceNormalsScalar(const float* positions, const uint32_t* triangles, size_t count,
+                                 float* normals) {
+    for (size_t i = 0; i < count; ++i) {
+        const float* a = positions + size_t(triangles[i * 3 + 0]) * 3;
+        const float* b = positions + size_t(triangles[i * 3 + 1]) * 3;
+        const float* c = positions + size_t(triangles[i * 3 + 2]) * 3;
+        float        e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float        e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float        x = e1[1] * e2[2] - e1[2] * e2[1];
+        float        y = e1[2] * e2[0] - e1[0] * e2[2];
+        float        z = e1[0] * e2[1] - e1[1] * e2[0];
+        scatterFaceNormals(triangles + i * 3, 1, &x, &y, &z, normals);
+    }
+}
+
+// One TRS transform. Every level performs these operations in this order, so
+// results are identical.
+void composeTransformsScalar(const float* translations, const float* rotations,
+                             const float* scales, size_t count, float* transforms) {
+    for (size_t i = 0; i < count; ++i) {
+        const float* t = translations + i * 3;
+        const float* r = rotations + i * 4;
+        const float* s = scales + i * 3;
+        float*       m = transforms + i * 12;
+        float        x2 = r[0] + r[0];
+        float        y2 = r[1] + r[1];
+        float        z2 = r[2] + r[2];
+        float        xx = r[0] * x2;
+        float        yy = r[1] * y2;
+        float        zz = r[2] * z2;
+        float        xy = r[0] * y2;
+        float        xz = r[0] * z2;
+        float        yz = r[1] * z2;
+        float        wx = r[3] * x2;
+        float        wy = r[3] * y2;
+        float        wz = r[3] * z2;
+        m[0] = (1.0f - (yy + zz)) * s[0];
+        m[1] = (xy + wz) * s[0];
+        m[2] = (xz - wy) * s[0];
+        m[3] = (xy - wz) * s[1];
+        m[4] = (1.0f - (xx + zz)) * s[1];
+        m[5] = (yz + wx) * s[1];
+        m[6] = (xz + wy) * s[2];
+        m[7] = (yz - wx) * s[2];
+        m[8] = (1.0f - (xx + yy)) * s[2];
+        m[9] = t[0];
+        m[10] = t[1];
+        m[11] = t[2];
+    }
+}
+
+#if RTRTOOL_X86_KERNELS
+
+// Loads 4 or 8 values sign or zero extended to 32-bit integers
+RTRTOOL_TARGET_SSE41 inline __m128i load4(const uint8_t* p) {
+    int32_t bits;
+    std::memcpy(&bits, p, sizeof(bits));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bits));
+}
+RTRTOOL_TARGET_SSE41 inline __m128i load4(const int8_t* p) {
+    int32_t bits;
+    std::memcpy(&bits, p, sizeof(bits));
+    return _mm_cvtepi8_epi32(_mm_cvtsi32_si128(bits));
+}
+RTRTOOL_TARGET_SSE41 inline __m128i load4(const uint16_t* p) {
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+RTRTOOL_TARGET_SSE41 inline __m128i load4(const int16_t* p) {
+    return _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+RTRTOOL_TARGET_AVX2 inline __m256i load8(const uint8_t* p) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+RTRTOOL_TARGET_AVX2 inline __m256i load8(const int8_t* p) {
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+RTRTOOL_TARGET_AVX2 inline __m256i load8(const uint16_t* p) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+RTRTOOL_TARGET_AVX2 inline __m256i load8(const int16_t* p) {
+    return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+template <class T>
+RTRTOOL_TARGET_SSE41 void widenSse41(const T* src, size_t count, uint32_t* dst) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), load4(src + i));
+    widenScalar(src + i, count - i, dst + i);
+}
+
+template <class T>
+RTRTOOL_TARGET_AVX2 void widenAvx2(const T* src, size_t count, uint32_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), load8(src + i));
+    widenScalar(src + i, count - i, dst + i);
+}
+
+template <class T>
+RTRTOOL_TARGET_SSE41 void toFloatSse41(const T* src, size_t count, const ToFloatParams<T>& params,
+                                       float* dst) {
+    const __m128 divisor = _mm_set1_ps(params.divisor);
+    const __m128 lowest = _mm_set1_ps(params.lowest);
+    size_t       i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 value = _mm_div_ps(_mm_cvtepi32_ps(load4(src + i)), divisor);
+        _mm_storeu_ps(dst + i, _mm_max_ps(value, lowest));
+    }
+    toFloatScalar(src + i, count - i, params, dst + i);
+}
+
+template <class T>
+RTRTOOL_TARGET_AVX2 void toFloatAvx2(const T* src, size_t count, const ToFloatParams<T>& params,
+                                     float* dst) {
+    const __m256 divisor = _mm256_set1_ps(params.divisor);
+    const __m256 lowest = _mm256_set1_ps(params.lowest);
+    size_t       i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 value = _mm256_div_ps(_mm256_cvtepi32_ps(load8(src + i)), divisor);
+        _mm256_storeu_ps(dst + i, _mm256_max_ps(value, lowest));
+    }
+    toFloatScalar(src + i, count - i, params, dst + i);
+}
+
+// Gathers each of the 8 triangles' vertex positions, computes cross products
+// in registers and scatters them. Triangle indices are read with a gather too,
+// since they are interleaved. Indices times 3 must fit in an int32.
+RTRTOOL_TARGET_AVX2 void accumulateFaceNormalsAvx2(const float* positions,
+                                                   const uint32_t* triangles, size_t count,
+                                                   float* normals) {
+    const __m256i triangleOffsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i three = _mm256_set1_epi32(3);
+    alignas(32) float x[8];
+    alignas(32) float y[8];
+    alignas(32) float z[8];
+    size_t            i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int* base = reinterpret_cast<const int*>(triangles + i * 3);
+        __m256     p[3][3];
+        for (int v = 0; v < 3; ++v) {
+            __m256i index = _mm256_i32gather_epi32(base + v, triangleOffsets, 4);
+            __m256i offset = _mm256_mullo_epi32(index, three);
+            p[v][0] = _mm256_i32gather_ps(positions + 0, offset, 4);
+            p[v][1] = _mm256_i32gather_ps(positions + 1, offset, 4);
+            p[v][2] = _mm256_i32gather_ps(positions + 2, offset, 4);
+        }
+        __m256 e1[3], e2[3];
+        for (int c = 0; c < 3; ++c) {
+            e1[c] = _mm256_sub_ps(p[1][c], p[0][c]);
+            e2[c] = _mm256_sub_ps(p[2][c], p[0][c]);
+        }
+        _mm256_store_ps(x, _mm256_sub_ps(_mm256_mul_ps(e1[1], e2[2]), _mm256_mul_ps(e1[2], e2[1])));
+        _mm256_store_ps(y, _mm256_sub_ps(_mm256_mul_ps(e1[2], e2[0]), _mm256_mul_ps(e1[0], e2[2])));
+        _mm256_store_ps(z, _mm256_sub_ps(_mm256_mul_ps(e1[0], e2[1]), _mm256_mul_ps(e1[1], e2[0])));
+        scatterFaceNormals(triangles + i * 3, 8, x, y, z, normals);
+    }
+    accumulateFaceNormalsScalar(positions, triangles + i * 3, count - i, normals);
+}
+
+// Gathers 8 instances' components, composes them in registers and
+// transposes back to interleaved matrices through the stack
+RTRTOOL_TARGET_AVX2 void composeTransformsAvx2(const float* translations, const float* rotations,
+                                               const float* scales, size_t count,
+                                               float* transforms) {
+    const __m256i     offsets3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i     offsets4 = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const __m256      one = _mm256_set1_ps(1.0f);
+    alignas(32) float columns[12][8];
+    size_t            i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 t[3], r[4], s[3];
+        for (int c = 0; c < 3; ++c) {
+            t[c] = _mm256_i32gather_ps(translations + i * 3 + c, offsets3, 4);
+            s[c] = _mm256_i32gather_ps(scales + i * 3 + c, offsets3, 4);
+        }
+        for (int c = 0; c < 4; ++c)
+            r[c] = _mm256_i32gather_ps(rotations + i * 4 + c, offsets4, 4);
+        __m256 x2 = _mm256_add_ps(r[0], r[0]);
+        __m256 y2 = _mm256_add_ps(r[1], r[1]);
+        __m256 z2 = _mm256_add_ps(r[2], r[2]);
+        __m256 xx = _mm256_mul_ps(r[0], x2);
+        __m256 yy = _mm256_mul_ps(r[1], y2);
+        __m256 zz = _mm256_mul_ps(r[2], z2);
+        __m256 xy = _mm256_mul_ps(r[0], y2);
+        __m256 xz = _mm256_mul_ps(r[0], z2);
+        __m256 yz = _mm256_mul_ps(r[1], z2);
+        __m256 wx = _mm256_mul_ps(r[3], x2);
+        __m256 wy = _mm256_mul_ps(r[3], y2);
+        __m256 wz = _mm256_mul_ps(r[3], z2);
+        __m256 m[12] = {
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), s[0]),
+            _mm256_mul_ps(_mm256_add_ps(xy, wz), s[0]),
+            _mm256_mul_ps(_mm256_sub_ps(xz, wy), s[0]),
+            _mm256_mul_ps(_mm256_sub_ps(xy, wz), s[1]),
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), s[1]),
+            _mm256_mul_ps(_mm256_add_ps(yz, wx), s[1]),
+            _mm256_mul_ps(_mm256_add_ps(xz, wy), s[2]),
+            _mm256_mul_ps(_mm256_sub_ps(yz, wx), s[2]),
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), s[2]),
+            t[0],
+            t[1],
+            t[2],
+        };
+        for (int c = 0; c < 12; ++c)
+            _mm256_store_ps(columns[c], m[c]);
+        for (size_t lane = 0; lane < 8; ++lane)
+            for (int c = 0; c < 12; ++c)
+                transforms[(i + lane) * 12 + size_t(c)] = columns[c][lane];
+    }
+    composeTransformsScalar(translations + i * 3, rotations + i * 4, scales + i * 3, count - i,
+                            transforms + i * 12);
+}
+
+#endif
+
+KernelLevel detectKernelLevel() {
+#if RTRTOOL_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return KernelLevel::avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return KernelLevel::sse41;
+#endif
+    return KernelLevel::scalar;
+}
+
+template <class T>
+void widenDispatch(const T* src, size_t count, uint32_t* dst, KernelLevel level) {
+#if RTRTOOL_X86_KERNELS
+    if (level == KernelLevel::avx2)
+        return widenAvx2(src, count, dst);
+    if (level == KernelLevel::sse41)
+        return widenSse41(src, count, dst);
+#endif
+    (void)level;
+    widenScalar(src, count, dst);
+}
+
+template <class T>
+void toFloatDispatch(const T* src, size_t count, bool normalized, float* dst, KernelLevel level) {
+    ToFloatParams<T> params(normalized);
+#if RTRTOOL_X86_KERNELS
+    if (level == KernelLevel::avx2)
+        return toFloatAvx2(src, count, params, dst);
+    if (level == KernelLevel::sse41)
+        return toFloatSse41(src, count, params, dst);
+#endif
+    (void)level;
+    toFloatScalar(src, count, params, dst);
+}
+
+template <size_t Bytes>
+void gatherFixed(const std::byte* src, size_t stride, size_t count, std::byte* dst) {
+    for (size_t i = 0; i < count; ++i, src += stride, dst += Bytes)
+        std::memcpy(dst, src, Bytes);
+}
+
+} // namespace
+
+KernelLevel kernelLevel() {
+    static const KernelLevel level = detectKernelLevel();
+    return level;
+}
+
+void widen(const uint8_t* src, size_t count, uint32_t* dst, KernelLevel level) {
+    widenDispatch(src, count, dst, level);
+}
+
+void widen(const uint16_t* src, size_t count, uint32_t* dst, KernelLevel level) {
+    widenDispatch(src, count, dst, level);
+}
+
+void toFloat(const uint8_t* src, size_t count, bool normalized, float* dst, KernelLevel level) {
+    toFloatDispatch(src, count, normalized, dst, level);
+}
+
+void toFloat(const uint16_t* src, size_t count, bool normalized, float* dst, KernelLevel level) {
+    toFloatDispatch(src, count, normalized, dst, level);
+}
+
+void toFloat(const int8_t* src, size_t count, bool normalized, float* dst, KernelLevel level) {
+    toFloatDispatch(src, count, normalized, dst, level);
+}
+
+void toFloat(const int16_t* src, size_t count, bool normalized, float* dst, KernelLevel level) {
+    toFloatDispatch(src, count, normalized, dst, level);
+}
+
+void accumulateFaceNormals(const float* positions, size_t positionCount, const uint32_t* triangles,
+                           size_t triangleCount, float* normals, KernelLevel level) {
+#if RTRTOOL_X86_KERNELS
+    // SSE4.1 has no gather, so only AVX2 is worth it
+    if (level == KernelLevel::avx2 &&
+        positionCount <= size_t(std::numeric_limits<int32_t>::max() / 3))
+        return accumulateFaceNormalsAvx2(positions, triangles, triangleCount, normals);
+#endif
+    (void)level;
+    (void)positionCount;
+    accumulateFaceNormalsScalar(positions, triangles, triangleCount, normals);
+}
+
+void composeTransforms(const float* translations, const float* rotations, const float* scales,
+                       size_t count, float* transforms, KernelLevel level) {
+#if RTRTOOL_X86_KERNELS
+    // As with face normals, only AVX2 has the gathers to make this worth it
+    if (level == KernelLevel::avx2)
+        return composeTransformsAvx2(translations, rotations, scales, count, transforms);
+#endif
+    (void)level;
+    composeTransformsScalar(translations, rotations, scales, count, transforms);
+}
+
+void gather(const void* srcPtr, size_t stride, size_t elementBytes, size_t count, void* dstPtr) {
+    auto src = static_cast<const std::byte*>(srcPtr);
+    auto dst = static_cast<std::byte*>(dstPtr);
+    if (stride == elementBytes) {
+        std::memcpy(dst, src, elementBytes * count);
+        return;
+    }
+    switch (elementBytes) {
+    case 4: gatherFixed<4>(src, stride, count, dst); break;
+    case 8: gatherFixed<8>(src, stride, count, dst); break;
+    case 12: gatherFixed<12>(src, stride, count, dst); break;
+    case 16: gatherFixed<16>(src, stride, count, dst); break;
+    default:
+        for (size_t i = 0; i < count; ++i)
+            std::memcpy(dst + i * elementBytes, src + i * stride, elementBytes);
+        break;
+    }
+}
+
+} // namespace rtrtool
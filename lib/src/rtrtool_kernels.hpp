@@ -0,0 +1,58 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rtrtool {
+
+// Instruction sets for the accessor conversion kernels. Every kernel takes
+// the level to use, which defaults to the best the CPU supports, so tests and
+// benchmarks can compare against the scalar reference.
+enum class KernelLevel {
+    scalar,
+    sse41,
+    avx2,
+};
+
+// Best level supported by the CPU, detected once
+KernelLevel kernelLevel();
+
+// Widens tightly packed unsigned integers, e.g. 8 and 16-bit indices
+void widen(const uint8_t* src, size_t count, uint32_t* dst, KernelLevel level = kernelLevel());
+void widen(const uint16_t* src, size_t count, uint32_t* dst, KernelLevel level = kernelLevel());
+
+// Converts tightly packed integer components to float. Normalized values are
+// divided by the type's maximum and signed ones clamped to -1, per the glTF
+// spec. Otherwise values are converted as is.
+void toFloat(const uint8_t* src, size_t count, bool normalized, float* dst,
+             KernelLevel level = kernelLevel());
+void toFloat(const uint16_t* src, size_t count, bool normalized, float* dst,
+             KernelLevel level = kernelLevel());
+void toFloat(const int8_t* src, size_t count, bool normalized, float* dst,
+             KernelLevel level = kernelLevel());
+void toFloat(const int16_t* src, size_t count, bool normalized, float* dst,
+             KernelLevel level = kernelLevel());
+
+// Adds each triangle's area weighted normal, cross(b - a, c - a), to its three
+// vertices' entries in 'normals'. Positions and normals are packed xyz floats
+// and triangles packed index triples, all of which must be in range. Cross
+// products are vectorized; the scattered adds are done in triangle order so
+// every level produces identical results.
+void accumulateFaceNormals(const float* positions, size_t positionCount, const uint32_t* triangles,
+                           size_t triangleCount, float* normals,
+                           KernelLevel level = kernelLevel());
+
+// Composes packed translations (xyz), unit quaternion rotations (xyzw) and
+// scales (xyz) into 3x4 affine matrices, i.e. glm::mat4x3, of translation *
+// rotation * scale. Results are written as 12 floats each, column by column.
+void composeTransforms(const float* translations, const float* rotations, const float* scales,
+                       size_t count, float* transforms, KernelLevel level = kernelLevel());
+
+// Copies 'count' elements of 'elementBytes' from a strided, e.g. interleaved,
+// buffer into a tightly packed one. This is bound by memory, not instructions,
+// so there is only a scalar version with fixed size copies for common sizes.
+void gather(const void* src, size_t stride, size_t elementBytes, size_t count, void* dst);
+
+} // namespace rtrtool
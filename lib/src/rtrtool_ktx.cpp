@@ -1,12 +1,18 @@
 // Copyright (c) 2024 Pyarelal Knowles, MIT License
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstring>
 #include <dfd.h>
 #include <filesystem>
 #include <formats.h>
 #include <image.hpp>
 #include <imageio.h>
+#include <numeric>
+#include <rtrtool_hash.hpp>
 #include <rtrtool_ktx.hpp>
+#include <rtrtool_mipmap.hpp>
 #include <stdexcept>
 #include <utility.h>
 
@@ -14,34 +20,6 @@ namespace rtrtool {
 
 namespace fs = std::filesystem;
 
-ktx::KTXTexture2 createTexture(const ImageSpec& target, VkFormat vkFormat) {
-    ktxTextureCreateInfo createInfo{
-        .glInternalformat = {},
-        .vkFormat = vkFormat,
-        .pDfd = {},
-        .baseWidth = target.width(),
-        .baseHeight = target.height(),
-        .baseDepth = target.depth(),
-        .numDimensions = 2, // 1d/2d/3d texture
-        .numLevels = 1,     // mipmap
-        .numLayers = 1,     // array texture
-        .numFaces = 1,      // cube map
-        .isArray = false,
-        .generateMipmaps = false,
-    };
-
-    ktx::KTXTexture2 texture{nullptr};
-    ktx_error_code_e ret =
-        ktxTexture2_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, texture.pHandle());
-    if (KTX_SUCCESS != ret)
-        throw std::runtime_error(std::string("ktxTexture2_Create failed with ") +
-                                 ktxErrorString(ret));
-
-    KHR_DFDSETVAL(texture->pDfd + 1, PRIMARIES, target.format().primaries());
-    KHR_DFDSETVAL(texture->pDfd + 1, TRANSFER, target.format().transfer());
-    return texture;
-}
-
 // Copied from KTX-Software/tools/ktx/command.h
 // Copyright 2022-2023 The Khronos Group Inc.
 // Copyright 2022-2023 RasterGrid Kft.
@@ -99,49 +77,433 @@ ktx::KTXTexture2 createTexture(const ImageSpec& target, VkFormat vkFormat) {
     return createFormatDescriptor(dfd.get());
 }
 
-template<class T>
-std::unique_ptr<Image> makeImageWithChannels(uint32_t channels, uint32_t width, uint32_t height)
-{
-    if(channels == 1)
-        return std::make_unique<ImageT<T, 1>>(width, height);
-    else if(channels == 2)
-        return std::make_unique<ImageT<T, 2>>(width, height);
-    else if(channels == 3)
-        return std::make_unique<ImageT<T, 3>>(width, height);
-    else if(channels == 4)
-        return std::make_unique<ImageT<T, 4>>(width, height);
-    else
-        throw std::runtime_error("bad channel count");
-}
-
-std::span<uint8_t> convertToKtx(const WriterAllocator& allocator, const fs::path& path, std::string_view swizzle)
-{
-    const auto inputImageFile = ImageInput::open(
-        path, nullptr, [](const std::string& w) { printf("Warning: %s\n", w.c_str()); });
-    inputImageFile->seekSubimage(0, 0); // Loading multiple subimage from the same input is not supported
+// Minimal KTX2 container writer. libktx builds the whole file in a heap
+// allocation before it can be copied into the output, so the header, DFD and
+// level index are written here instead, directly into memory from the
+// WriterAllocator. Pixel data is then written in place.
+namespace ktx2 {
+
+// clang-format off
+constexpr std::array<uint8_t, 12> Identifier = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+// clang-format on
+constexpr char WriterKey[] = "KTXwriter";
+constexpr char WriterValue[] = "rtrtool";
+
+struct Header {
+    uint8_t  identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+static_assert(sizeof(LevelIndex) == 24);
+
+// Texel block size of a format, in bytes and pixels
+struct Format {
+    VkFormat vkFormat;
+    uint32_t typeSize;
+    uint32_t blockBytes;
+    uint32_t blockWidth = 1;
+    uint32_t blockHeight = 1;
+
+    size_t levelBytes(uint32_t width, uint32_t height) const {
+        return size_t((width + blockWidth - 1) / blockWidth) *
+               ((height + blockHeight - 1) / blockHeight) * blockBytes;
+    }
+};
+
+inline size_t alignUp(size_t offset, size_t alignment) {
+    return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+struct Allocation {
+    std::span<uint8_t>              file;
+    std::vector<std::span<uint8_t>> levels; // largest first
+};
+
+// Allocates a complete KTX2 file and writes everything but the level data. The
+// DFD is the libktx format, beginning with its total size.
+Allocation allocate(const WriterAllocator& allocator, const Format& format, uint32_t width,
+                    uint32_t height, uint32_t levelCount, std::span<const uint32_t> dfd) {
+    const size_t kvdEntryBytes = sizeof(WriterKey) + sizeof(WriterValue);
+    const size_t kvdBytes = alignUp(sizeof(uint32_t) + kvdEntryBytes, 4);
+    const size_t dfdOffset = sizeof(Header) + sizeof(LevelIndex) * levelCount;
+    const size_t kvdOffset = dfdOffset + dfd.size_bytes();
+
+    // Levels are stored smallest first, each aligned to the texel block
+    const size_t            levelAlignment = std::lcm(size_t(format.blockBytes), size_t(4));
+    std::vector<LevelIndex> levelIndex(levelCount);
+    size_t                  offset = kvdOffset + kvdBytes;
+    for (uint32_t level = levelCount; level-- > 0;) {
+        offset = alignUp(offset, levelAlignment);
+        size_t bytes =
+            format.levelBytes(std::max(1u, width >> level), std::max(1u, height >> level));
+        levelIndex[level] = {offset, bytes, bytes};
+        offset += bytes;
+    }
+
+    // Allocate aligned memory just in case. KTX doesn't seem to say anything
+    // about it. Better safe than sorry.
+    auto               ptr = allocator.resource()->allocate(offset, sizeof(std::max_align_t));
+    std::span<uint8_t> file(reinterpret_cast<uint8_t*>(ptr), offset);
+
+    // Zero everything except level data, which the caller fills
+    size_t zeroFrom = 0;
+    for (uint32_t level = levelCount; level-- > 0;) {
+        std::fill(file.begin() + zeroFrom, file.begin() + levelIndex[level].byteOffset, 0);
+        zeroFrom = levelIndex[level].byteOffset + levelIndex[level].byteLength;
+    }
+
+    Header header{
+        .identifier = {},
+        .vkFormat = uint32_t(format.vkFormat),
+        .typeSize = format.typeSize,
+        .pixelWidth = width,
+        .pixelHeight = height,
+        .pixelDepth = 0,
+        .layerCount = 0,
+        .faceCount = 1,
+        .levelCount = levelCount,
+        .supercompressionScheme = 0,
+        .dfdByteOffset = uint32_t(dfdOffset),
+        .dfdByteLength = uint32_t(dfd.size_bytes()),
+        .kvdByteOffset = uint32_t(kvdOffset),
+        .kvdByteLength = uint32_t(kvdBytes),
+        .sgdByteOffset = 0,
+        .sgdByteLength = 0,
+    };
+    std::ranges::copy(Identifier, header.identifier);
+    std::memcpy(file.data(), &header, sizeof(header));
+    std::memcpy(file.data() + sizeof(header), levelIndex.data(),
+                levelIndex.size() * sizeof(LevelIndex));
+    std::memcpy(file.data() + dfdOffset, dfd.data(), dfd.size_bytes());
+    uint32_t kvdEntryLength = uint32_t(kvdEntryBytes);
+    uint8_t* kvd = file.data() + kvdOffset;
+    std::memcpy(kvd, &kvdEntryLength, sizeof(kvdEntryLength));
+    std::memcpy(kvd + sizeof(kvdEntryLength), WriterKey, sizeof(WriterKey));
+    std::memcpy(kvd + sizeof(kvdEntryLength) + sizeof(WriterKey), WriterValue,
+                sizeof(WriterValue));
+
+    Allocation result{file, {}};
+    for (const LevelIndex& level : levelIndex)
+        result.levels.push_back(file.subspan(level.byteOffset, level.byteLength));
+    return result;
+}
+
+} // namespace ktx2
+
+bool validKtxFile(std::span<const uint8_t> file) {
+    ktx2::Header header;
+    if (file.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (!std::ranges::equal(header.identifier, ktx2::Identifier))
+        return false;
+    auto within = [&file](uint64_t offset, uint64_t bytes) {
+        return offset <= file.size() && bytes <= file.size() - offset;
+    };
+    uint64_t levelCount = std::max(1u, header.levelCount);
+    if (!within(sizeof(header), levelCount * sizeof(ktx2::LevelIndex)) ||
+        !within(header.dfdByteOffset, header.dfdByteLength) ||
+        !within(header.kvdByteOffset, header.kvdByteLength) ||
+        !within(header.sgdByteOffset, header.sgdByteLength))
+        return false;
+    for (uint64_t level = 0; level < levelCount; ++level) {
+        ktx2::LevelIndex index;
+        std::memcpy(&index, file.data() + sizeof(header) + level * sizeof(index), sizeof(index));
+        if (!within(index.byteOffset, index.byteLength))
+            return false;
+    }
+    return true;
+}
+
+using UniqueDfd = std::unique_ptr<uint32_t[], decltype(std::free)*>;
+
+UniqueDfd createDfd(VkFormat vkFormat) {
+    UniqueDfd dfd(vk2dfd(vkFormat), std::free);
+    if (!dfd)
+        throw std::runtime_error(std::string("Failed to create format descriptor for: ") +
+                                 vkFormatString(vkFormat));
+    return dfd;
+}
+
+// Maps swizzle characters to source channels. 4 and 5 select constant zero
+// and one.
+inline std::array<uint32_t, 4> swizzleChannels(std::string_view swizzle) {
+    std::array<uint32_t, 4> result{};
+    for (size_t i = 0; i < swizzle.size(); ++i) {
+        // clang-format off
+        switch (swizzle[i]) {
+        case 'r': case 'x': result[i] = 0; break;
+        case 'g': case 'y': result[i] = 1; break;
+        case 'b': case 'z': result[i] = 2; break;
+        case 'a': case 'w': result[i] = 3; break;
+        case '0': result[i] = 4; break;
+        case '1': result[i] = 5; break;
+        default:
+            throw std::runtime_error("bad swizzle character '" + std::string(1, swizzle[i]) + "'");
+        }
+        // clang-format on
+    }
+    return result;
+}
+
+// Copies RGBA pixels to an image with swizzle.size() channels
+template <class T>
+void swizzlePixels(const T* src, T* dst, size_t pixelCount, std::string_view swizzle, T one) {
+    const std::array<uint32_t, 4> channels = swizzleChannels(swizzle);
+    const size_t                  channelCount = swizzle.size();
+    for (size_t i = 0; i < pixelCount; ++i, src += 4, dst += channelCount) {
+        const T texel[6] = {src[0], src[1], src[2], src[3], T(0), one};
+        for (size_t c = 0; c < channelCount; ++c)
+            dst[c] = texel[channels[c]];
+    }
+}
+
+// Copies RGBA pixels with the swizzle applied. An empty swizzle copies as is.
+void swizzleImage(std::span<const uint8_t> src, std::span<uint8_t> dst, size_t pixelCount,
+                  uint32_t componentBytes, std::string_view swizzle, uint32_t oneBits) {
+    if (swizzle.empty()) {
+        std::ranges::copy(src, dst.begin());
+        return;
+    }
+    switch (componentBytes) {
+    case 1:
+        swizzlePixels(src.data(), dst.data(), pixelCount, swizzle, uint8_t(oneBits));
+        break;
+    case 2:
+        swizzlePixels(reinterpret_cast<const uint16_t*>(src.data()),
+                      reinterpret_cast<uint16_t*>(dst.data()), pixelCount, swizzle,
+                      uint16_t(oneBits));
+        break;
+    case 4:
+        swizzlePixels(reinterpret_cast<const uint32_t*>(src.data()),
+                      reinterpret_cast<uint32_t*>(dst.data()), pixelCount, swizzle, oneBits);
+        break;
+    default:
+        throw std::runtime_error("bad component size");
+    }
+}
+
+// libktx speed tiers for each encoder
+inline uint32_t uastcLevel(KtxQuality quality) {
+    switch (quality) {
+    case KtxQuality::fast: return KTX_PACK_UASTC_LEVEL_FASTEST;
+    case KtxQuality::quality: return KTX_PACK_UASTC_LEVEL_SLOWER;
+    default: return KTX_PACK_UASTC_LEVEL_DEFAULT;
+    }
+}
+
+inline uint32_t astcQuality(KtxQuality quality) {
+    switch (quality) {
+    case KtxQuality::fast: return KTX_PACK_ASTC_QUALITY_LEVEL_FAST;
+    case KtxQuality::quality: return KTX_PACK_ASTC_QUALITY_LEVEL_THOROUGH;
+    default: return KTX_PACK_ASTC_QUALITY_LEVEL_MEDIUM;
+    }
+}
+
+inline void checkKtx(ktx_error_code_e ret, const char* what) {
+    if (KTX_SUCCESS != ret)
+        throw std::runtime_error(std::string(what) + " failed with " + ktxErrorString(ret));
+}
+
+struct KtxSource::Impl {
+    struct Output {
+        std::string                     swizzle;
+        uint32_t                        channels;
+        bool                            color;
+        bool                            srgb;
+        KtxEncoding                     encoding;
+        VkFormat                        sourceFormat; // uncompressed format of the levels
+        VkFormat                        vkFormat;     // format written to the file
+        khr_df_transfer_e               transfer;
+        ktx2::Format                    format;
+        uint32_t                        droppedLevels; // levels above the max size
+        uint32_t                        levelCount;
+        Hash128                         hash = {};
+        std::vector<std::span<uint8_t>> levels; // largest first, empty until allocated
+    };
+
+    fs::path                path;
+    KtxOptions              options;
+    uint32_t                width = 0;
+    uint32_t                height = 0;
+    PixelType               pixelType = PixelType::unorm8;
+    uint32_t                componentBytes = 0;
+    uint32_t                oneBits = 0; // bit pattern of 1.0 for a swizzle '1'
+    VkFormat                vkFormat = VK_FORMAT_UNDEFINED;
+    std::array<VkFormat, 4> vkFormatForChannels{}; // no nice way to modify formats, e.g. "this format but with 3 channels pls"
+    khr_df_primaries_e      primaries = KHR_DF_PRIMARIES_UNSPECIFIED;
+    khr_df_transfer_e       transfer = KHR_DF_TRANSFER_UNSPECIFIED;
+    std::vector<Output>     outputs;
+    std::vector<uint8_t>    decoded; // kept between prepare() and write()
+
+    std::unique_ptr<ImageInput> open() const {
+        auto inputImageFile = ImageInput::open(
+            path, nullptr, [](const std::string& w) { printf("Warning: %s\n", w.c_str()); });
+        inputImageFile->seekSubimage(0, 0); // Loading multiple subimage from the same input is not supported
+        return inputImageFile;
+    }
+
+    size_t imageBytes(uint32_t levelWidth, uint32_t levelHeight, uint32_t channels) const {
+        return size_t(levelWidth) * levelHeight * channels * componentBytes;
+    }
+
+    void decode(std::span<uint8_t> dst) const {
+        FormatDescriptor loadFormat = createFormatDescriptor(vkFormat);
+        open()->readImage(dst.data(), dst.size(), 0, 0, loadFormat);
+    }
+
+    // Writes the output's uncompressed levels to 'levels' given its full
+    // resolution image. Dropped levels are only generated in scratch memory, on
+    // the way down.
+    void writeLevels(const Output& output, std::span<const std::span<uint8_t>> levels,
+                     std::span<const uint8_t> base, std::vector<uint8_t>&& baseScratch) const {
+        uint32_t                 levelWidth = width;
+        uint32_t                 levelHeight = height;
+        std::span<const uint8_t> previous = base;
+        std::vector<uint8_t>     previousScratch = std::move(baseScratch);
+        std::vector<uint8_t>     nextScratch;
+        const uint32_t           totalLevels = output.droppedLevels + uint32_t(levels.size());
+        for (uint32_t level = 1; level < totalLevels; ++level) {
+            std::span<uint8_t> next;
+            if (level >= output.droppedLevels) {
+                next = levels[level - output.droppedLevels];
+            } else {
+                nextScratch.resize(imageBytes(std::max(1u, levelWidth / 2),
+                                              std::max(1u, levelHeight / 2), output.channels));
+                next = nextScratch;
+            }
+            downsample(pixelType, output.channels, output.srgb, levelWidth, levelHeight,
+                       previous.data(), next.data());
+            levelWidth = std::max(1u, levelWidth / 2);
+            levelHeight = std::max(1u, levelHeight / 2);
+            previous = next;
+            std::swap(previousScratch, nextScratch);
+        }
+    }
+
+    // Block compresses uncompressed levels into the output's file. libktx
+    // needs its own texture object for this, so there is one extra copy.
+    void compress(const Output& output, std::span<const std::span<uint8_t>> source) const {
+        ktxTextureCreateInfo createInfo{
+            .glInternalformat = {},
+            .vkFormat = output.sourceFormat,
+            .pDfd = {},
+            .baseWidth = std::max(1u, width >> output.droppedLevels),
+            .baseHeight = std::max(1u, height >> output.droppedLevels),
+            .baseDepth = 1,
+            .numDimensions = 2,
+            .numLevels = uint32_t(source.size()),
+            .numLayers = 1,
+            .numFaces = 1,
+            .isArray = false,
+            .generateMipmaps = false,
+        };
+        ktx::KTXTexture2 texture{nullptr};
+        checkKtx(ktxTexture2_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE,
+                                    texture.pHandle()),
+                 "ktxTexture2_Create");
+        if (output.color)
+            KHR_DFDSETVAL(texture->pDfd + 1, PRIMARIES, primaries);
+        KHR_DFDSETVAL(texture->pDfd + 1, TRANSFER, output.transfer);
+        for (uint32_t level = 0; level < source.size(); ++level)
+            checkKtx(ktxTexture_SetImageFromMemory(texture, level, 0, 0, source[level].data(),
+                                                   source[level].size()),
+                     "ktxTexture_SetImageFromMemory");
+
+        if (output.encoding == KtxEncoding::astc) {
+            ktxAstcParams params{};
+            params.structSize = sizeof(params);
+            params.threadCount = std::max(1u, options.encoderThreads);
+            params.blockDimension = KTX_PACK_ASTC_BLOCK_DIMENSION_4x4;
+            params.mode = KTX_PACK_ASTC_ENCODER_MODE_LDR;
+            params.qualityLevel = astcQuality(options.quality);
+            params.perceptual = output.srgb ? KTX_TRUE : KTX_FALSE;
+            checkKtx(ktxTexture2_CompressAstcEx(texture, &params), "ktxTexture2_CompressAstcEx");
+        } else {
+            ktxBasisParams params{};
+            params.structSize = sizeof(params);
+            params.uastc = KTX_TRUE;
+            params.threadCount = std::max(1u, options.encoderThreads);
+            params.uastcFlags = uastcLevel(options.quality);
+
+            // BC4 and BC5 transcode from R and RA respectively
+            ktx_transcode_fmt_e target = KTX_TTF_BC7_RGBA;
+            if (output.encoding == KtxEncoding::bc5) {
+                std::ranges::copy(std::string_view("rrrg"), params.inputSwizzle);
+                target = KTX_TTF_BC5_RG;
+            } else if (output.encoding == KtxEncoding::bc4) {
+                std::ranges::copy(std::string_view("rrr1"), params.inputSwizzle);
+                target = KTX_TTF_BC4_R;
+            }
+            checkKtx(ktxTexture2_CompressBasisEx(texture, &params), "ktxTexture2_CompressBasisEx");
+            checkKtx(ktxTexture2_TranscodeBasis(texture, target, 0), "ktxTexture2_TranscodeBasis");
+        }
+
+        // The file was sized before encoding, so the result must match exactly
+        if (VkFormat(texture->vkFormat) != output.vkFormat)
+            throw std::runtime_error(std::string("Block compression produced ") +
+                                     vkFormatString(VkFormat(texture->vkFormat)) + ", expected " +
+                                     vkFormatString(output.vkFormat));
+        for (uint32_t level = 0; level < output.levels.size(); ++level) {
+            ktx_size_t offset = 0;
+            checkKtx(ktxTexture_GetImageOffset(texture, level, 0, 0, &offset),
+                     "ktxTexture_GetImageOffset");
+            ktx_size_t bytes = ktxTexture_GetImageSize(texture, level);
+            if (bytes != output.levels[level].size())
+                throw std::runtime_error("Block compressed level size mismatch");
+            std::copy_n(texture->pData + offset, bytes, output.levels[level].begin());
+        }
+    }
+};
+
+KtxSource::KtxSource(const fs::path& path, const KtxOptions& options)
+    : m_impl(std::make_unique<Impl>()) {
+    m_impl->path = path;
+    m_impl->options = options;
+    const auto  inputImageFile = m_impl->open();
     const auto& inputFormat = inputImageFile->spec().format();
-    const auto width = inputImageFile->spec().width();
-    const auto height = inputImageFile->spec().height();
-    const auto inputBitLength = inputFormat.largestChannelBitLength();
-    const auto requestBitLength = std::max(imageio::bit_ceil(inputBitLength), 8u);
-    VkFormat                vkFormat;
-    std::array<VkFormat, 4> vkFormatForChannels; // no nice way to modify formats, e.g. "this format but with 3 channels pls"
-    std::function<std::unique_ptr<Image>(uint32_t, uint32_t, uint32_t)> makeSameImage;
-    std::unique_ptr<Image> image = nullptr;
+    const auto  inputBitLength = inputFormat.largestChannelBitLength();
+    const auto  requestBitLength = std::max(imageio::bit_ceil(inputBitLength), 8u);
+    m_impl->width = inputImageFile->spec().width();
+    m_impl->height = inputImageFile->spec().height();
+    m_impl->primaries = inputFormat.primaries();
+    m_impl->transfer = inputFormat.transfer();
     switch (inputImageFile->formatType()) {
     case ImageInputFormatType::exr_uint:
-        makeSameImage = makeImageWithChannels<typename rgba32image::Color::value_type>;
-        image = std::make_unique<rgba32image>(width, height);
-        vkFormat = VK_FORMAT_R32G32B32A32_UINT;
-        vkFormatForChannels = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
-                               VK_FORMAT_R32G32B32A32_UINT};
+        m_impl->pixelType = PixelType::uint32;
+        m_impl->componentBytes = 4;
+        m_impl->oneBits = 1;
+        m_impl->vkFormat = VK_FORMAT_R32G32B32A32_UINT;
+        m_impl->vkFormatForChannels = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+                                       VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
         break;
     case ImageInputFormatType::exr_float:
-        makeSameImage = makeImageWithChannels<typename rgba32fimage::Color::value_type>;
-        image = std::make_unique<rgba32fimage>(width, height);
-        vkFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
-        vkFormatForChannels = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT,
-                               VK_FORMAT_R32G32B32A32_SFLOAT};
+        m_impl->pixelType = PixelType::float32;
+        m_impl->componentBytes = 4;
+        m_impl->oneBits = 0x3F800000u;
+        m_impl->vkFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+        m_impl->vkFormatForChannels = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+                                       VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
         break;
     case ImageInputFormatType::npbm:
         [[fallthrough]];
@@ -155,18 +517,20 @@ std::span<uint8_t> convertToKtx(const WriterAllocator& allocator, const fs::path
         [[fallthrough]];
     case ImageInputFormatType::png_rgba:
         if (requestBitLength == 8) {
-            makeSameImage = makeImageWithChannels<typename rgba8image::Color::value_type>;
-            image = std::make_unique<rgba8image>(width, height);
-            vkFormat = VK_FORMAT_R8G8B8A8_UNORM;
-            vkFormatForChannels = {VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8_UNORM,
-                                   VK_FORMAT_R8G8B8A8_UNORM};
+            m_impl->pixelType = PixelType::unorm8;
+            m_impl->componentBytes = 1;
+            m_impl->oneBits = 0xFFu;
+            m_impl->vkFormat = VK_FORMAT_R8G8B8A8_UNORM;
+            m_impl->vkFormatForChannels = {VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM,
+                                           VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM};
             break;
         } else if (requestBitLength == 16) {
-            makeSameImage = makeImageWithChannels<typename rgba16image::Color::value_type>;
-            image = std::make_unique<rgba16image>(width, height);
-            vkFormat = VK_FORMAT_R16G16B16A16_UNORM;
-            vkFormatForChannels = {VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM,
-                                   VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM};
+            m_impl->pixelType = PixelType::unorm16;
+            m_impl->componentBytes = 2;
+            m_impl->oneBits = 0xFFFFu;
+            m_impl->vkFormat = VK_FORMAT_R16G16B16A16_UNORM;
+            m_impl->vkFormatForChannels = {VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM,
+                                           VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM};
             break;
         } else {
             throw std::runtime_error("Unsupported input format with channels bit depth " +
@@ -174,77 +538,199 @@ std::span<uint8_t> convertToKtx(const WriterAllocator& allocator, const fs::path
         }
         break;
     }
+}
 
-    FormatDescriptor loadFormat = createFormatDescriptor(vkFormat);
-    inputImageFile->readImage(static_cast<uint8_t*>(*image), image->getByteCount(), 0, 0, loadFormat);
-
-    ImageSpec imageSpec = inputImageFile->spec();
-    if(!swizzle.empty())
-    {
-        if(swizzle.size() < 1 || swizzle.size() > 4)
-            throw std::runtime_error("bad swizzle size");
-        if(swizzle.size() == image->getComponentCount())
-        {
-            std::string swizzle4(swizzle);
-            for(size_t i = 4; i != swizzle.size(); --i)
-                swizzle4 += "0";
-            image->swizzle(swizzle);
-        }
-        else
-        {
-            // Support for swizzles that resize the image less than 4 components
-            auto newImage = makeSameImage(swizzle.size(), width, height);
-            if(swizzle.size() == 1)
-                image->copyToR(*newImage, std::string(swizzle) + "000");
-            else if(swizzle.size() == 2)
-                image->copyToRG(*newImage, std::string(swizzle) + "00");
-            else if(swizzle.size() == 3)
-                image->copyToRGB(*newImage, std::string(swizzle) + "0");
-            else if(swizzle.size() == 4)
-                image->copyToRGBA(*newImage, swizzle);
-            image = std::move(newImage);
-
-            // HACK: replace format on the existing "spec" (this is rather
-            // hurriedly written)
-            vkFormat = vkFormatForChannels[swizzle.size() - 1];
-            imageSpec.format() = createFormatDescriptor(vkFormat);
-        }
-    }
+KtxSource::KtxSource(KtxSource&& other) noexcept = default;
+KtxSource& KtxSource::operator=(KtxSource&& other) noexcept = default;
+KtxSource::~KtxSource() = default;
 
-    ktx::KTXTexture2 texture = createTexture(imageSpec, vkFormat);
+size_t KtxSource::addOutput(const KtxOutput& output) {
+    const std::string& swizzle = output.swizzle;
+    if (swizzle.size() > 4)
+        throw std::runtime_error("bad swizzle size");
+    swizzleChannels(swizzle); // validate now rather than on a worker thread
+    const uint32_t channels = swizzle.empty() ? 4u : uint32_t(swizzle.size());
 
-    {
-        const auto ret =
-            ktxTexture_SetImageFromMemory(texture, 0, 0, 0, static_cast<uint8_t*>(*image), image->getByteCount());
-        if (KTX_SUCCESS != ret)
-            throw std::runtime_error(std::string("ktxTexture_SetImageFromMemory failed with ") +
-                                     ktxErrorString(ret));
+    // Block compressors only take 8-bit input. In particular there is no BC6H
+    // encoder for HDR images, which stay uncompressed.
+    KtxEncoding encoding =
+        m_impl->pixelType == PixelType::unorm8 ? output.encoding : KtxEncoding::uncompressed;
+    if ((encoding == KtxEncoding::bc5 && channels != 2) ||
+        (encoding == KtxEncoding::bc4 && channels != 1))
+        throw std::runtime_error("BC4 and BC5 need one and two channel swizzles");
+
+    // Only color keeps the source transfer function. BC4 and BC5 have no sRGB
+    // variant.
+    khr_df_transfer_e transfer = output.color ? m_impl->transfer : KHR_DF_TRANSFER_LINEAR;
+    if (encoding == KtxEncoding::bc4 || encoding == KtxEncoding::bc5)
+        transfer = KHR_DF_TRANSFER_LINEAR;
+    const bool srgb = transfer == KHR_DF_TRANSFER_SRGB &&
+                      (m_impl->pixelType == PixelType::unorm8 ||
+                       m_impl->pixelType == PixelType::unorm16);
+
+    const VkFormat sourceFormat = swizzle.empty() ? m_impl->vkFormat
+                                                  : m_impl->vkFormatForChannels[swizzle.size() - 1];
+    ktx2::Format   format{.vkFormat = sourceFormat,
+                          .typeSize = m_impl->componentBytes,
+                          .blockBytes = m_impl->componentBytes * channels};
+    switch (encoding) {
+    case KtxEncoding::bc7:
+        format = {srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK, 1, 16, 4, 4};
+        break;
+    case KtxEncoding::bc5: format = {VK_FORMAT_BC5_UNORM_BLOCK, 1, 16, 4, 4}; break;
+    case KtxEncoding::bc4: format = {VK_FORMAT_BC4_UNORM_BLOCK, 1, 8, 4, 4}; break;
+    case KtxEncoding::astc:
+        format = {srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK, 1, 16, 4,
+                  4};
+        break;
+    default: break;
     }
 
-    // TODO: use a library that doesn't copy the same memory to a bunch of
-    // different places before we can put it in its rightful place. Might be
-    // able to implement ktxStream callbacks to interface with
-    // decodeless::writer, but still have the above texture to deal with.
-    auto ktxFree = [](ktx_uint8_t* ptr){ free(ptr); };
-    std::unique_ptr<uint8_t, decltype(ktxFree)> unnecessaryTemporaryMemory;
-    std::span<uint8_t> sizedKtx;
-    {
-        ktx_uint8_t* pDstBytes;
-        ktx_size_t   size;
-        ktx_error_code_e ret = ktxTexture_WriteToMemory(texture, &pDstBytes, &size);
-        if (KTX_SUCCESS != ret)
-            throw std::runtime_error(std::string("ktxTexture_WriteToMemory failed with ") +
-                                     ktxErrorString(ret));
-        unnecessaryTemporaryMemory = {pDstBytes, ktxFree};
-        sizedKtx = {pDstBytes, size};
+    // Drop the largest levels until the texture fits within the size budget
+    uint32_t droppedLevels = 0;
+    if (m_impl->options.maxSize) {
+        while ((std::max(m_impl->width, m_impl->height) >> droppedLevels) >
+               m_impl->options.maxSize)
+            ++droppedLevels;
     }
+    const uint32_t baseWidth = std::max(1u, m_impl->width >> droppedLevels);
+    const uint32_t baseHeight = std::max(1u, m_impl->height >> droppedLevels);
+    const uint32_t levelCount = m_impl->options.mipmaps ? mipLevelCount(baseWidth, baseHeight) : 1;
 
-    // Allocate aligned memory just in case. KTX doesn't seem to say anything
-    // about it. Better safe than sorry.
-    auto ptr = allocator.resource()->allocate(sizedKtx.size(), sizeof(std::max_align_t));
-    std::span<uint8_t> result(reinterpret_cast<uint8_t*>(ptr), sizedKtx.size());
-    std::ranges::copy(sizedKtx, result.begin());
-    return result;
+    m_impl->outputs.push_back({swizzle, channels, output.color, srgb, encoding, sourceFormat, format.vkFormat,
+                               transfer, format, droppedLevels, levelCount});
+    return m_impl->outputs.size() - 1;
+}
+
+size_t KtxSource::decodedBytes() const {
+    return m_impl->imageBytes(m_impl->width, m_impl->height, 4);
+}
+
+void KtxSource::prepare(bool keepDecoded) {
+    std::vector<uint8_t> decoded(decodedBytes());
+    m_impl->decode(decoded);
+
+    // Everything that affects the file contents, other than the pixels
+    struct Key {
+        uint32_t width;
+        uint32_t height;
+        uint32_t pixelType;
+        uint32_t primaries;
+        uint32_t transfer;
+        uint32_t vkFormat;
+        uint32_t encoding;
+        uint32_t quality;
+        uint32_t droppedLevels;
+        uint32_t levelCount;
+        char     swizzle[4];
+    };
+    const size_t         pixelCount = size_t(m_impl->width) * m_impl->height;
+    std::vector<uint8_t> swizzled;
+    for (Impl::Output& output : m_impl->outputs) {
+        Key key{
+            .width = m_impl->width,
+            .height = m_impl->height,
+            .pixelType = uint32_t(m_impl->pixelType),
+            .primaries = output.color ? uint32_t(m_impl->primaries) : 0u,
+            .transfer = uint32_t(output.transfer),
+            .vkFormat = uint32_t(output.vkFormat),
+            .encoding = uint32_t(output.encoding),
+            .quality = uint32_t(m_impl->options.quality),
+            .droppedLevels = output.droppedLevels,
+            .levelCount = output.levelCount,
+            .swizzle = {},
+        };
+        std::ranges::copy(output.swizzle, key.swizzle);
+        std::span<const uint8_t> pixels = decoded;
+        if (!output.swizzle.empty()) {
+            swizzled.resize(m_impl->imageBytes(m_impl->width, m_impl->height, output.channels));
+            swizzleImage(decoded, swizzled, pixelCount, m_impl->componentBytes, output.swizzle,
+                         m_impl->oneBits);
+            pixels = swizzled;
+        }
+        output.hash = hash128(pixels, hashObject(key));
+    }
+    if (keepDecoded)
+        m_impl->decoded = std::move(decoded);
+}
+
+Hash128 KtxSource::outputHash(size_t output) const {
+    return m_impl->outputs[output].hash;
 }
 
+std::span<uint8_t> KtxSource::allocate(const WriterAllocator& allocator, size_t outputIndex) {
+    Impl::Output& output = m_impl->outputs[outputIndex];
+    UniqueDfd     dfd = createDfd(output.vkFormat);
+    if (output.color)
+        KHR_DFDSETVAL(dfd.get() + 1, PRIMARIES, m_impl->primaries);
+    KHR_DFDSETVAL(dfd.get() + 1, TRANSFER, output.transfer);
+    ktx2::Allocation allocation = ktx2::allocate(
+        allocator, output.format, std::max(1u, m_impl->width >> output.droppedLevels),
+        std::max(1u, m_impl->height >> output.droppedLevels), output.levelCount,
+        std::span<const uint32_t>(dfd.get(), dfd[0] / sizeof(uint32_t)));
+    output.levels = std::move(allocation.levels);
+    return allocation.file;
+}
+
+void KtxSource::write() {
+    std::vector<Impl::Output*> outputs;
+    for (Impl::Output& output : m_impl->outputs)
+        if (!output.levels.empty())
+            outputs.push_back(&output);
+    if (outputs.empty())
+        return;
+    const size_t pixelCount = size_t(m_impl->width) * m_impl->height;
+
+    // Decode straight into the output file when it needs no swizzle, resize or
+    // compression
+    const Impl::Output&  first = *outputs[0];
+    std::vector<uint8_t> decodedScratch = std::move(m_impl->decoded);
+    std::span<uint8_t>   decoded;
+    if (!decodedScratch.empty()) {
+        decoded = decodedScratch;
+    } else if (outputs.size() == 1 && first.swizzle.empty() && first.droppedLevels == 0 &&
+               first.encoding == KtxEncoding::uncompressed) {
+        decoded = first.levels[0];
+        m_impl->decode(decoded);
+    } else {
+        decodedScratch.resize(decodedBytes());
+        decoded = decodedScratch;
+        m_impl->decode(decoded);
+    }
+
+    for (const Impl::Output* outputPtr : outputs) {
+        const Impl::Output& output = *outputPtr;
+        // Compressed outputs generate uncompressed levels in staging memory
+        std::vector<std::vector<uint8_t>>   staging;
+        std::vector<std::span<uint8_t>>     stagingLevels;
+        std::span<const std::span<uint8_t>> levels = output.levels;
+        if (output.encoding != KtxEncoding::uncompressed) {
+            uint32_t levelWidth = std::max(1u, m_impl->width >> output.droppedLevels);
+            uint32_t levelHeight = std::max(1u, m_impl->height >> output.droppedLevels);
+            for (size_t level = 0; level < output.levels.size(); ++level) {
+                staging.emplace_back(m_impl->imageBytes(levelWidth, levelHeight, output.channels));
+                stagingLevels.push_back(staging.back());
+                levelWidth = std::max(1u, levelWidth / 2);
+                levelHeight = std::max(1u, levelHeight / 2);
+            }
+            levels = stagingLevels;
+        }
+
+        std::vector<uint8_t> baseScratch;
+        std::span<uint8_t>   base;
+        if (output.droppedLevels == 0) {
+            base = levels[0];
+        } else {
+            baseScratch.resize(m_impl->imageBytes(m_impl->width, m_impl->height, output.channels));
+            base = baseScratch;
+        }
+        if (base.data() != decoded.data())
+            swizzleImage(decoded, base, pixelCount, m_impl->componentBytes, output.swizzle,
+                         m_impl->oneBits);
+        m_impl->writeLevels(output, levels, base, std::move(baseScratch));
+        if (output.encoding != KtxEncoding::uncompressed)
+            m_impl->compress(output, levels);
+    }
 }
+
+} // namespace rtrtool
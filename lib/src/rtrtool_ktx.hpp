@@ -4,6 +4,10 @@
 
 #include <decodeless/writer.hpp>
 #include <filesystem>
+#include <memory>
+#include <rtrtool_hash.hpp>
+#include <span>
+#include <string>
 
 namespace rtrtool {
 
@@ -11,7 +15,94 @@ namespace fs = std::filesystem;
 
 using WriterAllocator = std::pmr::polymorphic_allocator<std::byte>; //typename decodeless::writer::allocator_type;
 
-[[nodiscard]] std::span<uint8_t> convertToKtx(const WriterAllocator& allocator,
-                                              const fs::path& path, std::string_view swizzle);
+// GPU block compression for an output. BC formats are encoded to UASTC and
+// transcoded, as libktx has no direct BC encoder. Inputs other than 8-bit unorm
+// are always written uncompressed.
+enum class KtxEncoding {
+    uncompressed,
+    bc7,  // RGBA color
+    bc5,  // two channels, e.g. normal XY
+    bc4,  // one channel
+    astc, // 4x4 blocks, any channel count
+};
+
+// Encoder speed/quality tradeoff
+enum class KtxQuality {
+    fast,
+    balanced,
+    quality,
+};
+
+struct KtxOptions {
+    // Write a full mip chain, generated with a box filter
+    bool mipmaps = true;
+
+    // Drop the largest mip levels until the texture is no larger than this in
+    // either dimension. Zero keeps the full resolution.
+    uint32_t maxSize = 0;
+
+    KtxQuality quality = KtxQuality::balanced;
+
+    // Threads used by the block compressor within a single image
+    unsigned encoderThreads = 1;
+};
+
+// One texture written from a KtxSource
+struct KtxOutput {
+    // Channels to keep. Empty keeps the source channels.
+    std::string swizzle;
+
+    KtxEncoding encoding = KtxEncoding::uncompressed;
+
+    // Color data keeps the source transfer function and is filtered in linear
+    // space. Anything else, e.g. normals, is written as linear data.
+    bool color = false;
+};
+
+// A source image converted to one or more KTX textures. Only the image header
+// is read on construction. Outputs are registered with addOutput() and hashed
+// by prepare() so identical textures can be found before anything is written.
+// Each allocate() call allocates a complete KTX file in the writer, so
+// allocation order is the caller's. Pixel data is written later by write(),
+// which may be called from any thread.
+class KtxSource {
+public:
+    KtxSource(const fs::path& path, const KtxOptions& options);
+    KtxSource(KtxSource&& other) noexcept;
+    KtxSource& operator=(KtxSource&& other) noexcept;
+    ~KtxSource();
+
+    // Registers a texture to write from this image and returns its index
+    size_t addOutput(const KtxOutput& output);
+
+    // Size of the decoded image, e.g. to budget keepDecoded
+    [[nodiscard]] size_t decodedBytes() const;
+
+    // Decodes the image and hashes each output's pixels along with everything
+    // else that affects its file. Outputs with equal hashes, from any source,
+    // produce identical KTX files. The hash is 128 bits as outputs are merged
+    // on it without comparing pixels. The decoded image is kept for write() if
+    // requested, otherwise write() decodes it again.
+    void prepare(bool keepDecoded);
+
+    [[nodiscard]] Hash128 outputHash(size_t output) const;
+
+    // Allocates a KTX file for an output. The returned memory is not valid KTX
+    // data until write() completes. Outputs that are never allocated, e.g.
+    // duplicates, are not written.
+    [[nodiscard]] std::span<uint8_t> allocate(const WriterAllocator& allocator, size_t output);
+
+    // Fills in all allocated outputs
+    void write();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+// Whether 'file' is a complete KTX2 file: the identifier matches and its DFD,
+// key/value data and every mip level lie within it. For files read back from
+// outside the writer, e.g. the artifact cache.
+bool validKtxFile(std::span<const uint8_t> file);
 
 } // namespace rtrtool
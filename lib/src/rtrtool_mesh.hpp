@@ -0,0 +1,47 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <rtr/mesh.hpp>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace rtrtool {
+
+// A mesh in owned memory, for processing passes that change array sizes
+struct MeshData {
+#define RTR_ARRAY(type, name) std::vector<type> name;
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+};
+
+// Calls fn(array) for each per-vertex array, i.e. all but triangleVertices
+template <class Mesh, class Fn>
+void forEachVertexArray(Mesh& mesh, Fn&& fn) {
+    fn(mesh.vertexPositions);
+    fn(mesh.vertexNormals);
+    fn(mesh.vertexTexCoords0);
+    fn(mesh.vertexTangents);
+}
+
+// Returns the number of vertices, checking that every vertex array is either
+// empty or has one element per vertex
+inline size_t vertexCount(const MeshData& mesh) {
+    size_t count = mesh.vertexPositions.size();
+    forEachVertexArray(mesh, [count](const auto& array) {
+        if (!array.empty() && array.size() != count)
+            throw std::runtime_error("Mesh vertex arrays have different sizes");
+    });
+    return count;
+}
+
+// Throws if any triangle references a vertex at or beyond 'vertices'
+inline void checkIndices(std::span<const glm::uvec3> triangles, size_t vertices) {
+    for (const glm::uvec3& triangle : triangles)
+        if (triangle.x >= vertices || triangle.y >= vertices || triangle.z >= vertices)
+            throw std::runtime_error("Triangle vertex index out of range");
+}
+
+} // namespace rtrtool
@@ -0,0 +1,67 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <limits>
+#include <rtrtool/mesh_indices.hpp>
+#include <stdexcept>
+
+namespace rtrtool {
+
+namespace {
+
+template <class T>
+void decode(std::span<const uint8_t> encoded, std::span<glm::vec<3, T>> triangles) {
+    const uint8_t* next = encoded.data();
+    const uint8_t* end = next + encoded.size();
+    uint32_t       previous = 0;
+    for (glm::vec<3, T>& triangle : triangles) {
+        for (glm::length_t corner = 0; corner < 3; ++corner) {
+            // One byte is by far the common case
+            if (next == end)
+                throw std::runtime_error("Encoded triangles are truncated");
+            uint32_t zigzag = *next & 0x7fu;
+            for (uint32_t shift = 7; *next++ & 0x80u; shift += 7) {
+                if (next == end || shift > 28)
+                    throw std::runtime_error("Invalid encoded triangle index");
+                zigzag |= uint32_t(*next & 0x7fu) << shift;
+            }
+            previous += (zigzag >> 1) ^ (0u - (zigzag & 1u));
+            if constexpr (sizeof(T) < sizeof(uint32_t))
+                if (previous > std::numeric_limits<T>::max())
+                    throw std::runtime_error("Encoded triangle index out of range");
+            triangle[corner] = T(previous);
+        }
+    }
+    if (next != end)
+        throw std::runtime_error("Encoded triangles have trailing bytes");
+}
+
+} // namespace
+
+std::vector<uint8_t> encodeTriangles(std::span<const glm::uvec3> triangles) {
+    std::vector<uint8_t> result;
+    result.reserve(triangles.size() * 3);
+    uint32_t previous = 0;
+    for (const glm::uvec3& triangle : triangles) {
+        for (glm::length_t corner = 0; corner < 3; ++corner) {
+            int32_t  delta = int32_t(triangle[corner] - previous);
+            uint32_t zigzag = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+            while (zigzag >= 0x80u) {
+                result.push_back(uint8_t(zigzag | 0x80u));
+                zigzag >>= 7;
+            }
+            result.push_back(uint8_t(zigzag));
+            previous = triangle[corner];
+        }
+    }
+    return result;
+}
+
+void decodeTriangles(std::span<const uint8_t> encoded, std::span<glm::uvec3> triangles) {
+    decode(encoded, triangles);
+}
+
+void decodeTriangles(std::span<const uint8_t> encoded, std::span<glm::u16vec3> triangles) {
+    decode(encoded, triangles);
+}
+
+} // namespace rtrtool
@@ -0,0 +1,308 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <glm/geometric.hpp>
+#include <limits>
+#include <rtrtool_hash.hpp>
+#include <rtrtool_mesh_optimize.hpp>
+#include <stdexcept>
+
+namespace rtrtool {
+
+namespace {
+
+constexpr uint32_t NoVertex = std::numeric_limits<uint32_t>::max();
+
+// Keeps the vertices in 'order', in that order, and points triangles at their
+// new indices. 'remap' maps old vertex indices to new ones.
+void applyVertexOrder(MeshData& mesh, const std::vector<uint32_t>& order,
+                      const std::vector<uint32_t>& remap) {
+    forEachVertexArray(mesh, [&order](auto& array) {
+        if (array.empty())
+            return;
+        std::remove_reference_t<decltype(array)> reordered(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            reordered[i] = array[order[i]];
+        array = std::move(reordered);
+    });
+    for (glm::uvec3& triangle : mesh.triangleVertices)
+        triangle = {remap[triangle.x], remap[triangle.y], remap[triangle.z]};
+}
+
+// Per-vertex keys of all attributes, snapped to the weld grid. Negative zero
+// is made positive so that it welds with zero.
+std::vector<uint32_t> weldKeys(const MeshData& mesh, size_t vertices, float epsilon,
+                               size_t& keySize) {
+    keySize = 0;
+    forEachVertexArray(mesh, [&keySize](const auto& array) {
+        using T = typename std::remove_cvref_t<decltype(array)>::value_type;
+        if (!array.empty())
+            keySize += sizeof(T) / sizeof(float);
+    });
+    std::vector<uint32_t> result(vertices * keySize);
+    size_t                offset = 0;
+    forEachVertexArray(mesh, [&](const auto& array) {
+        using T = typename std::remove_cvref_t<decltype(array)>::value_type;
+        if (array.empty())
+            return;
+        constexpr size_t components = sizeof(T) / sizeof(float);
+        for (size_t v = 0; v < vertices; ++v) {
+            for (size_t c = 0; c < components; ++c) {
+                float value = array[v][glm::length_t(c)];
+                if (epsilon > 0.0f)
+                    value = std::round(value / epsilon);
+                result[v * keySize + offset + c] = std::bit_cast<uint32_t>(value + 0.0f);
+            }
+        }
+        offset += components;
+    });
+    return result;
+}
+
+// Tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+namespace forsyth {
+
+constexpr size_t CacheSize = 32;
+constexpr float  CacheDecayPower = 1.5f;
+constexpr float  LastTriangleScore = 0.75f;
+constexpr float  ValenceBoostScale = 2.0f;
+constexpr float  ValenceBoostPower = 0.5f;
+
+// Favors vertices recently used, which are likely in the cache, and vertices
+// with few remaining triangles, so that they are finished rather than leaving
+// isolated triangles behind
+float vertexScore(int cachePosition, uint32_t remainingValence) {
+    if (remainingValence == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // The last triangle's vertices score the same regardless of order
+        if (cachePosition < 3)
+            score = LastTriangleScore;
+        else
+            score = std::pow(1.0f - float(cachePosition - 3) / float(CacheSize - 3),
+                             CacheDecayPower);
+    }
+    return score + ValenceBoostScale * std::pow(float(remainingValence), -ValenceBoostPower);
+}
+
+} // namespace forsyth
+
+} // namespace
+
+size_t weldVertices(MeshData& mesh, float epsilon) {
+    size_t vertices = vertexCount(mesh);
+    checkIndices(mesh.triangleVertices, vertices);
+    size_t                keySize;
+    std::vector<uint32_t> keys = weldKeys(mesh, vertices, epsilon, keySize);
+    auto                  key = [&](size_t v) {
+        return std::span<const uint32_t>(keys).subspan(v * keySize, keySize);
+    };
+
+    // Open addressing hash table of the first vertex with each key
+    size_t                tableSize = std::bit_ceil(std::max<size_t>(vertices * 2, 1));
+    std::vector<uint32_t> table(tableSize, NoVertex);
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> remap(vertices);
+    for (size_t v = 0; v < vertices; ++v) {
+        auto   vertexKey = key(v);
+        size_t slot = hash64({reinterpret_cast<const uint8_t*>(vertexKey.data()),
+                              vertexKey.size_bytes()}) &
+                      (tableSize - 1);
+        while (table[slot] != NoVertex && !std::ranges::equal(key(table[slot]), vertexKey))
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] == NoVertex) {
+            table[slot] = uint32_t(v);
+            remap[v] = uint32_t(order.size());
+            order.push_back(uint32_t(v));
+        } else {
+            remap[v] = remap[table[slot]];
+        }
+    }
+    applyVertexOrder(mesh, order, remap);
+    return vertices - order.size();
+}
+
+size_t removeDegenerateTriangles(MeshData& mesh) {
+    checkIndices(mesh.triangleVertices, vertexCount(mesh));
+    const auto& positions = mesh.vertexPositions;
+    return std::erase_if(mesh.triangleVertices, [&positions](const glm::uvec3& triangle) {
+        if (triangle.x == triangle.y || triangle.y == triangle.z || triangle.z == triangle.x)
+            return true;
+        if (positions.empty())
+            return false;
+        glm::vec3 a = positions[triangle.x];
+        return glm::cross(positions[triangle.y] - a, positions[triangle.z] - a) == glm::vec3(0.0f);
+    });
+}
+
+size_t removeUnusedVertices(MeshData& mesh) {
+    size_t vertices = vertexCount(mesh);
+    checkIndices(mesh.triangleVertices, vertices);
+    std::vector<uint32_t> remap(vertices, NoVertex);
+    for (const glm::uvec3& triangle : mesh.triangleVertices)
+        for (glm::length_t c = 0; c < 3; ++c)
+            remap[triangle[c]] = 0;
+    std::vector<uint32_t> order;
+    for (size_t v = 0; v < vertices; ++v) {
+        if (remap[v] != NoVertex) {
+            remap[v] = uint32_t(order.size());
+            order.push_back(uint32_t(v));
+        }
+    }
+    applyVertexOrder(mesh, order, remap);
+    return vertices - order.size();
+}
+
+VertexCacheStats analyzeVertexCache(const MeshData& mesh, size_t cacheSize) {
+    size_t vertices = vertexCount(mesh);
+    checkIndices(mesh.triangleVertices, vertices);
+
+    // A vertex is in the FIFO cache if it missed within the last 'cacheSize'
+    // misses
+    std::vector<size_t> missTimes(vertices, 0);
+    size_t              time = cacheSize + 1;
+    size_t              misses = 0;
+    size_t              usedVertices = 0;
+    for (const glm::uvec3& triangle : mesh.triangleVertices) {
+        for (glm::length_t c = 0; c < 3; ++c) {
+            size_t& missTime = missTimes[triangle[c]];
+            if (time - missTime > cacheSize) {
+                usedVertices += missTime == 0;
+                missTime = time++;
+                misses++;
+            }
+        }
+    }
+    VertexCacheStats result;
+    if (!mesh.triangleVertices.empty())
+        result.acmr = float(misses) / float(mesh.triangleVertices.size());
+    if (usedVertices)
+        result.atvr = float(misses) / float(usedVertices);
+    return result;
+}
+
+void optimizeVertexCache(MeshData& mesh) {
+    using namespace forsyth;
+    constexpr uint32_t NoTriangle = std::numeric_limits<uint32_t>::max();
+    size_t             vertices = vertexCount(mesh);
+    checkIndices(mesh.triangleVertices, vertices);
+    const std::vector<glm::uvec3>& triangles = mesh.triangleVertices;
+
+    // Triangles adjacent to each vertex. The first 'valence' entries of each
+    // vertex's range are those not yet emitted.
+    std::vector<uint32_t> valence(vertices, 0);
+    for (const glm::uvec3& triangle : triangles)
+        for (glm::length_t c = 0; c < 3; ++c)
+            valence[triangle[c]]++;
+    std::vector<uint32_t> adjacencyOffsets(vertices + 1, 0);
+    for (size_t v = 0; v < vertices; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+    std::vector<uint32_t> adjacency(triangles.size() * 3);
+    {
+        std::vector<uint32_t> next(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangles.size(); ++t)
+            for (glm::length_t c = 0; c < 3; ++c)
+                adjacency[next[triangles[t][c]]++] = uint32_t(t);
+    }
+    auto liveTriangles = [&](uint32_t v) {
+        return std::span(adjacency).subspan(adjacencyOffsets[v], valence[v]);
+    };
+
+    std::vector<int>   cachePositions(vertices, -1);
+    std::vector<float> vertexScores(vertices);
+    for (size_t v = 0; v < vertices; ++v)
+        vertexScores[v] = vertexScore(-1, valence[v]);
+    auto triangleScore = [&](uint32_t t) {
+        return vertexScores[triangles[t].x] + vertexScores[triangles[t].y] +
+               vertexScores[triangles[t].z];
+    };
+    uint32_t best = NoTriangle;
+    float    bestScore = -1.0f;
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        if (float score = triangleScore(uint32_t(t)); score > bestScore) {
+            best = uint32_t(t);
+            bestScore = score;
+        }
+    }
+
+    std::vector<glm::uvec3> result;
+    std::vector<bool>       emitted(triangles.size(), false);
+    std::vector<uint32_t>   cache;
+    std::vector<uint32_t>   nextCache;
+    size_t                  scanCursor = 0;
+    result.reserve(triangles.size());
+    while (result.size() < triangles.size()) {
+        // Fall back to the next unemitted triangle in the original order if
+        // nothing adjacent to the cache is left
+        if (best == NoTriangle) {
+            while (emitted[scanCursor])
+                ++scanCursor;
+            best = uint32_t(scanCursor);
+        }
+        const glm::uvec3 triangle = triangles[best];
+        emitted[best] = true;
+        result.push_back(triangle);
+        for (glm::length_t c = 0; c < 3; ++c) {
+            std::span<uint32_t> live = liveTriangles(triangle[c]);
+            std::iter_swap(std::ranges::find(live, best), live.end() - 1);
+            valence[triangle[c]]--;
+        }
+
+        // The triangle's vertices move to the front of the LRU cache, pushing
+        // the oldest beyond its end
+        nextCache.clear();
+        for (glm::length_t c = 0; c < 3; ++c)
+            if (std::ranges::find(nextCache, triangle[c]) == nextCache.end())
+                nextCache.push_back(triangle[c]);
+        for (uint32_t v : cache)
+            if (std::ranges::find(nextCache, v) == nextCache.end())
+                nextCache.push_back(v);
+        for (size_t i = 0; i < nextCache.size(); ++i) {
+            uint32_t v = nextCache[i];
+            cachePositions[v] = i < CacheSize ? int(i) : -1;
+            vertexScores[v] = vertexScore(cachePositions[v], valence[v]);
+        }
+
+        // Only triangles around vertices whose score changed are candidates
+        best = NoTriangle;
+        bestScore = -1.0f;
+        for (uint32_t v : nextCache) {
+            for (uint32_t t : liveTriangles(v)) {
+                if (float score = triangleScore(t); score > bestScore) {
+                    best = t;
+                    bestScore = score;
+                }
+            }
+        }
+        if (nextCache.size() > CacheSize)
+            nextCache.resize(CacheSize);
+        std::swap(cache, nextCache);
+    }
+    mesh.triangleVertices = std::move(result);
+}
+
+void optimizeVertexFetch(MeshData& mesh) {
+    size_t vertices = vertexCount(mesh);
+    checkIndices(mesh.triangleVertices, vertices);
+    std::vector<uint32_t> remap(vertices, NoVertex);
+    std::vector<uint32_t> order;
+    order.reserve(vertices);
+    auto use = [&](uint32_t v) {
+        if (remap[v] == NoVertex) {
+            remap[v] = uint32_t(order.size());
+            order.push_back(v);
+        }
+    };
+    for (const glm::uvec3& triangle : mesh.triangleVertices)
+        for (glm::length_t c = 0; c < 3; ++c)
+            use(triangle[c]);
+    for (size_t v = 0; v < vertices; ++v)
+        use(uint32_t(v));
+    applyVertexOrder(mesh, order, remap);
+}
+
+} // namespace rtrtool
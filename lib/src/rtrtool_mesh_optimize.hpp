@@ -0,0 +1,42 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <rtrtool_mesh.hpp>
+
+namespace rtrtool {
+
+// Merges vertices whose attributes are all equal and rewrites
+// triangleVertices to match. With a non-zero epsilon, attributes are compared
+// after snapping each component to a grid of that size, in each attribute's
+// own units. The first vertex of each group is kept unmodified, in its
+// original order. Returns the number of vertices removed.
+size_t weldVertices(MeshData& mesh, float epsilon);
+
+// Removes triangles that reference the same vertex twice or have exactly zero
+// area. Returns the number of triangles removed.
+size_t removeDegenerateTriangles(MeshData& mesh);
+
+// Removes vertices no triangle references, keeping their order. Returns the
+// number of vertices removed.
+size_t removeUnusedVertices(MeshData& mesh);
+
+// Post-transform vertex cache efficiency, simulated with a FIFO cache. ACMR is
+// the average number of cache misses per triangle, 0.5 at best for large
+// regular meshes and 3 at worst. ATVR is the misses per vertex, 1 at best.
+struct VertexCacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+VertexCacheStats analyzeVertexCache(const MeshData& mesh, size_t cacheSize = 16);
+
+// Reorders triangles for post-transform vertex cache hits with Forsyth's
+// linear-speed vertex cache optimization. Vertices are not moved.
+void optimizeVertexCache(MeshData& mesh);
+
+// Reorders vertices by first use in triangleVertices for vertex fetch
+// locality. Vertices no triangle references are moved to the end.
+void optimizeVertexFetch(MeshData& mesh);
+
+} // namespace rtrtool
@@ -0,0 +1,75 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstring>
+#include <decodeless/writer.hpp>
+#include <rtr/mesh.hpp>
+#include <rtrtool/converter.hpp>
+#include <rtrtool_hash.hpp>
+#include <rtrtool_mesh.hpp>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace rtrtool {
+
+// Mesh arrays, allocated in the output file
+struct MeshArrays {
+#define RTR_ARRAY(type, name) std::span<type> name;
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+};
+
+template <class T>
+std::span<const uint8_t> bytesOf(std::span<const T> values) {
+    return {reinterpret_cast<const uint8_t*>(values.data()), values.size_bytes()};
+}
+
+// Writes arrays to the file once per unique content. Arrays are found by a
+// hash of their bytes, seeded with the element size and alignment so that
+// reused bytes stay valid for the new type, and then compared in full.
+class ArrayDeduplicator {
+public:
+    ArrayDeduplicator(const WriterAllocator& allocator) : m_allocator(allocator) {}
+
+    template <class T>
+    std::span<T> write(const std::vector<T>& values) {
+        if (values.empty())
+            return {};
+        std::span<const uint8_t> bytes = bytesOf(std::span<const T>(values));
+        uint64_t                 hash = hash64(bytes, hashObject(alignof(T), sizeof(T)));
+        auto [first, last] = m_arrays.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            if (it->second.size() == bytes.size() &&
+                std::memcmp(it->second.data(), bytes.data(), bytes.size()) == 0) {
+                m_duplicates++;
+                m_duplicateBytes += bytes.size();
+                return {reinterpret_cast<T*>(it->second.data()), values.size()};
+            }
+        }
+        std::span<T> result = decodeless::create::array<T>(m_allocator, values);
+        m_arrays.emplace(hash, std::span<uint8_t>(reinterpret_cast<uint8_t*>(result.data()),
+                                                  result.size_bytes()));
+        return result;
+    }
+
+    MeshArrays write(const MeshData& mesh) {
+        MeshArrays result;
+#define RTR_ARRAY(type, name) result.name = write(mesh.name);
+        RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+        return result;
+    }
+
+    size_t   duplicates() const { return m_duplicates; }
+    uint64_t duplicateBytes() const { return m_duplicateBytes; }
+
+private:
+    WriterAllocator                                       m_allocator;
+    std::unordered_multimap<uint64_t, std::span<uint8_t>> m_arrays;
+    size_t                                                m_duplicates = 0;
+    uint64_t                                              m_duplicateBytes = 0;
+};
+
+} // namespace rtrtool
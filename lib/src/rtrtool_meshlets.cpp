@@ -0,0 +1,123 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <rtrtool_mesh.hpp>
+#include <rtrtool_meshlets.hpp>
+#include <stdexcept>
+
+namespace rtrtool {
+
+namespace {
+
+constexpr uint32_t NoVertex = std::numeric_limits<uint32_t>::max();
+
+// Cones wider than this, by the cosine of their half angle, are rarely
+// entirely backfacing and are not worth testing
+constexpr float MinConeCosine = 0.1f;
+
+void computeBounds(const MeshletData& data, std::span<const glm::vec3> positions,
+                   Meshlet& meshlet) {
+    std::span<const uint32_t> vertices =
+        std::span(data.vertices).subspan(meshlet.vertexOffset, meshlet.vertexCount);
+    std::span<const glm::u8vec3> triangles =
+        std::span(data.triangles).subspan(meshlet.triangleOffset, meshlet.triangleCount);
+
+    // Sphere around the bounding box center. Not minimal, but cheap.
+    glm::vec3 lo = positions[vertices[0]];
+    glm::vec3 hi = lo;
+    for (uint32_t vertex : vertices) {
+        lo = glm::min(lo, positions[vertex]);
+        hi = glm::max(hi, positions[vertex]);
+    }
+    meshlet.center = (lo + hi) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t vertex : vertices)
+        meshlet.radius = std::max(meshlet.radius, glm::length(positions[vertex] - meshlet.center));
+
+    // Normal cone around the average triangle normal. Degenerate triangles
+    // have no facing and are ignored.
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangles.size());
+    glm::vec3 sum(0.0f);
+    for (const glm::u8vec3& triangle : triangles) {
+        glm::vec3 a = positions[vertices[triangle.x]];
+        glm::vec3 b = positions[vertices[triangle.y]];
+        glm::vec3 c = positions[vertices[triangle.z]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float     length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            sum += normals.back();
+        }
+    }
+    meshlet.coneAxis = glm::vec3(0.0f);
+    meshlet.coneCutoff = 1.0f;
+    float sumLength = glm::length(sum);
+    if (normals.empty() || sumLength == 0.0f)
+        return;
+    glm::vec3 axis = sum / sumLength;
+    float     minDot = 1.0f;
+    for (const glm::vec3& normal : normals)
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    if (minDot <= MinConeCosine)
+        return;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+} // namespace
+
+MeshletData buildMeshlets(std::span<const glm::uvec3> triangles,
+                          std::span<const glm::vec3> positions, uint32_t maxVertices,
+                          uint32_t maxTriangles) {
+    if (maxVertices < 3 || maxVertices > 256 || maxTriangles < 1)
+        throw std::runtime_error("Meshlet limits must allow 3 to 256 vertices and a triangle");
+    checkIndices(triangles, positions.size());
+
+    MeshletData result;
+    result.triangles.reserve(triangles.size());
+
+    // Mesh vertex to local index in the current meshlet
+    std::vector<uint32_t> localIndex(positions.size(), NoVertex);
+    Meshlet               current{};
+
+    auto finish = [&]() {
+        if (current.triangleCount == 0)
+            return;
+        computeBounds(result, positions, current);
+        result.meshlets.push_back(current);
+        for (uint32_t vertex : std::span(result.vertices).subspan(current.vertexOffset))
+            localIndex[vertex] = NoVertex;
+        current = Meshlet{};
+        current.vertexOffset = uint32_t(result.vertices.size());
+        current.triangleOffset = uint32_t(result.triangles.size());
+    };
+    for (const glm::uvec3& triangle : triangles) {
+        uint32_t newVertices = 0;
+        for (glm::length_t corner = 0; corner < 3; ++corner)
+            if (localIndex[triangle[corner]] == NoVertex &&
+                (corner < 1 || triangle[corner] != triangle[0]) &&
+                (corner < 2 || triangle[corner] != triangle[1]))
+                ++newVertices;
+        if (current.vertexCount + newVertices > maxVertices ||
+            current.triangleCount + 1 > maxTriangles)
+            finish();
+        glm::u8vec3 local;
+        for (glm::length_t corner = 0; corner < 3; ++corner) {
+            uint32_t& index = localIndex[triangle[corner]];
+            if (index == NoVertex) {
+                index = current.vertexCount++;
+                result.vertices.push_back(triangle[corner]);
+            }
+            local[corner] = uint8_t(index);
+        }
+        result.triangles.push_back(local);
+        current.triangleCount++;
+    }
+    finish();
+    return result;
+}
+
+} // namespace rtrtool
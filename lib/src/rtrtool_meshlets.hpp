@@ -0,0 +1,27 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <rtrtool/meshlets.hpp>
+#include <span>
+#include <vector>
+
+namespace rtrtool {
+
+// Owned meshlet arrays, matching MeshletMesh
+struct MeshletData {
+    std::vector<Meshlet>     meshlets;
+    std::vector<uint32_t>    vertices;
+    std::vector<glm::u8vec3> triangles;
+};
+
+// Partitions triangles into meshlets in order, starting a new meshlet when the
+// next triangle would exceed either limit. Clusters are only as spatially
+// coherent as the triangle order, so run optimizeVertexCache() first.
+// maxVertices must be between 3 and 256 and maxTriangles at least 1.
+MeshletData buildMeshlets(std::span<const glm::uvec3> triangles,
+                          std::span<const glm::vec3> positions, uint32_t maxVertices,
+                          uint32_t maxTriangles);
+
+} // namespace rtrtool
@@ -0,0 +1,206 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <rtrtool_mipmap.hpp>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace rtrtool {
+
+namespace {
+
+inline float srgbToLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSrgb(float c) {
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// Lookup tables for 8-bit sRGB. The inverse table is fine enough that its
+// quantization is below half an 8-bit step.
+struct Srgb8Tables {
+    static constexpr size_t          InverseSize = 8192;
+    std::array<float, 256>           toLinear;
+    std::array<uint8_t, InverseSize> fromLinear;
+
+    Srgb8Tables() {
+        for (size_t i = 0; i < toLinear.size(); ++i)
+            toLinear[i] = srgbToLinear(float(i) / 255.0f);
+        for (size_t i = 0; i < fromLinear.size(); ++i)
+            fromLinear[i] =
+                uint8_t(linearToSrgb(float(i) / float(InverseSize - 1)) * 255.0f + 0.5f);
+    }
+    uint8_t encode(float linear) const {
+        return fromLinear[size_t(std::clamp(linear, 0.0f, 1.0f) * float(InverseSize - 1) + 0.5f)];
+    }
+};
+
+const Srgb8Tables& srgb8Tables() {
+    static const Srgb8Tables tables;
+    return tables;
+}
+
+// Converts a row of pixels to linear floats
+template <class T>
+void decodeRow(const T* src, float* dst, size_t count, uint32_t channels, bool srgb) {
+    if constexpr (std::is_same_v<T, float>) {
+        std::copy(src, src + count, dst);
+    } else {
+        constexpr float scale = 1.0f / float(std::numeric_limits<T>::max());
+        if (!srgb) {
+            for (size_t i = 0; i < count; ++i)
+                dst[i] = float(src[i]) * scale;
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            bool alpha = channels == 4 && i % 4 == 3;
+            if (alpha)
+                dst[i] = float(src[i]) * scale;
+            else if constexpr (std::is_same_v<T, uint8_t>)
+                dst[i] = srgb8Tables().toLinear[src[i]];
+            else
+                dst[i] = srgbToLinear(float(src[i]) * scale);
+        }
+    }
+}
+
+// Converts a row of linear floats back to pixels
+template <class T>
+void encodeRow(const float* src, T* dst, size_t count, uint32_t channels, bool srgb) {
+    if constexpr (std::is_same_v<T, float>) {
+        std::copy(src, src + count, dst);
+    } else {
+        constexpr float maxValue = float(std::numeric_limits<T>::max());
+        if (!srgb) {
+            for (size_t i = 0; i < count; ++i)
+                dst[i] = T(std::clamp(src[i], 0.0f, 1.0f) * maxValue + 0.5f);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            bool alpha = channels == 4 && i % 4 == 3;
+            if (alpha)
+                dst[i] = T(std::clamp(src[i], 0.0f, 1.0f) * maxValue + 0.5f);
+            else if constexpr (std::is_same_v<T, uint8_t>)
+                dst[i] = srgb8Tables().encode(src[i]);
+            else
+                dst[i] = T(std::clamp(linearToSrgb(src[i]), 0.0f, 1.0f) * maxValue + 0.5f);
+        }
+    }
+}
+
+// Source texels and their weights for one destination texel along an axis.
+// Even sizes average pairs. Odd sizes use three overlapping taps weighted so
+// that every source texel contributes equally, e.g. 5 texels filter to 2 with
+// weights 2/5, 2/5, 1/5 and 1/5, 2/5, 2/5. Unused taps have zero weight and
+// repeat a valid index. Weights are double for exact integer filtering.
+struct Taps {
+    std::array<uint32_t, 3> index;
+    std::array<double, 3>   weight;
+};
+
+std::vector<Taps> filterTaps(uint32_t srcSize) {
+    const uint32_t    dstSize = std::max(1u, srcSize / 2);
+    std::vector<Taps> result(dstSize);
+    for (uint32_t i = 0; i < dstSize; ++i) {
+        if (srcSize == 1) {
+            result[i] = {{0, 0, 0}, {1.0, 0.0, 0.0}};
+        } else if (srcSize % 2 == 0) {
+            result[i] = {{i * 2, i * 2 + 1, i * 2 + 1}, {0.5, 0.5, 0.0}};
+        } else {
+            const double n = double(dstSize);
+            const double size = double(srcSize);
+            result[i] = {{i * 2, i * 2 + 1, i * 2 + 2},
+                         {(n - double(i)) / size, n / size, (double(i) + 1.0) / size}};
+        }
+    }
+    return result;
+}
+
+// The filter works a row at a time in linear float. Rows are summed vertically
+// first, then horizontally, as separate flat loops the compiler can vectorize.
+template <class T>
+void downsampleT(uint32_t channels, bool srgb, uint32_t srcWidth, uint32_t srcHeight,
+                 const T* src, T* dst) {
+    const std::vector<Taps> xTaps = filterTaps(srcWidth);
+    const std::vector<Taps> yTaps = filterTaps(srcHeight);
+    const size_t            srcRow = size_t(srcWidth) * channels;
+    const size_t            dstRow = xTaps.size() * channels;
+    std::vector<float>      row(srcRow), sum(srcRow), result(dstRow);
+    for (size_t y = 0; y < yTaps.size(); ++y) {
+        std::ranges::fill(sum, 0.0f);
+        for (size_t tap = 0; tap < 3; ++tap) {
+            const float weight = float(yTaps[y].weight[tap]);
+            if (weight == 0.0f)
+                continue;
+            decodeRow(src + yTaps[y].index[tap] * srcRow, row.data(), srcRow, channels, srgb);
+            for (size_t i = 0; i < srcRow; ++i)
+                sum[i] += row[i] * weight;
+        }
+        for (size_t x = 0; x < xTaps.size(); ++x) {
+            const Taps&  taps = xTaps[x];
+            const size_t x0 = size_t(taps.index[0]) * channels;
+            const size_t x1 = size_t(taps.index[1]) * channels;
+            const size_t x2 = size_t(taps.index[2]) * channels;
+            const float  w0 = float(taps.weight[0]);
+            const float  w1 = float(taps.weight[1]);
+            const float  w2 = float(taps.weight[2]);
+            for (uint32_t c = 0; c < channels; ++c)
+                result[x * channels + c] = sum[x0 + c] * w0 + sum[x1 + c] * w1 + sum[x2 + c] * w2;
+        }
+        encodeRow(result.data(), dst + y * dstRow, dstRow, channels, srgb);
+    }
+}
+
+// Integer data is filtered in double precision, rounding to nearest. Even
+// sizes are averaged exactly.
+void downsampleUint32(uint32_t channels, uint32_t srcWidth, uint32_t srcHeight,
+                      const uint32_t* src, uint32_t* dst) {
+    const std::vector<Taps> xTaps = filterTaps(srcWidth);
+    const std::vector<Taps> yTaps = filterTaps(srcHeight);
+    const size_t            srcRow = size_t(srcWidth) * channels;
+    for (const Taps& yTap : yTaps) {
+        for (const Taps& xTap : xTaps) {
+            for (uint32_t c = 0; c < channels; ++c) {
+                double sum = 0.0;
+                for (size_t j = 0; j < 3; ++j)
+                    for (size_t i = 0; i < 3; ++i)
+                        sum += double(src[yTap.index[j] * srcRow + xTap.index[i] * channels + c]) *
+                               yTap.weight[j] * xTap.weight[i];
+                *dst++ = uint32_t(sum + 0.5);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void downsample(PixelType type, uint32_t channels, bool srgb, uint32_t srcWidth,
+                uint32_t srcHeight, const void* src, void* dst) {
+    switch (type) {
+    case PixelType::unorm8:
+        downsampleT(channels, srgb, srcWidth, srcHeight, static_cast<const uint8_t*>(src),
+                    static_cast<uint8_t*>(dst));
+        break;
+    case PixelType::unorm16:
+        downsampleT(channels, srgb, srcWidth, srcHeight, static_cast<const uint16_t*>(src),
+                    static_cast<uint16_t*>(dst));
+        break;
+    case PixelType::float32:
+        downsampleT(channels, false, srcWidth, srcHeight, static_cast<const float*>(src),
+                    static_cast<float*>(dst));
+        break;
+    case PixelType::uint32:
+        downsampleUint32(channels, srcWidth, srcHeight, static_cast<const uint32_t*>(src),
+                         static_cast<uint32_t*>(dst));
+        break;
+    default:
+        throw std::runtime_error("unsupported pixel type for downsampling");
+    }
+}
+
+} // namespace rtrtool
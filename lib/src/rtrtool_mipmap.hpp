@@ -0,0 +1,32 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace rtrtool {
+
+enum class PixelType {
+    unorm8,
+    unorm16,
+    uint32,
+    float32,
+};
+
+// Number of levels in a full mip chain down to 1x1
+inline uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+    return uint32_t(std::bit_width(std::max(std::max(width, height), 1u)));
+}
+
+// Halves an image, rounding each dimension down but not below one. Even
+// dimensions use a box filter. Odd dimensions use three weighted taps so the
+// last row or column is not dropped. For sRGB data, color channels are
+// averaged in linear space while a fourth alpha channel is always linear. Only
+// unorm types can be sRGB.
+void downsample(PixelType type, uint32_t channels, bool srgb, uint32_t srcWidth,
+                uint32_t srcHeight, const void* src, void* dst);
+
+} // namespace rtrtool
@@ -0,0 +1,538 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <rtr/ktx.hpp>
+#include <rtr/mesh.hpp>
+#include <rtr/write_mesh.hpp>
+#include <rtrtool/bvh.hpp>
+#include <rtrtool/instancing.hpp>
+#include <rtrtool/mesh_indices.hpp>
+#include <rtrtool/optimizer.hpp>
+#include <rtrtool/world_transforms.hpp>
+#include <rtrtool_bvh.hpp>
+#include <rtrtool_hash.hpp>
+#include <rtrtool_mesh_optimize.hpp>
+#include <rtrtool_mesh_writer.hpp>
+#include <rtrtool_optimize.hpp>
+#include <rtrtool_parallel.hpp>
+#include <rtrtool_scene.hpp>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace rtrtool {
+
+namespace {
+
+constexpr std::pair<OptimizePass, std::string_view> PassNames[] = {
+    {OptimizePass::weld, "weld"},
+    {OptimizePass::vertexCache, "vertex-cache"},
+    {OptimizePass::dedupeMeshes, "dedupe-meshes"},
+    {OptimizePass::dedupeTextures, "dedupe-textures"},
+    {OptimizePass::prune, "prune"},
+    {OptimizePass::layout, "layout"},
+};
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template <class T>
+uint64_t arrayBytes(const std::vector<T>& array) {
+    return array.size() * sizeof(T);
+}
+
+// Removes items not in 'keep' and returns a map from old to new indices
+template <class T>
+std::vector<uint32_t> compact(std::vector<T>& items, const std::vector<bool>& keep) {
+    std::vector<uint32_t> remap(items.size());
+    size_t                kept = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        remap[i] = uint32_t(kept);
+        if (keep[i]) {
+            if (kept != i)
+                items[kept] = std::move(items[i]);
+            kept++;
+        }
+    }
+    items.resize(kept);
+    return remap;
+}
+
+// Calls fn(slot) for each texture slot of a material that is set
+template <class Fn>
+void forEachTextureSlot(rtr::common::Material& material, Fn&& fn) {
+    for (rtr::optional_index32* slot :
+         {&material.textures.color, &material.textures.metallic, &material.textures.roughness,
+          &material.textures.normal})
+        if (*slot)
+            fn(*slot);
+}
+
+// Moves items into an order from firstUseOrder() and returns a map from old
+// to new indices
+template <class T>
+std::vector<uint32_t> reorder(std::vector<T>& items, std::span<const uint32_t> order) {
+    std::vector<T>        result;
+    std::vector<uint32_t> remap(items.size());
+    result.reserve(items.size());
+    for (uint32_t item : order) {
+        remap[item] = uint32_t(result.size());
+        result.push_back(std::move(items[item]));
+    }
+    items = std::move(result);
+    return remap;
+}
+
+// Finds items with identical bytes. Returns a map from each item to the first
+// identical one, or itself.
+template <class Hash, class Equal>
+std::vector<uint32_t> findDuplicates(size_t count, Hash&& hash, Equal&& equal) {
+    std::vector<uint32_t>                       result(count);
+    std::unordered_multimap<uint64_t, uint32_t> unique;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t key = hash(i);
+        result[i] = i;
+        auto [first, last] = unique.equal_range(key);
+        for (auto it = first; it != last; ++it) {
+            if (equal(it->second, i)) {
+                result[i] = it->second;
+                break;
+            }
+        }
+        if (result[i] == i)
+            unique.emplace(key, i);
+    }
+    return result;
+}
+
+uint64_t hashMesh(const MeshData& mesh) {
+    uint64_t result = 0;
+#define RTR_ARRAY(type, name)                                                                      \
+    result = hash64(bytesOf(std::span<const type>(mesh.name)),                                     \
+                    hashObject(mesh.name.size(), result));
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    return result;
+}
+
+bool sameBytes(std::span<const uint8_t> a, std::span<const uint8_t> b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+bool sameMesh(const MeshData& a, const MeshData& b) {
+    bool result = true;
+#define RTR_ARRAY(type, name)                                                                      \
+    result = result && sameBytes(bytesOf(std::span<const type>(a.name)),                           \
+                                 bytesOf(std::span<const type>(b.name)));
+    RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    return result;
+}
+
+// The whole KTX file a texture points to. KTX2 files end with the mip level
+// data, so it ends at the last byte of any level.
+std::span<const uint8_t> ktxFile(const rtr::ktx::Header& header) {
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(&header);
+    const uint8_t* end = begin + sizeof(header);
+    for (const auto& level : header.levelsRaw())
+        end = std::max(end, reinterpret_cast<const uint8_t*>(level.data() + level.size()));
+    return {begin, end};
+}
+
+OptimizeDocument loadDocument(const rtr::RootHeader& input, size_t& droppedHeaders) {
+    const auto* meshHeader = input.findSupported<rtr::common::MeshHeader>();
+    const auto* materialHeader = input.findSupported<rtr::common::MaterialHeader>();
+    const auto* sceneHeader = input.findSupported<rtr::SceneHeader>();
+    const auto* indicesHeader = input.findSupported<MeshIndicesHeader>();
+    if (!meshHeader || !materialHeader || !sceneHeader)
+        throw std::runtime_error("Input is missing a mesh, material or scene header");
+    const auto* instancingHeader = input.findSupported<InstancingHeader>();
+    const auto* bvhHeader = input.findSupported<BvhHeader>();
+    droppedHeaders = input.headers.size() - 3 - (indicesHeader ? 1 : 0) -
+                     (instancingHeader ? 1 : 0) - (bvhHeader ? 1 : 0) -
+                     (input.findSupported<WorldTransformHeader>() ? 1 : 0);
+
+    OptimizeDocument result;
+    result.bvh = bvhHeader != nullptr;
+    for (size_t i = 0; i < meshHeader->meshes.size(); ++i) {
+        const rtr::common::Mesh& mesh = meshHeader->meshes[i];
+        MeshData&                data = result.meshes.emplace_back();
+#define RTR_ARRAY(type, name) data.name.assign(mesh.name.begin(), mesh.name.end());
+        RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+        if (indicesHeader && indicesHeader->meshes[i].triangleCount) {
+            const MeshIndices& indices = indicesHeader->meshes[i];
+            data.triangleVertices.resize(indices.triangleCount);
+            if (indices.encoded.size())
+                decodeTriangles(indices.encoded, data.triangleVertices);
+            else
+                std::ranges::transform(indices.triangles16, data.triangleVertices.begin(),
+                                       [](const glm::u16vec3& t) { return glm::uvec3(t); });
+        }
+
+        // Names are not read back from the mesh header, so meshes are named
+        // by their index in the input
+        result.meshNames.push_back("mesh" + std::to_string(i));
+    }
+
+    result.materials.assign(materialHeader->materials.begin(), materialHeader->materials.end());
+    for (const rtr::common::Texture& texture : materialHeader->textures)
+        result.textures.push_back(ktxFile(*texture.ktx));
+
+    result.nodes.assign(sceneHeader->nodes.begin(), sceneHeader->nodes.end());
+    for (const auto& root : sceneHeader->scenes)
+        result.scenes.push_back(uint32_t(&*root - &sceneHeader->nodes[0]));
+    result.instances.assign(sceneHeader->instances.begin(), sceneHeader->instances.end());
+    result.cameras.assign(sceneHeader->cameras.begin(), sceneHeader->cameras.end());
+    for (const auto& name : sceneHeader->cameraNames)
+        result.cameraNames.emplace_back(name.begin(), name.end());
+    result.directionalLights.assign(sceneHeader->directionalLights.begin(),
+                                    sceneHeader->directionalLights.end());
+    result.pointLights.assign(sceneHeader->pointLights.begin(), sceneHeader->pointLights.end());
+    result.spotLights.assign(sceneHeader->spotLights.begin(), sceneHeader->spotLights.end());
+    result.meshLights.assign(sceneHeader->meshLights.begin(), sceneHeader->meshLights.end());
+    if (instancingHeader) {
+        for (const InstanceGroup& group : instancingHeader->groups) {
+            result.instanceGroups.push_back(group.instance);
+            result.instanceTransforms.emplace_back(group.transforms.data(),
+                                                   group.transforms.size());
+        }
+    }
+    return result;
+}
+
+// Writes the document in the same layout as convertFromGltf()
+rtr::RootHeader* writeDocument(const WriterAllocator& allocator, const OptimizeDocument& document,
+                               OptimizeStats& stats) {
+    rtr::RootHeader* header = decodeless::create::object<rtr::RootHeader>(allocator);
+    std::vector<decodeless::offset_ptr<decodeless::Header>> subHeaders;
+
+    // Sub-header table, filled in once they are all written. Instancing and
+    // the BVH are optional.
+    size_t headerCount = 4 + (document.instanceGroups.empty() ? 0 : 1) + (document.bvh ? 1 : 0);
+
+    std::span<decodeless::offset_ptr<decodeless::Header>> headerTable =
+        decodeless::create::array<decodeless::offset_ptr<decodeless::Header>>(allocator,
+                                                                               headerCount);
+
+    rtr::SceneHeader* sceneHeader = decodeless::create::object<rtr::SceneHeader>(allocator);
+    subHeaders.push_back(sceneHeader);
+    sceneHeader->nodes = decodeless::create::array<rtr::Node>(allocator, document.nodes);
+    sceneHeader->scenes = decodeless::create::array<decodeless::offset_ptr<rtr::Node>>(
+        allocator, document.scenes.size());
+    for (size_t i = 0; i < document.scenes.size(); ++i)
+        sceneHeader->scenes[i] = &sceneHeader->nodes[document.scenes[i]];
+    std::vector<rtr::offset_string> cameraNames;
+    for (const std::string& name : document.cameraNames)
+        cameraNames.push_back(decodeless::create::array<char>(allocator, std::string_view(name)));
+    sceneHeader->instances =
+        decodeless::create::array<rtr::Instance>(allocator, document.instances);
+    sceneHeader->cameras = decodeless::create::array<rtr::Camera>(allocator, document.cameras);
+    sceneHeader->cameraNames =
+        decodeless::create::array<rtr::offset_string>(allocator, cameraNames);
+    sceneHeader->directionalLights =
+        decodeless::create::array<rtr::DirectionalLight>(allocator, document.directionalLights);
+    sceneHeader->pointLights =
+        decodeless::create::array<rtr::PointLight>(allocator, document.pointLights);
+    sceneHeader->spotLights =
+        decodeless::create::array<rtr::SpotLight>(allocator, document.spotLights);
+    sceneHeader->meshLights =
+        decodeless::create::array<rtr::MeshLight>(allocator, document.meshLights);
+
+    // Groups from one node's primitives keep sharing their transforms
+    if (!document.instanceGroups.empty()) {
+        std::vector<InstanceGroup> groups(document.instanceGroups.size());
+        std::unordered_map<const glm::mat4x3*, std::span<const glm::mat4x3>> written;
+        for (size_t i = 0; i < groups.size(); ++i) {
+            std::span<const glm::mat4x3> transforms = document.instanceTransforms[i];
+            auto [it, created] = written.try_emplace(transforms.data());
+            if (created)
+                it->second = decodeless::create::array<glm::mat4x3>(allocator, transforms);
+            groups[i].instance = document.instanceGroups[i];
+            groups[i].transforms = it->second;
+        }
+        InstancingHeader* instancingHeader =
+            decodeless::create::object<InstancingHeader>(allocator);
+        instancingHeader->groups = decodeless::create::array<InstanceGroup>(allocator, groups);
+        subHeaders.push_back(instancingHeader);
+    }
+
+    WorldTransforms       worldTransforms = flattenHierarchy(document.nodes);
+    WorldTransformHeader* worldTransformHeader =
+        decodeless::create::object<WorldTransformHeader>(allocator);
+    worldTransformHeader->transforms =
+        decodeless::create::array<glm::mat4>(allocator, worldTransforms.transforms);
+    worldTransformHeader->roots =
+        decodeless::create::array<uint32_t>(allocator, worldTransforms.roots);
+    subHeaders.push_back(worldTransformHeader);
+
+    std::vector<rtr::common::Mesh> emptyMeshes(document.meshes.size());
+    std::vector<std::string_view>  meshNames(document.meshNames.begin(), document.meshNames.end());
+    rtr::common::MeshHeader*       meshHeader =
+        rtr::common::createMeshHeader(allocator, emptyMeshes, meshNames);
+    ArrayDeduplicator       deduplicator(allocator);
+    std::vector<MeshArrays> meshArrays;
+    for (const MeshData& mesh : document.meshes)
+        meshArrays.push_back(deduplicator.write(mesh));
+    stats.duplicateArrays = deduplicator.duplicates();
+    stats.duplicateArrayBytes = deduplicator.duplicateBytes();
+    for (size_t i = 0; i < meshArrays.size(); ++i) {
+#define RTR_ARRAY(type, name)                                                                      \
+    meshHeader->meshes[i].name = std::span<const type>(meshArrays[i].name);
+        RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    }
+    subHeaders.push_back(meshHeader);
+
+    rtr::common::MaterialHeader* materialHeader =
+        decodeless::create::object<rtr::common::MaterialHeader>(allocator);
+    materialHeader->materials =
+        decodeless::create::array<rtr::common::Material>(allocator, document.materials);
+    std::vector<rtr::common::Texture> textures;
+    for (std::span<const uint8_t> file : document.textures) {
+        auto ptr = allocator.resource()->allocate(file.size(), sizeof(std::max_align_t));
+        std::ranges::copy(file, reinterpret_cast<uint8_t*>(ptr));
+        textures.push_back(rtr::common::Texture{.ktx = reinterpret_cast<rtr::ktx::Header*>(ptr)});
+    }
+    materialHeader->textures = decodeless::create::array<rtr::common::Texture>(allocator, textures);
+    subHeaders.push_back(materialHeader);
+
+    if (document.bvh) {
+        std::vector<Aabb> meshBounds;
+        meshBounds.reserve(document.meshes.size());
+        for (const MeshData& mesh : document.meshes)
+            meshBounds.push_back(computeBounds(mesh.vertexPositions));
+        subHeaders.push_back(
+            writeBvhHeader(allocator, meshBounds, document.instances, worldTransforms.transforms));
+    }
+
+    std::ranges::sort(subHeaders, decodeless::RootHeader::HeaderPtrComp());
+    std::ranges::copy(subHeaders, headerTable.begin());
+    header->headers = headerTable;
+    return header;
+}
+
+} // namespace
+
+std::string_view optimizePassName(OptimizePass pass) {
+    for (const auto& [value, name] : PassNames)
+        if (value == pass)
+            return name;
+    return "unknown";
+}
+
+std::optional<OptimizePass> parseOptimizePass(std::string_view name) {
+    for (const auto& [value, passName] : PassNames)
+        if (passName == name)
+            return value;
+    return std::nullopt;
+}
+
+uint64_t documentBytes(const OptimizeDocument& document) {
+    uint64_t result = 0;
+    for (const MeshData& mesh : document.meshes) {
+#define RTR_ARRAY(type, name) result += arrayBytes(mesh.name);
+        RTR_COMMON_MESH_FOREACH_ARRAY
+#undef RTR_ARRAY
+    }
+    for (const std::string& name : document.meshNames)
+        result += name.size();
+    result += arrayBytes(document.materials);
+    for (std::span<const uint8_t> file : document.textures)
+        result += file.size();
+    result += arrayBytes(document.nodes) + arrayBytes(document.scenes) +
+              arrayBytes(document.instances) + arrayBytes(document.cameras) +
+              arrayBytes(document.directionalLights) + arrayBytes(document.pointLights) +
+              arrayBytes(document.spotLights) + arrayBytes(document.meshLights);
+    for (const std::string& name : document.cameraNames)
+        result += name.size();
+    result += arrayBytes(document.instanceGroups);
+    for (std::span<const glm::mat4x3> transforms : document.instanceTransforms)
+        result += transforms.size_bytes();
+    return result;
+}
+
+size_t weldMeshes(OptimizeDocument& document, float epsilon, unsigned jobs) {
+    std::vector<size_t> removed(document.meshes.size());
+    parallelFor(jobs, document.meshes.size(), [&](size_t i) {
+        MeshData& mesh = document.meshes[i];
+        removed[i] = weldVertices(mesh, epsilon);
+        removeDegenerateTriangles(mesh);
+        removed[i] += removeUnusedVertices(mesh);
+    });
+    size_t result = 0;
+    for (size_t count : removed)
+        result += count;
+    return result;
+}
+
+void reorderMeshes(OptimizeDocument& document, unsigned jobs) {
+    parallelFor(jobs, document.meshes.size(), [&](size_t i) {
+        optimizeVertexCache(document.meshes[i]);
+        optimizeVertexFetch(document.meshes[i]);
+    });
+}
+
+size_t deduplicateMeshes(OptimizeDocument& document) {
+    std::vector<uint32_t> first = findDuplicates(
+        document.meshes.size(), [&](uint32_t i) { return hashMesh(document.meshes[i]); },
+        [&](uint32_t a, uint32_t b) { return sameMesh(document.meshes[a], document.meshes[b]); });
+    std::vector<bool> keep(first.size());
+    for (size_t i = 0; i < first.size(); ++i)
+        keep[i] = first[i] == i;
+    std::vector<uint32_t> remap = compact(document.meshes, keep);
+    compact(document.meshNames, keep);
+    for (std::vector<rtr::Instance>* list : {&document.instances, &document.instanceGroups})
+        for (rtr::Instance& instance : *list)
+            instance.mesh = remap[first[instance.mesh]];
+    return remap.size() - document.meshes.size();
+}
+
+size_t deduplicateTextures(OptimizeDocument& document) {
+    std::vector<uint32_t> first = findDuplicates(
+        document.textures.size(), [&](uint32_t i) { return hash64(document.textures[i]); },
+        [&](uint32_t a, uint32_t b) {
+            return sameBytes(document.textures[a], document.textures[b]);
+        });
+    std::vector<bool> keep(first.size());
+    for (size_t i = 0; i < first.size(); ++i)
+        keep[i] = first[i] == i;
+    std::vector<uint32_t> remap = compact(document.textures, keep);
+    for (rtr::common::Material& material : document.materials)
+        forEachTextureSlot(material,
+                           [&](rtr::optional_index32& slot) { slot = remap[first[*slot]]; });
+    return remap.size() - document.textures.size();
+}
+
+size_t pruneUnused(OptimizeDocument& document) {
+    auto count = [&document]() {
+        return document.meshes.size() + document.materials.size() + document.textures.size();
+    };
+    size_t before = count();
+
+    // Mesh lights are copied as they are, so meshes are only pruned without
+    // them
+    std::vector<bool> usedMeshes(document.meshes.size(), !document.meshLights.empty());
+    std::vector<bool> usedMaterials(document.materials.size());
+    for (std::vector<rtr::Instance>* list : {&document.instances, &document.instanceGroups}) {
+        for (const rtr::Instance& instance : *list) {
+            usedMeshes[instance.mesh] = true;
+            usedMaterials[instance.material] = true;
+        }
+    }
+    std::vector<uint32_t> meshRemap = compact(document.meshes, usedMeshes);
+    compact(document.meshNames, usedMeshes);
+    std::vector<uint32_t> materialRemap = compact(document.materials, usedMaterials);
+    for (std::vector<rtr::Instance>* list : {&document.instances, &document.instanceGroups}) {
+        for (rtr::Instance& instance : *list) {
+            instance.mesh = meshRemap[instance.mesh];
+            instance.material = materialRemap[instance.material];
+        }
+    }
+
+    std::vector<bool> usedTextures(document.textures.size());
+    for (rtr::common::Material& material : document.materials)
+        forEachTextureSlot(material,
+                           [&](rtr::optional_index32& slot) { usedTextures[*slot] = true; });
+    std::vector<uint32_t> textureRemap = compact(document.textures, usedTextures);
+    for (rtr::common::Material& material : document.materials)
+        forEachTextureSlot(material,
+                           [&](rtr::optional_index32& slot) { slot = textureRemap[*slot]; });
+    return before - count();
+}
+
+size_t sortByFirstUse(OptimizeDocument& document) {
+    size_t moved = 0;
+    auto   countMoved = [&moved](std::span<const uint32_t> order) {
+        for (uint32_t i = 0; i < order.size(); ++i)
+            moved += order[i] != i ? 1 : 0;
+    };
+    std::vector<uint32_t> uses;
+    if (document.meshLights.empty()) {
+        for (std::vector<rtr::Instance>* list : {&document.instances, &document.instanceGroups})
+            for (const rtr::Instance& instance : *list)
+                uses.push_back(instance.mesh);
+        std::vector<uint32_t> order = firstUseOrder(uses, document.meshes.size());
+        std::vector<uint32_t> remap = reorder(document.meshes, order);
+        if (!document.meshNames.empty())
+            reorder(document.meshNames, order);
+        for (std::vector<rtr::Instance>* list : {&document.instances, &document.instanceGroups})
+            for (rtr::Instance& instance : *list)
+                instance.mesh = remap[instance.mesh];
+        countMoved(order);
+    }
+
+    uses.clear();
+    for (std::vector<rtr::Instance>* list : {&document.instances, &document.instanceGroups})
+        for (const rtr::Instance& instance : *list)
+            uses.push_back(instance.material);
+    std::vector<uint32_t> materialOrder = firstUseOrder(uses, document.materials.size());
+    std::vector<uint32_t> materialRemap = reorder(document.materials, materialOrder);
+    for (std::vector<rtr::Instance>* list : {&document.instances, &document.instanceGroups})
+        for (rtr::Instance& instance : *list)
+            instance.material = materialRemap[instance.material];
+    countMoved(materialOrder);
+
+    uses.clear();
+    for (rtr::common::Material& material : document.materials)
+        forEachTextureSlot(material, [&](rtr::optional_index32& slot) { uses.push_back(*slot); });
+    std::vector<uint32_t> textureOrder = firstUseOrder(uses, document.textures.size());
+    std::vector<uint32_t> textureRemap = reorder(document.textures, textureOrder);
+    for (rtr::common::Material& material : document.materials)
+        forEachTextureSlot(material,
+                           [&](rtr::optional_index32& slot) { slot = textureRemap[*slot]; });
+    countMoved(textureOrder);
+    return moved;
+}
+
+const rtr::RootHeader* optimizeFile(const WriterAllocator& allocator,
+                                    const rtr::RootHeader& input, const OptimizeOptions& options,
+                                    OptimizeStats* stats) {
+    OptimizeStats     localStats;
+    Clock::time_point start = Clock::now();
+    OptimizeDocument  document = loadDocument(input, localStats.droppedHeaders);
+    localStats.loadMilliseconds = millisecondsSince(start);
+
+    for (OptimizePass pass : options.passes) {
+        OptimizePassReport report{.pass = pass, .bytesBefore = documentBytes(document)};
+        start = Clock::now();
+        switch (pass) {
+        case OptimizePass::weld:
+            weldMeshes(document, options.weldEpsilon, options.jobs);
+            break;
+        case OptimizePass::vertexCache:
+            reorderMeshes(document, options.jobs);
+            break;
+        case OptimizePass::dedupeMeshes:
+            deduplicateMeshes(document);
+            break;
+        case OptimizePass::dedupeTextures:
+            deduplicateTextures(document);
+            break;
+        case OptimizePass::prune:
+            pruneUnused(document);
+            break;
+        case OptimizePass::layout:
+            sortByFirstUse(document);
+            break;
+        }
+        report.milliseconds = millisecondsSince(start);
+        report.bytesAfter = documentBytes(document);
+        localStats.passes.push_back(report);
+    }
+
+    start = Clock::now();
+    rtr::RootHeader* header = writeDocument(allocator, document, localStats);
+    localStats.writeMilliseconds = millisecondsSince(start);
+    if (stats)
+        *stats = localStats;
+    return header;
+}
+
+} // namespace rtrtool
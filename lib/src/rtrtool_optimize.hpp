@@ -0,0 +1,75 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <rtr/material.hpp>
+#include <rtr/scene.hpp>
+#include <rtrtool_mesh.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace rtrtool {
+
+// The contents of an rtr file in owned memory, for passes that add and remove
+// elements. Indices between elements match the file, e.g. instances index
+// meshes and materials index textures.
+struct OptimizeDocument {
+    std::vector<MeshData>              meshes;
+    std::vector<std::string>           meshNames;
+    std::vector<rtr::common::Material> materials;
+
+    // Whole KTX files, referencing the input
+    std::vector<std::span<const uint8_t>> textures;
+
+    // Scenes are the indices of their root nodes
+    std::vector<rtr::Node>             nodes;
+    std::vector<uint32_t>              scenes;
+    std::vector<rtr::Instance>         instances;
+    std::vector<rtr::Camera>           cameras;
+    std::vector<std::string>           cameraNames;
+    std::vector<rtr::DirectionalLight> directionalLights;
+    std::vector<rtr::PointLight>       pointLights;
+    std::vector<rtr::SpotLight>        spotLights;
+    std::vector<rtr::MeshLight>        meshLights;
+
+    // Copies of each instanceGroups entry are drawn with the transforms at
+    // the same index, see InstancingHeader. Transforms reference the input.
+    std::vector<rtr::Instance>                instanceGroups;
+    std::vector<std::span<const glm::mat4x3>> instanceTransforms;
+
+    // Writes a BvhHeader, rebuilt from the meshes and scene since passes move
+    // and remove both
+    bool bvh = false;
+};
+
+// Bytes of all arrays in the document, ignoring any sharing when written
+uint64_t documentBytes(const OptimizeDocument& document);
+
+// Welds every mesh, see weldVertices(). Returns the number of vertices
+// removed.
+size_t weldMeshes(OptimizeDocument& document, float epsilon, unsigned jobs);
+
+// Reorders every mesh for the vertex cache and vertex fetch
+void reorderMeshes(OptimizeDocument& document, unsigned jobs);
+
+// Removes meshes and textures identical to an earlier one and points
+// instances, instance groups and materials at the remaining copy. Returns the
+// number removed.
+size_t deduplicateMeshes(OptimizeDocument& document);
+size_t deduplicateTextures(OptimizeDocument& document);
+
+// Removes meshes and materials no instance or instance group uses, then
+// textures no material uses. Meshes are all kept if there are mesh lights.
+// Returns the total number removed.
+size_t pruneUnused(OptimizeDocument& document);
+
+// Reorders meshes and materials by first use from instances and then instance
+// groups, and textures by first use from the reordered materials, see
+// firstUseOrder(). Meshes are not moved if there are mesh lights. Returns the
+// number of items that moved.
+size_t sortByFirstUse(OptimizeDocument& document);
+
+} // namespace rtrtool
@@ -0,0 +1,62 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rtrtool {
+
+// Resolves a user requested thread count, where zero means one per hardware
+// thread.
+inline unsigned jobCount(unsigned requested) {
+    if (requested)
+        return requested;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls fn(i) for every i in [0, count) on up to 'jobs' threads, including the
+// calling thread. Indices are handed out one at a time so items of very
+// different cost, e.g. textures, balance well. The first exception thrown is
+// rethrown on the calling thread once all workers have stopped.
+template <class Fn>
+void parallelFor(unsigned jobs, size_t count, Fn&& fn) {
+    jobs = unsigned(std::min<size_t>(jobCount(jobs), count));
+    if (jobs <= 1) {
+        for (size_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::exception_ptr  error;
+    std::mutex          errorMutex;
+    auto                worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+                next = count; // stop handing out work
+            }
+        }
+    };
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(jobs - 1);
+        for (unsigned i = 1; i < jobs; ++i)
+            threads.emplace_back(worker);
+        worker();
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+} // namespace rtrtool
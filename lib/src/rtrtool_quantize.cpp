@@ -0,0 +1,152 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+#include <limits>
+#include <numbers>
+#include <rtrtool_quantize.hpp>
+#include <stdexcept>
+
+namespace rtrtool {
+
+namespace {
+
+void checkSizes(size_t inputSize, size_t resultSize) {
+    if (inputSize != resultSize)
+        throw std::runtime_error("Quantized array size does not match its source");
+}
+
+float signNotZero(float v) { return v < 0.0f ? -1.0f : 1.0f; }
+
+// atan2() in double precision, as float acos() is too coarse near zero to
+// measure 16-bit errors
+float angleDegrees(glm::vec3 a, glm::vec3 b) {
+    glm::dvec3 da = glm::normalize(glm::dvec3(a));
+    glm::dvec3 db = glm::normalize(glm::dvec3(b));
+    double     sine = glm::length(glm::cross(da, db));
+    return float(std::atan2(sine, glm::dot(da, db)) * (180.0 / std::numbers::pi));
+}
+
+// Encodes to signed normalized integers. Plain rounding of each component is
+// not the closest direction after decoding, so the four neighbouring values
+// are compared, which matters most for 8-bit.
+template <class T>
+glm::vec<2, T> octEncodeSnorm(glm::vec3 v) {
+    constexpr float maxValue = float(std::numeric_limits<T>::max());
+    glm::vec2       e = octEncode(v) * maxValue;
+    glm::vec2       base(std::floor(e.x), std::floor(e.y));
+    glm::vec3       direction = octDecode(octEncode(v));
+    glm::vec<2, T>  best{};
+    float           bestDot = -2.0f;
+    for (int y = 0; y < 2; ++y) {
+        for (int x = 0; x < 2; ++x) {
+            glm::vec2 candidate =
+                glm::clamp(base + glm::vec2(float(x), float(y)), -maxValue, maxValue);
+            float d = glm::dot(octDecode(candidate / maxValue), direction);
+            if (d > bestDot) {
+                bestDot = d;
+                best = glm::vec<2, T>(candidate);
+            }
+        }
+    }
+    return best;
+}
+
+template <class T>
+glm::vec3 octDecodeSnorm(glm::vec<2, T> q) {
+    constexpr float maxValue = float(std::numeric_limits<T>::max());
+    return octDecode(glm::max(glm::vec2(q) / maxValue, glm::vec2(-1.0f)));
+}
+
+} // namespace
+
+glm::vec2 octEncode(glm::vec3 v) {
+    float sum = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (sum == 0.0f)
+        return glm::vec2(0.0f);
+    v /= sum;
+    glm::vec2 e(v.x, v.y);
+    if (v.z < 0.0f)
+        e = glm::vec2((1.0f - std::abs(v.y)) * signNotZero(v.x),
+                      (1.0f - std::abs(v.x)) * signNotZero(v.y));
+    return e;
+}
+
+glm::vec3 octDecode(glm::vec2 e) {
+    glm::vec3 v(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (v.z < 0.0f) {
+        float x = v.x;
+        v.x = (1.0f - std::abs(v.y)) * signNotZero(x);
+        v.y = (1.0f - std::abs(x)) * signNotZero(v.y);
+    }
+    return glm::normalize(v);
+}
+
+float quantizePositions(std::span<const glm::vec3> positions, std::span<glm::u16vec4> result,
+                        glm::vec3& offset, glm::vec3& scale) {
+    checkSizes(positions.size(), result.size());
+    offset = glm::vec3(0.0f);
+    scale = glm::vec3(0.0f);
+    if (positions.empty())
+        return 0.0f;
+    glm::vec3 lo = positions[0];
+    glm::vec3 hi = positions[0];
+    for (const glm::vec3& p : positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    offset = lo;
+    scale = hi - lo;
+    float maxError = 0.0f;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        glm::u16vec4 q(0);
+        for (glm::length_t c = 0; c < 3; ++c) {
+            float unorm = scale[c] > 0.0f ? (positions[i][c] - offset[c]) / scale[c] : 0.0f;
+            q[c] = uint16_t(std::clamp(std::round(unorm * 65535.0f), 0.0f, 65535.0f));
+            float decoded = offset[c] + scale[c] * (float(q[c]) / 65535.0f);
+            maxError = std::max(maxError, std::abs(decoded - positions[i][c]));
+        }
+        result[i] = q;
+    }
+    return maxError;
+}
+
+float quantizeNormals(std::span<const glm::vec3> normals, std::span<glm::i16vec2> result) {
+    checkSizes(normals.size(), result.size());
+    float maxError = 0.0f;
+    for (size_t i = 0; i < normals.size(); ++i) {
+        result[i] = octEncodeSnorm<int16_t>(normals[i]);
+        if (glm::dot(normals[i], normals[i]) > 0.0f)
+            maxError = std::max(maxError, angleDegrees(octDecodeSnorm(result[i]), normals[i]));
+    }
+    return maxError;
+}
+
+float quantizeTangents(std::span<const glm::vec4> tangents, std::span<glm::i8vec4> result) {
+    checkSizes(tangents.size(), result.size());
+    float maxError = 0.0f;
+    for (size_t i = 0; i < tangents.size(); ++i) {
+        glm::vec3   direction(tangents[i]);
+        glm::i8vec2 e = octEncodeSnorm<int8_t>(direction);
+        result[i] = glm::i8vec4(e.x, e.y, tangents[i].w < 0.0f ? -127 : 127, 0);
+        if (glm::dot(direction, direction) > 0.0f)
+            maxError = std::max(maxError, angleDegrees(octDecodeSnorm(e), direction));
+    }
+    return maxError;
+}
+
+float quantizeTexCoords(std::span<const glm::vec2> texCoords, std::span<glm::u16vec2> result) {
+    checkSizes(texCoords.size(), result.size());
+    float maxError = 0.0f;
+    for (size_t i = 0; i < texCoords.size(); ++i) {
+        for (glm::length_t c = 0; c < 2; ++c) {
+            result[i][c] = glm::packHalf1x16(texCoords[i][c]);
+            maxError = std::max(maxError,
+                                std::abs(glm::unpackHalf1x16(result[i][c]) - texCoords[i][c]));
+        }
+    }
+    return maxError;
+}
+
+} // namespace rtrtool
@@ -0,0 +1,31 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <span>
+
+namespace rtrtool {
+
+// Octahedral mapping between unit vectors and [-1, 1]^2. Zero vectors encode
+// as +Z.
+glm::vec2 octEncode(glm::vec3 v);
+glm::vec3 octDecode(glm::vec2 e);
+
+// Quantizes positions to unorm16 within their bounds, writing the bounds'
+// minimum to 'offset' and extent to 'scale'. Returns the largest absolute
+// error of any component.
+float quantizePositions(std::span<const glm::vec3> positions, std::span<glm::u16vec4> result,
+                        glm::vec3& offset, glm::vec3& scale);
+
+// Octahedral snorm16 unit vectors. Returns the largest angle error in degrees.
+float quantizeNormals(std::span<const glm::vec3> normals, std::span<glm::i16vec2> result);
+
+// Octahedral snorm8 tangent directions with the handedness, w, in z. Returns
+// the largest direction angle error in degrees.
+float quantizeTangents(std::span<const glm::vec4> tangents, std::span<glm::i8vec4> result);
+
+// Half float texture coordinates. Returns the largest absolute error.
+float quantizeTexCoords(std::span<const glm::vec2> texCoords, std::span<glm::u16vec2> result);
+
+} // namespace rtrtool
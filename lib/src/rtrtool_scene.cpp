@@ -0,0 +1,46 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <rtrtool_scene.hpp>
+#include <stdexcept>
+
+namespace rtrtool {
+
+WorldTransforms flattenHierarchy(std::span<const rtr::Node> nodes) {
+    WorldTransforms result;
+    result.transforms.reserve(nodes.size());
+    result.roots.reserve(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        const rtr::Node& node = nodes[i];
+        if (!node.parentOffset) {
+            result.transforms.push_back(node.transform);
+            result.roots.push_back(i);
+            continue;
+        }
+        if (*node.parentOffset == 0 || *node.parentOffset > i)
+            throw std::runtime_error("Node parent is not before it");
+        uint32_t parent = i - *node.parentOffset;
+        result.transforms.push_back(result.transforms[parent] * node.transform);
+        result.roots.push_back(result.roots[parent]);
+    }
+    return result;
+}
+
+std::vector<uint32_t> firstUseOrder(std::span<const uint32_t> uses, size_t count) {
+    std::vector<uint32_t> result;
+    std::vector<bool>     placed(count);
+    result.reserve(count);
+    for (uint32_t item : uses) {
+        if (item >= count)
+            throw std::runtime_error("Item use is out of range");
+        if (!placed[item]) {
+            placed[item] = true;
+            result.push_back(item);
+        }
+    }
+    for (uint32_t item = 0; item < count; ++item)
+        if (!placed[item])
+            result.push_back(item);
+    return result;
+}
+
+} // namespace rtrtool
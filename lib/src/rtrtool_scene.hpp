@@ -0,0 +1,27 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <rtr/scene.hpp>
+#include <span>
+#include <vector>
+
+namespace rtrtool {
+
+// Owned arrays, matching WorldTransformHeader
+struct WorldTransforms {
+    std::vector<glm::mat4> transforms;
+    std::vector<uint32_t>  roots;
+};
+
+// Accumulates world transforms in one pass over nodes written parents first,
+// as the converter does
+WorldTransforms flattenHierarchy(std::span<const rtr::Node> nodes);
+
+// Orders 'count' items by their first appearance in 'uses', then the unused
+// ones by index, so data can be laid out in the order it is first read.
+// Returns the old index of each item in its new position.
+std::vector<uint32_t> firstUseOrder(std::span<const uint32_t> uses, size_t count);
+
+} // namespace rtrtool
@@ -0,0 +1,362 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <rtrtool_mesh.hpp>
+#include <set>
+#include <rtrtool_simplify.hpp>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace rtrtool {
+
+namespace {
+
+// Perpendicular planes along open borders keep them in place. Weighted so a
+// border vertex moving inwards costs more than one moving over a flat surface.
+constexpr double BorderWeight = 10.0;
+
+// Symmetric 4x4 matrix of the summed squared distance to a set of planes
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+
+    void addPlane(glm::dvec3 n, double d, double weight) {
+        a00 += weight * n.x * n.x;
+        a01 += weight * n.x * n.y;
+        a02 += weight * n.x * n.z;
+        a11 += weight * n.y * n.y;
+        a12 += weight * n.y * n.z;
+        a22 += weight * n.z * n.z;
+        b0 += weight * n.x * d;
+        b1 += weight * n.y * d;
+        b2 += weight * n.z * d;
+        c += weight * d * d;
+    }
+    Quadric& operator+=(const Quadric& o) {
+        a00 += o.a00, a01 += o.a01, a02 += o.a02, a11 += o.a11, a12 += o.a12, a22 += o.a22;
+        b0 += o.b0, b1 += o.b1, b2 += o.b2;
+        c += o.c;
+        return *this;
+    }
+    friend Quadric operator+(Quadric a, const Quadric& b) { return a += b; }
+    double         evaluate(glm::dvec3 p) const {
+        double result = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+                        2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+                        2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return std::max(result, 0.0);
+    }
+};
+
+enum class VertexKind : uint8_t {
+    interior,
+    border,
+    locked,
+    removed,
+};
+
+// Queued in a std::set, as _GLIBCXX_DEBUG validates the whole heap of a
+// std::priority_queue on every operation
+struct Collapse {
+    double   cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+
+    // Cheapest first, ties broken by vertex for determinism
+    bool operator<(const Collapse& other) const {
+        return std::tie(cost, from, to, fromVersion, toVersion) <
+               std::tie(other.cost, other.from, other.to, other.fromVersion, other.toVersion);
+    }
+};
+
+class Simplifier {
+public:
+    Simplifier(std::span<const glm::uvec3> triangles, std::span<const glm::vec3> positions,
+               std::span<const glm::vec3> normals, std::span<const glm::vec2> texCoords,
+               const LodWeights& weights)
+        : m_positions(positions),
+          m_normals(normals),
+          m_texCoords(texCoords),
+          m_weights(weights),
+          m_triangles(triangles.begin(), triangles.end()),
+          m_triangleAlive(triangles.size(), true),
+          m_aliveTriangles(triangles.size()),
+          m_vertexTriangles(positions.size()),
+          m_kinds(positions.size(), VertexKind::interior),
+          m_quadrics(positions.size()),
+          m_versions(positions.size(), 0) {
+        for (uint32_t t = 0; t < m_triangles.size(); ++t)
+            for (glm::length_t c = 0; c < 3; ++c)
+                m_vertexTriangles[m_triangles[t][c]].push_back(t);
+        classifyVertices();
+        buildQuadrics();
+        for (const glm::uvec3& triangle : m_triangles)
+            for (glm::length_t c = 0; c < 3; ++c) {
+                push(triangle[c], triangle[(c + 1) % 3]);
+                push(triangle[(c + 1) % 3], triangle[c]);
+            }
+    }
+
+    // Collapses edges until at most targetTriangles remain or no valid
+    // collapse is left. Returns false in the latter case.
+    bool simplify(size_t targetTriangles) {
+        while (m_aliveTriangles > targetTriangles) {
+            if (m_queue.empty())
+                return false;
+            Collapse collapse = *m_queue.begin();
+            m_queue.erase(m_queue.begin());
+
+            // Collapses re-queue every edge of the vertex they keep, so stale
+            // entries can be dropped
+            if (m_kinds[collapse.from] == VertexKind::removed ||
+                m_kinds[collapse.to] == VertexKind::removed ||
+                collapse.fromVersion != m_versions[collapse.from] ||
+                collapse.toVersion != m_versions[collapse.to] ||
+                !valid(collapse.from, collapse.to))
+                continue;
+            apply(collapse.from, collapse.to);
+        }
+        return true;
+    }
+
+    size_t aliveTriangles() const { return m_aliveTriangles; }
+    float  error() const { return float(std::sqrt(m_maxError)); }
+
+    std::vector<glm::uvec3> triangles() const {
+        std::vector<glm::uvec3> result;
+        result.reserve(m_aliveTriangles);
+        for (size_t t = 0; t < m_triangles.size(); ++t)
+            if (m_triangleAlive[t])
+                result.push_back(m_triangles[t]);
+        return result;
+    }
+
+private:
+    void classifyVertices() {
+        // Vertices sharing a position with another are on an attribute seam
+        std::vector<uint32_t> order(m_positions.size());
+        std::iota(order.begin(), order.end(), 0u);
+        auto key = [this](uint32_t v) {
+            return std::tie(m_positions[v].x, m_positions[v].y, m_positions[v].z);
+        };
+        std::ranges::sort(order, [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+        for (size_t i = 1; i < order.size(); ++i)
+            if (key(order[i]) == key(order[i - 1]))
+                m_kinds[order[i]] = m_kinds[order[i - 1]] = VertexKind::locked;
+
+        // Edges used by one triangle are open borders. More than two is
+        // non-manifold.
+        std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+        for (const glm::uvec3& triangle : m_triangles)
+            for (glm::length_t c = 0; c < 3; ++c)
+                edgeTriangles[edgeKey(triangle[c], triangle[(c + 1) % 3])]++;
+        for (const auto& [edge, count] : edgeTriangles) {
+            uint32_t a = uint32_t(edge >> 32);
+            uint32_t b = uint32_t(edge);
+            for (uint32_t vertex : {a, b}) {
+                if (count > 2)
+                    m_kinds[vertex] = VertexKind::locked;
+                else if (count == 1 && m_kinds[vertex] == VertexKind::interior)
+                    m_kinds[vertex] = VertexKind::border;
+            }
+        }
+    }
+
+    void buildQuadrics() {
+        for (const glm::uvec3& triangle : m_triangles) {
+            glm::dvec3 a(m_positions[triangle.x]);
+            glm::dvec3 b(m_positions[triangle.y]);
+            glm::dvec3 c(m_positions[triangle.z]);
+            glm::dvec3 normal = glm::cross(b - a, c - a);
+            double     length = glm::length(normal);
+            if (length == 0.0)
+                continue;
+            normal /= length;
+            for (glm::length_t i = 0; i < 3; ++i)
+                m_quadrics[triangle[i]].addPlane(normal, -glm::dot(normal, a), 1.0);
+
+            // Border edges, i.e. without a triangle on the other side
+            for (glm::length_t i = 0; i < 3; ++i) {
+                uint32_t from = triangle[i];
+                uint32_t to = triangle[(i + 1) % 3];
+                if (m_kinds[from] == VertexKind::interior || m_kinds[to] == VertexKind::interior ||
+                    sharedTriangles(from, to) != 1)
+                    continue;
+                glm::dvec3 p(m_positions[from]);
+                glm::dvec3 edge = glm::dvec3(m_positions[to]) - p;
+                glm::dvec3 perpendicular = glm::cross(edge, normal);
+                double     perpendicularLength = glm::length(perpendicular);
+                if (perpendicularLength == 0.0)
+                    continue;
+                perpendicular /= perpendicularLength;
+                double d = -glm::dot(perpendicular, p);
+                m_quadrics[from].addPlane(perpendicular, d, BorderWeight);
+                m_quadrics[to].addPlane(perpendicular, d, BorderWeight);
+            }
+        }
+    }
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b) {
+        return (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+    }
+
+    size_t sharedTriangles(uint32_t a, uint32_t b) const {
+        size_t result = 0;
+        for (uint32_t t : m_vertexTriangles[a])
+            if (m_triangleAlive[t] && (m_triangles[t].x == b || m_triangles[t].y == b ||
+                                       m_triangles[t].z == b))
+                ++result;
+        return result;
+    }
+
+    // Squared position error plus attribute differences scaled by the squared
+    // edge length, so they are in the same units
+    double cost(uint32_t from, uint32_t to) const {
+        glm::dvec3 target(m_positions[to]);
+        double     result = (m_quadrics[from] + m_quadrics[to]).evaluate(target);
+        double     edgeLength2 = glm::dot(target - glm::dvec3(m_positions[from]),
+                                          target - glm::dvec3(m_positions[from]));
+        double     attributes = 0.0;
+        if (!m_normals.empty())
+            attributes += m_weights.normal * (1.0 - glm::dot(m_normals[from], m_normals[to]));
+        if (!m_texCoords.empty()) {
+            glm::vec2 delta = m_texCoords[from] - m_texCoords[to];
+            attributes += m_weights.texCoord * glm::dot(delta, delta);
+        }
+        return result + edgeLength2 * attributes;
+    }
+
+    void push(uint32_t from, uint32_t to) {
+        if (m_kinds[from] == VertexKind::locked || from == to)
+            return;
+        m_queue.insert(Collapse{cost(from, to), from, to, m_versions[from], m_versions[to]});
+    }
+
+    std::vector<uint32_t> neighbours(uint32_t vertex) const {
+        std::vector<uint32_t> result;
+        for (uint32_t t : m_vertexTriangles[vertex])
+            if (m_triangleAlive[t])
+                for (glm::length_t c = 0; c < 3; ++c)
+                    if (m_triangles[t][c] != vertex)
+                        result.push_back(m_triangles[t][c]);
+        std::ranges::sort(result);
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    bool valid(uint32_t from, uint32_t to) const {
+        // Borders only collapse along themselves. The edge must still exist.
+        size_t shared = sharedTriangles(from, to);
+        if (shared == 0 || (m_kinds[from] == VertexKind::border && shared != 1))
+            return false;
+
+        // Link condition: the vertices may only share the neighbours opposite
+        // the collapsed edge, otherwise the result is non-manifold
+        std::vector<uint32_t> fromNeighbours = neighbours(from);
+        std::vector<uint32_t> toNeighbours = neighbours(to);
+        std::vector<uint32_t> common;
+        std::ranges::set_intersection(fromNeighbours, toNeighbours, std::back_inserter(common));
+        if (common.size() != shared)
+            return false;
+
+        // Triangles that remain must not flip over
+        glm::dvec3 target(m_positions[to]);
+        for (uint32_t t : m_vertexTriangles[from]) {
+            if (!m_triangleAlive[t])
+                continue;
+            const glm::uvec3& triangle = m_triangles[t];
+            if (triangle.x == to || triangle.y == to || triangle.z == to)
+                continue;
+            std::array<glm::dvec3, 3> before, after;
+            for (glm::length_t c = 0; c < 3; ++c) {
+                before[c] = glm::dvec3(m_positions[triangle[c]]);
+                after[c] = triangle[c] == from ? target : before[c];
+            }
+            glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normalBefore, normalAfter) <= 0.0)
+                return false;
+        }
+        return true;
+    }
+
+    void apply(uint32_t from, uint32_t to) {
+        Quadric merged = m_quadrics[from] + m_quadrics[to];
+        m_maxError = std::max(m_maxError, merged.evaluate(glm::dvec3(m_positions[to])));
+        m_quadrics[to] = merged;
+        for (uint32_t t : m_vertexTriangles[from]) {
+            if (!m_triangleAlive[t])
+                continue;
+            glm::uvec3& triangle = m_triangles[t];
+            if (triangle.x == to || triangle.y == to || triangle.z == to) {
+                m_triangleAlive[t] = false;
+                --m_aliveTriangles;
+                continue;
+            }
+            for (glm::length_t c = 0; c < 3; ++c)
+                if (triangle[c] == from)
+                    triangle[c] = to;
+            m_vertexTriangles[to].push_back(t);
+        }
+        m_vertexTriangles[from].clear();
+        m_kinds[from] = VertexKind::removed;
+        std::erase_if(m_vertexTriangles[to], [this](uint32_t t) { return !m_triangleAlive[t]; });
+        ++m_versions[to];
+        for (uint32_t neighbour : neighbours(to)) {
+            push(to, neighbour);
+            push(neighbour, to);
+        }
+    }
+
+    std::span<const glm::vec3>         m_positions;
+    std::span<const glm::vec3>         m_normals;
+    std::span<const glm::vec2>         m_texCoords;
+    LodWeights                         m_weights;
+    std::vector<glm::uvec3>            m_triangles;
+    std::vector<bool>                  m_triangleAlive;
+    size_t                             m_aliveTriangles = 0;
+    std::vector<std::vector<uint32_t>> m_vertexTriangles;
+    std::vector<VertexKind>            m_kinds;
+    std::vector<Quadric>               m_quadrics;
+    std::vector<uint32_t>              m_versions;
+    std::set<Collapse>                 m_queue;
+    double                             m_maxError = 0.0;
+};
+
+} // namespace
+
+std::vector<LodLevel> buildLodChain(std::span<const glm::uvec3> triangles,
+                                    std::span<const glm::vec3> positions,
+                                    std::span<const glm::vec3> normals,
+                                    std::span<const glm::vec2> texCoords, const LodWeights& weights,
+                                    size_t maxLevels, size_t minTriangles) {
+    checkIndices(triangles, positions.size());
+    if ((!normals.empty() && normals.size() != positions.size()) ||
+        (!texCoords.empty() && texCoords.size() != positions.size()))
+        throw std::runtime_error("Vertex attribute count does not match positions");
+
+    std::vector<LodLevel> result;
+    Simplifier            simplifier(triangles, positions, normals, texCoords, weights);
+    size_t                previous = triangles.size();
+    while (result.size() < maxLevels && previous / 2 >= minTriangles) {
+        bool reachedTarget = simplifier.simplify(previous / 2);
+
+        // Keep a partial level only if it saved a meaningful amount
+        if (!reachedTarget && simplifier.aliveTriangles() > previous * 3 / 4)
+            break;
+        result.push_back(LodLevel{simplifier.triangles(), simplifier.error()});
+        previous = simplifier.aliveTriangles();
+        if (!reachedTarget)
+            break;
+    }
+    return result;
+}
+
+} // namespace rtrtool
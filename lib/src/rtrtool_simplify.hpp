@@ -0,0 +1,41 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace rtrtool {
+
+// Weights of attribute differences in the collapse cost, relative to the
+// squared geometric error
+struct LodWeights {
+    float normal = 1.0f;
+    float texCoord = 1.0f;
+};
+
+struct LodLevel {
+    std::vector<glm::uvec3> triangles;
+
+    // Upper bound on the distance from any removed vertex to the planes of the
+    // original triangles around it, in position units
+    float error = 0.0f;
+};
+
+// Progressively simplifies a mesh with edge collapses ordered by quadric error
+// plus weighted normal and texture coordinate differences, recording a level
+// each time the triangle count halves. Vertices are only collapsed onto other
+// vertices, so levels index the original vertex arrays. Open borders only
+// collapse along themselves. Vertices on attribute seams, i.e. sharing a
+// position with another vertex, and non-manifold vertices never move, so
+// levels have no cracks but meshes with many seams simplify less. Stops after
+// maxLevels, before a level would have fewer than minTriangles, or when no
+// valid collapses remain. Normals and texCoords may be empty.
+std::vector<LodLevel> buildLodChain(std::span<const glm::uvec3> triangles,
+                                    std::span<const glm::vec3> positions,
+                                    std::span<const glm::vec3> normals,
+                                    std::span<const glm::vec2> texCoords, const LodWeights& weights,
+                                    size_t maxLevels, size_t minTriangles);
+
+} // namespace rtrtool
@@ -0,0 +1,98 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+#include <mikktspace.h>
+#include <rtrtool_kernels.hpp>
+#include <rtrtool_mesh.hpp>
+#include <rtrtool_tangent_space.hpp>
+#include <stdexcept>
+
+namespace rtrtool {
+
+namespace {
+
+struct TangentContext {
+    std::span<const glm::uvec3> triangles;
+    std::span<const glm::vec3>  positions;
+    std::span<const glm::vec3>  normals;
+    std::span<const glm::vec2>  texCoords;
+    std::span<glm::vec4>        tangents;
+};
+
+inline TangentContext& udatTangents(const SMikkTSpaceContext* pContext) {
+    return *reinterpret_cast<TangentContext*>(pContext->m_pUserData);
+}
+
+inline uint32_t udatVertex(const SMikkTSpaceContext* pContext, int iFace, int iVert) {
+    return udatTangents(pContext).triangles[size_t(iFace)][iVert];
+}
+
+} // namespace
+
+void generateNormals(std::span<const glm::uvec3> triangles, std::span<const glm::vec3> positions,
+                     std::span<glm::vec3> normals) {
+    if (normals.size() != positions.size())
+        throw std::runtime_error("Normal count does not match the position count");
+    checkIndices(triangles, positions.size());
+    std::ranges::fill(normals, glm::vec3(0.0f));
+    accumulateFaceNormals(reinterpret_cast<const float*>(positions.data()), positions.size(),
+                          reinterpret_cast<const uint32_t*>(triangles.data()), triangles.size(),
+                          reinterpret_cast<float*>(normals.data()));
+    for (glm::vec3& normal : normals) {
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+}
+
+void generateTangents(std::span<const glm::uvec3> triangles, std::span<const glm::vec3> positions,
+                      std::span<const glm::vec3> normals, std::span<const glm::vec2> texCoords,
+                      std::span<glm::vec4> tangents) {
+    if (normals.size() != positions.size() || texCoords.size() != positions.size() ||
+        tangents.size() != positions.size())
+        throw std::runtime_error("Tangent space inputs have different vertex counts");
+    checkIndices(triangles, positions.size());
+    std::ranges::fill(tangents, glm::vec4(0.0f));
+    SMikkTSpaceInterface interface{
+        .m_getNumFaces =
+            [](const SMikkTSpaceContext* pContext) {
+                return int(udatTangents(pContext).triangles.size());
+            },
+        .m_getNumVerticesOfFace = []([[maybe_unused]] const SMikkTSpaceContext* pContext,
+                                     [[maybe_unused]] const int iFace) -> int { return 3; },
+        .m_getPosition =
+            [](const SMikkTSpaceContext* pContext, float fvPosOut[], const int iFace,
+               const int iVert) {
+                *reinterpret_cast<glm::vec3*>(fvPosOut) =
+                    udatTangents(pContext).positions[udatVertex(pContext, iFace, iVert)];
+            },
+        .m_getNormal =
+            [](const SMikkTSpaceContext* pContext, float fvNormOut[], const int iFace,
+               const int iVert) {
+                *reinterpret_cast<glm::vec3*>(fvNormOut) =
+                    udatTangents(pContext).normals[udatVertex(pContext, iFace, iVert)];
+            },
+        .m_getTexCoord =
+            [](const SMikkTSpaceContext* pContext, float fvTexcOut[], const int iFace,
+               const int iVert) {
+                *reinterpret_cast<glm::vec2*>(fvTexcOut) =
+                    udatTangents(pContext).texCoords[udatVertex(pContext, iFace, iVert)];
+            },
+        .m_setTSpaceBasic =
+            [](const SMikkTSpaceContext* pContext, const float fvTangent[], const float fSign,
+               const int iFace, const int iVert) {
+                udatTangents(pContext).tangents[udatVertex(pContext, iFace, iVert)] =
+                    glm::vec4{glm::make_vec3(fvTangent), fSign};
+            },
+        .m_setTSpace = nullptr,
+    };
+    TangentContext     userData{triangles, positions, normals, texCoords, tangents};
+    SMikkTSpaceContext context{
+        .m_pInterface = &interface,
+        .m_pUserData = &userData,
+    };
+    if (!genTangSpaceDefault(&context))
+        throw std::runtime_error("Failed MikkTSpace generation");
+}
+
+} // namespace rtrtool
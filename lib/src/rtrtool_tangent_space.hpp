@@ -0,0 +1,21 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <span>
+
+namespace rtrtool {
+
+// Smooth vertex normals: the normalized sum of the area weighted normals of
+// each vertex's triangles. Vertices without any area get +Z.
+void generateNormals(std::span<const glm::uvec3> triangles, std::span<const glm::vec3> positions,
+                     std::span<glm::vec3> normals);
+
+// MikkTSpace tangents, which glTF specifies for meshes without them. The
+// handedness is in w.
+void generateTangents(std::span<const glm::uvec3> triangles, std::span<const glm::vec3> positions,
+                      std::span<const glm::vec3> normals, std::span<const glm::vec2> texCoords,
+                      std::span<glm::vec4> tangents);
+
+} // namespace rtrtool
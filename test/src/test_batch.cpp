@@ -0,0 +1,66 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <gtest/gtest.h>
+#include <rtrtool_batch.hpp>
+
+using namespace rtrtool;
+
+namespace {
+
+// One triangle in the XY plane, facing +Z
+MeshData triangle() {
+    MeshData result;
+    result.triangleVertices = {{0, 1, 2}};
+    result.vertexPositions = {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+    result.vertexNormals.assign(3, glm::vec3(0.0f, 0.0f, 1.0f));
+    result.vertexTexCoords0 = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}};
+    result.vertexTangents.assign(3, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+    return result;
+}
+
+glm::vec3 faceNormal(const MeshData& mesh, size_t index) {
+    glm::uvec3 t = mesh.triangleVertices[index];
+    return glm::normalize(glm::cross(mesh.vertexPositions[t.y] - mesh.vertexPositions[t.x],
+                                     mesh.vertexPositions[t.z] - mesh.vertexPositions[t.x]));
+}
+
+} // namespace
+
+TEST(Batch, AppendTransformed) {
+    MeshData  merged;
+    glm::mat4 translate = glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, 0.0f));
+    glm::mat4 rotate = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1, 0, 0));
+    appendTransformed(merged, triangle(), translate);
+    appendTransformed(merged, triangle(), rotate);
+    ASSERT_EQ(merged.triangleVertices.size(), 2u);
+    ASSERT_EQ(merged.vertexPositions.size(), 6u);
+    EXPECT_EQ(merged.triangleVertices[1], glm::uvec3(3, 4, 5));
+    EXPECT_EQ(merged.vertexPositions[1], glm::vec3(11.0f, 0.0f, 0.0f));
+    EXPECT_EQ(merged.vertexTexCoords0[4], glm::vec2(1.0f, 0.0f));
+
+    // The rotated copy faces -Y and its shading normals agree
+    EXPECT_NEAR(glm::distance(faceNormal(merged, 1), glm::vec3(0.0f, -1.0f, 0.0f)), 0.0f, 1e-6f);
+    EXPECT_NEAR(glm::distance(merged.vertexNormals[3], glm::vec3(0.0f, -1.0f, 0.0f)), 0.0f,
+                1e-6f);
+}
+
+TEST(Batch, Mirrored) {
+    MeshData merged;
+    appendTransformed(merged, triangle(),
+                      glm::scale(glm::mat4(1.0f), glm::vec3(-1.0f, 2.0f, 1.0f)));
+
+    // Winding is flipped so the face still agrees with the normal, and the
+    // handedness flips with it
+    EXPECT_NEAR(glm::distance(faceNormal(merged, 0), merged.vertexNormals[0]), 0.0f, 1e-6f);
+    EXPECT_EQ(merged.vertexTangents[0], glm::vec4(-1.0f, 0.0f, 0.0f, -1.0f));
+}
+
+TEST(Batch, DifferentArrays) {
+    MeshData merged;
+    appendTransformed(merged, triangle(), glm::mat4(1.0f));
+    MeshData noTexCoords = triangle();
+    noTexCoords.vertexTexCoords0.clear();
+    noTexCoords.vertexTangents.clear();
+    EXPECT_THROW(appendTransformed(merged, noTexCoords, glm::mat4(1.0f)), std::runtime_error);
+}
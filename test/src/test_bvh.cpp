@@ -0,0 +1,163 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <rtrtool_bvh.hpp>
+
+using namespace rtrtool;
+
+namespace {
+
+std::vector<Aabb> randomBoxes(size_t count) {
+    std::mt19937                          rng(42);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.0f, 5.0f);
+    std::vector<Aabb>                     result;
+    for (size_t i = 0; i < count; ++i) {
+        Aabb box;
+        box.extend(glm::vec3(position(rng), position(rng), position(rng)));
+        box.extend(box.min + glm::vec3(size(rng), size(rng), size(rng)));
+        result.push_back(box);
+    }
+    return result;
+}
+
+// A header referencing owned arrays, as it would be mapped from a file
+struct TestBvh {
+    TestBvh(std::vector<Aabb> boxes, uint32_t maxLeafSize)
+        : bounds(std::move(boxes)), data(buildBvh(bounds, maxLeafSize)) {
+        header.instanceBounds = std::span<const Aabb>(bounds);
+        header.nodes = std::span<const BvhNode>(data.nodes);
+        header.instances = std::span<const uint32_t>(data.items);
+    }
+    std::vector<Aabb> bounds;
+    BvhData           data;
+    BvhHeader         header;
+};
+
+template <class Query>
+std::vector<uint32_t> collect(Query&& query) {
+    std::vector<uint32_t> result;
+    query([&result](uint32_t instance, auto...) { result.push_back(instance); });
+    std::ranges::sort(result);
+    return result;
+}
+
+template <class Predicate>
+std::vector<uint32_t> bruteForce(const std::vector<Aabb>& boxes, Predicate&& predicate) {
+    std::vector<uint32_t> result;
+    for (uint32_t i = 0; i < boxes.size(); ++i)
+        if (predicate(boxes[i]))
+            result.push_back(i);
+    return result;
+}
+
+} // namespace
+
+TEST(Bvh, Structure) {
+    TestBvh               bvh(randomBoxes(1000), 4);
+    std::vector<uint32_t> seen;
+    uint32_t              depth = 0;
+    auto                  visit = [&](auto& self, uint32_t index, uint32_t level) -> void {
+        const BvhNode& node = bvh.data.nodes[index];
+        depth = std::max(depth, level);
+        if (node.count == 0) {
+            self(self, index + 1, level + 1);
+            self(self, node.offset, level + 1);
+            return;
+        }
+        EXPECT_LE(node.count, 4u);
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            seen.push_back(bvh.data.items[i]);
+            const Aabb& box = bvh.bounds[bvh.data.items[i]];
+            EXPECT_TRUE(glm::all(glm::lessThanEqual(node.bounds.min, box.min)));
+            EXPECT_TRUE(glm::all(glm::lessThanEqual(box.max, node.bounds.max)));
+        }
+    };
+    visit(visit, 0, 0);
+    std::ranges::sort(seen);
+    ASSERT_EQ(seen.size(), 1000u);
+    for (uint32_t i = 0; i < seen.size(); ++i)
+        EXPECT_EQ(seen[i], i);
+    EXPECT_LT(depth, 32u);
+}
+
+TEST(Bvh, EmptyBoxesLeftOut) {
+    std::vector<Aabb> boxes = randomBoxes(3);
+    boxes.insert(boxes.begin() + 1, Aabb{});
+    BvhData data = buildBvh(boxes, 1);
+    EXPECT_EQ(data.items.size(), 3u);
+    EXPECT_EQ(std::ranges::count(data.items, 1u), 0);
+    EXPECT_TRUE(buildBvh(std::vector<Aabb>(2), 1).nodes.empty());
+}
+
+TEST(Bvh, CoincidentCenters) {
+    std::vector<Aabb> boxes(100);
+    for (Aabb& box : boxes) {
+        box.extend(glm::vec3(-1.0f));
+        box.extend(glm::vec3(1.0f));
+    }
+    BvhData data = buildBvh(boxes, 2);
+    for (const BvhNode& node : data.nodes)
+        EXPECT_LE(node.count, 2u);
+}
+
+TEST(Bvh, Queries) {
+    TestBvh bvh(randomBoxes(500), 4);
+
+    Aabb box;
+    box.extend(glm::vec3(-20.0f, -30.0f, -10.0f));
+    box.extend(glm::vec3(25.0f, 10.0f, 40.0f));
+    EXPECT_EQ(collect([&](auto fn) { queryBox(bvh.header, box, fn); }),
+              bruteForce(bvh.bounds, [&](const Aabb& b) {
+                  return glm::all(glm::lessThanEqual(b.min, box.max)) &&
+                         glm::all(glm::lessThanEqual(box.min, b.max));
+              }));
+
+    glm::vec3 center(10.0f, -5.0f, 3.0f);
+    EXPECT_EQ(collect([&](auto fn) { queryRange(bvh.header, center, 30.0f, fn); }),
+              bruteForce(bvh.bounds, [&](const Aabb& b) {
+                  glm::vec3 offset = glm::clamp(center, b.min, b.max) - center;
+                  return glm::dot(offset, offset) <= 30.0f * 30.0f;
+              }));
+
+    // Axis aligned planes make the frustum test exact
+    std::array<glm::vec4, 6> planes{
+        glm::vec4(1, 0, 0, 20),  glm::vec4(-1, 0, 0, 25), glm::vec4(0, 1, 0, 30),
+        glm::vec4(0, -1, 0, 10), glm::vec4(0, 0, 1, 10),  glm::vec4(0, 0, -1, 40),
+    };
+    EXPECT_EQ(collect([&](auto fn) { queryFrustum(bvh.header, planes, fn); }),
+              collect([&](auto fn) { queryBox(bvh.header, box, fn); }));
+
+    // A ray along x through the first box hits exactly the boxes spanning its
+    // y and z
+    glm::vec3             origin(-200.0f, bvh.bounds[0].center().y, bvh.bounds[0].center().z);
+    glm::vec3             direction(1.0f, 0.0f, 0.0f);
+    std::vector<uint32_t> hits =
+        collect([&](auto fn) { queryRay(bvh.header, origin, direction, 1000.0f, fn); });
+    EXPECT_EQ(hits, bruteForce(bvh.bounds, [&](const Aabb& b) {
+                  return b.min.y <= origin.y && origin.y <= b.max.y && b.min.z <= origin.z &&
+                         origin.z <= b.max.z;
+              }));
+    EXPECT_EQ(std::ranges::count(hits, 0u), 1);
+    EXPECT_TRUE(
+        collect([&](auto fn) { queryRay(bvh.header, origin, direction, 10.0f, fn); }).empty());
+}
+
+TEST(Bvh, TransformAabb) {
+    Aabb box;
+    box.extend(glm::vec3(1.0f, 2.0f, 3.0f));
+    box.extend(glm::vec3(2.0f, 4.0f, 6.0f));
+
+    // Rotate 90 degrees about z, then translate
+    glm::mat4 transform(0.0f);
+    transform[0] = glm::vec4(0, 1, 0, 0);
+    transform[1] = glm::vec4(-1, 0, 0, 0);
+    transform[2] = glm::vec4(0, 0, 1, 0);
+    transform[3] = glm::vec4(10, 20, 30, 1);
+    Aabb result = transformAabb(box, transform);
+    EXPECT_EQ(result.min, glm::vec3(6.0f, 21.0f, 33.0f));
+    EXPECT_EQ(result.max, glm::vec3(8.0f, 22.0f, 36.0f));
+    EXPECT_TRUE(transformAabb(Aabb{}, transform).empty());
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <optional>
+#include <rtrtool_cache.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace rtrtool;
+
+namespace {
+
+fs::path emptyDirectory(const std::string& name) {
+    fs::path result = fs::temp_directory_path() / name;
+    fs::remove_all(result);
+    return result;
+}
+
+void store(ArtifactCache& cache, uint64_t key, std::vector<uint8_t> payload) {
+    std::span<const uint8_t> parts[] = {payload};
+    cache.store(key, parts);
+}
+
+// Every file in the cache directory, which only ever holds entries once
+// store() returns
+std::vector<fs::path> files(const fs::path& directory) {
+    std::vector<fs::path> result;
+    for (const auto& entry : fs::directory_iterator(directory))
+        result.push_back(entry.path());
+    return result;
+}
+
+std::vector<uint8_t> readFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), {}};
+}
+
+void writeFile(const fs::path& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+}
+
+} // namespace
+
+TEST(Cache, StoreFind) {
+    fs::path      directory = emptyDirectory("rtrtool_test_cache");
+    ArtifactCache cache(directory, 1 << 20);
+    EXPECT_FALSE(cache.find(1));
+
+    std::vector<uint8_t>     a{1, 2, 3};
+    std::vector<uint8_t>     b{4, 5};
+    std::span<const uint8_t> parts[] = {a, b};
+    cache.store(1, parts);
+    std::optional<CacheEntry> entry = cache.find(1);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(std::vector<uint8_t>(entry->payload().begin(), entry->payload().end()),
+              std::vector<uint8_t>({1, 2, 3, 4, 5}));
+    EXPECT_FALSE(cache.find(2));
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(cache.misses(), 2u);
+    ASSERT_EQ(files(directory).size(), 1u);
+    EXPECT_EQ(files(directory)[0].extension(), ".bin");
+    fs::remove_all(directory);
+}
+
+// Damaged entries are misses rather than errors
+TEST(Cache, DamagedEntries) {
+    fs::path      directory = emptyDirectory("rtrtool_test_cache_damaged");
+    ArtifactCache cache(directory, 1 << 20);
+    store(cache, 1, std::vector<uint8_t>(64, 7));
+    fs::path             path = files(directory)[0];
+    std::vector<uint8_t> original = readFile(path);
+
+    // Truncated payload
+    writeFile(path, std::vector<uint8_t>(original.begin(), original.end() - 1));
+    EXPECT_FALSE(cache.find(1));
+
+    // Truncated header
+    writeFile(path, std::vector<uint8_t>(original.begin(), original.begin() + 8));
+    EXPECT_FALSE(cache.find(1));
+
+    // Damaged magic
+    std::vector<uint8_t> damaged = original;
+    damaged[0] ^= 0xFF;
+    writeFile(path, damaged);
+    EXPECT_FALSE(cache.find(1));
+
+    // Another key's entry under this key's name
+    store(cache, 2, std::vector<uint8_t>(64, 7));
+    writeFile(path, readFile(path.parent_path() / "0000000000000002.bin"));
+    EXPECT_FALSE(cache.find(1));
+    EXPECT_TRUE(cache.find(2));
+
+    writeFile(path, original);
+    EXPECT_TRUE(cache.find(1));
+    EXPECT_EQ(cache.hits(), 2u);
+    EXPECT_EQ(cache.misses(), 4u);
+    fs::remove_all(directory);
+}
+
+// trim() evicts the entries least recently stored or found until the
+// directory fits
+TEST(Cache, Trim) {
+    fs::path             directory = emptyDirectory("rtrtool_test_cache_trim");
+    std::vector<uint8_t> payload(100, 1);
+    {
+        ArtifactCache cache(directory, 1 << 20);
+        for (uint64_t key : {1, 2, 3})
+            store(cache, key, payload);
+    }
+    uint64_t entryBytes = fs::file_size(files(directory)[0]);
+    auto     now = fs::file_time_type::clock::now();
+    for (uint64_t key : {1, 2, 3})
+        fs::last_write_time(directory / ("000000000000000" + std::to_string(key) + ".bin"),
+                            now - std::chrono::hours(4 - key));
+
+    ArtifactCache cache(directory, entryBytes * 2);
+    EXPECT_TRUE(cache.find(1)); // now the most recently used
+    cache.trim();
+    EXPECT_EQ(cache.evictedBytes(), entryBytes);
+    EXPECT_EQ(files(directory).size(), 2u);
+    EXPECT_TRUE(cache.find(1));
+    EXPECT_FALSE(cache.find(2));
+    EXPECT_TRUE(cache.find(3));
+
+    // Within the limit, nothing is evicted
+    cache.trim();
+    EXPECT_EQ(files(directory).size(), 2u);
+    fs::remove_all(directory);
+}
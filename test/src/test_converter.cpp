@@ -0,0 +1,489 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <decodeless/pmr_writer.hpp>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <iterator>
+#include <rtr/material.hpp>
+#include <rtr/mesh.hpp>
+#include <rtr/scene.hpp>
+#include <rtrtool/bvh.hpp>
+#include <rtrtool/converter.hpp>
+#include <rtrtool/instancing.hpp>
+#include <rtrtool/optimizer.hpp>
+#include <rtrtool/world_transforms.hpp>
+#include <rtrtool_kernels.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace rtrtool;
+
+namespace {
+
+// Writes a glTF file with a single triangle mesh and one scene. parents[i] is
+// the index of node i's parent, which must be less than i, or -1 for a root.
+// Every node is translated by one along x and instances the mesh.
+fs::path writeGltf(const fs::path& directory, std::span<const int64_t> parents) {
+    fs::create_directories(directory);
+    {
+        const float    positions[] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+        const uint32_t indices[] = {0, 1, 2};
+        std::ofstream  bin(directory / "mesh.bin", std::ios::binary);
+        bin.write(reinterpret_cast<const char*>(positions), sizeof(positions));
+        bin.write(reinterpret_cast<const char*>(indices), sizeof(indices));
+    }
+
+    // Children as offsets into one array, to keep millions of nodes cheap
+    std::vector<uint32_t> childBegin(parents.size() + 1, 0);
+    for (int64_t parent : parents)
+        if (parent >= 0)
+            childBegin[size_t(parent) + 1]++;
+    for (size_t i = 0; i < parents.size(); ++i)
+        childBegin[i + 1] += childBegin[i];
+    std::vector<uint32_t> children(childBegin.back());
+    std::vector<uint32_t> childEnd(childBegin.begin(), childBegin.end() - 1);
+    std::vector<uint32_t> roots;
+    for (size_t i = 0; i < parents.size(); ++i) {
+        if (parents[i] >= 0)
+            children[childEnd[size_t(parents[i])]++] = uint32_t(i);
+        else
+            roots.push_back(uint32_t(i));
+    }
+
+    auto        list = [](std::span<const uint32_t> items) {
+        std::string result = "[";
+        for (size_t i = 0; i < items.size(); ++i)
+            result += (i ? "," : "") + std::to_string(items[i]);
+        return result + "]";
+    };
+    std::string json =
+        R"({"asset":{"version":"2.0"},)"
+        R"("buffers":[{"uri":"mesh.bin","byteLength":48}],)"
+        R"("bufferViews":[{"buffer":0,"byteLength":36},)"
+        R"({"buffer":0,"byteOffset":36,"byteLength":12}],)"
+        R"("accessors":[{"bufferView":0,"componentType":5126,"count":3,"type":"VEC3",)"
+        R"("min":[0,0,0],"max":[1,1,0]},)"
+        R"({"bufferView":1,"componentType":5125,"count":3,"type":"SCALAR"}],)"
+        R"("meshes":[{"primitives":[{"attributes":{"POSITION":0},"indices":1}]}],)"
+        R"("nodes":[)";
+    for (size_t i = 0; i < parents.size(); ++i) {
+        json += i ? ",{" : "{";
+        json += R"("mesh":0,"translation":[1,0,0])";
+        if (childBegin[i] != childBegin[i + 1])
+            json += R"(,"children":)" +
+                    list(std::span(children).subspan(childBegin[i],
+                                                     childBegin[i + 1] - childBegin[i]));
+        json += "}";
+    }
+    json += R"(],"scenes":[{"nodes":)" + list(roots) + R"(}],"scene":0})";
+    fs::path path = directory / "scene.gltf";
+    std::ofstream(path) << json;
+    return path;
+}
+
+// Writes a glTF file whose one buffer holds 'bin'. 'members' are the JSON
+// members after "asset" and "buffers", e.g. the accessors and meshes.
+fs::path writeGltf(const fs::path& directory, std::span<const std::byte> bin,
+                   const std::string& members) {
+    fs::create_directories(directory);
+    std::ofstream(directory / "data.bin", std::ios::binary)
+        .write(reinterpret_cast<const char*>(bin.data()), std::streamsize(bin.size()));
+    fs::path path = directory / "scene.gltf";
+    std::ofstream(path) << R"({"asset":{"version":"2.0"},"buffers":[{"uri":"data.bin",)"
+                        << R"("byteLength":)" << bin.size() << "}]," << members << "}";
+    return path;
+}
+
+// Writes a binary PPM whose bytes depend on 'seed'
+void writePpm(const fs::path& path, uint32_t width, uint32_t height, uint32_t seed) {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (uint32_t i = 0; i < width * height * 3; ++i)
+        file.put(char(i * 7 + seed * 31 + (i * i) % 13));
+}
+
+std::vector<char> readFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file),
+                             std::istreambuf_iterator<char>());
+}
+
+const rtr::RootHeader& root(const decodeless::pmr_memory_writer& memory) {
+    return *reinterpret_cast<const rtr::RootHeader*>(memory.data());
+}
+
+} // namespace
+
+// A chain deep enough to overflow the stack if converted recursively
+TEST(Converter, DeepHierarchy) {
+    constexpr int64_t    depth = 100000;
+    std::vector<int64_t> parents(depth);
+    for (int64_t i = 0; i < depth; ++i)
+        parents[size_t(i)] = i - 1;
+    fs::path path = writeGltf(fs::temp_directory_path() / "rtrtool_test_deep", parents);
+
+    decodeless::pmr_memory_writer memory(size_t(1) << 30);
+    convertFromGltf(memory.allocator(), path);
+    const auto* sceneHeader = root(memory).findSupported<rtr::SceneHeader>();
+    const auto* worldHeader = root(memory).findSupported<WorldTransformHeader>();
+    ASSERT_TRUE(sceneHeader);
+    ASSERT_TRUE(worldHeader);
+
+    // The scene's root node comes first, then the chain
+    ASSERT_EQ(sceneHeader->scenes.size(), 1u);
+    EXPECT_EQ(&*sceneHeader->scenes[0], &sceneHeader->nodes[0]);
+    EXPECT_EQ(sceneHeader->nodes[0].descendantCount, uint32_t(depth));
+    for (uint32_t i = 1; i <= depth; ++i) {
+        ASSERT_TRUE(sceneHeader->nodes[i].parentOffset);
+        EXPECT_EQ(*sceneHeader->nodes[i].parentOffset, 1u);
+        EXPECT_EQ(sceneHeader->nodes[i].descendantCount, uint32_t(depth) - i);
+    }
+    EXPECT_EQ(worldHeader->transforms[depth][3].x, float(depth));
+
+    // Attachments are made once each node's subtree is written, so the
+    // deepest node's instance is first
+    ASSERT_EQ(sceneHeader->instances.size(), size_t(depth));
+    EXPECT_EQ(sceneHeader->instances[0].node, uint32_t(depth));
+    EXPECT_EQ(sceneHeader->instances[depth - 1].node, 1u);
+    fs::remove_all(path.parent_path());
+}
+
+// Textures are encoded on a thread pool, but the written file is the same
+// byte for byte as a serial conversion. The last image has the same content
+// as the second, so deduplication is covered too.
+TEST(Converter, ParallelTexturesMatchSerial) {
+    const float    positions[] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+    const uint32_t indices[] = {0, 1, 2};
+    std::vector<std::byte> bin(sizeof(positions) + sizeof(indices));
+    std::memcpy(bin.data(), positions, sizeof(positions));
+    std::memcpy(bin.data() + sizeof(positions), indices, sizeof(indices));
+
+    fs::path directory = fs::temp_directory_path() / "rtrtool_test_jobs";
+    fs::create_directories(directory);
+    const uint32_t sizes[][2] = {{8, 8}, {6, 5}, {16, 4}, {3, 7}, {12, 12}, {6, 5}};
+    std::string    images = R"("images":[)";
+    std::string    textures = R"("textures":[)";
+    for (uint32_t i = 0; i < std::size(sizes); ++i) {
+        std::string name = "image" + std::to_string(i) + ".ppm";
+        writePpm(directory / name, sizes[i][0], sizes[i][1], i == 5 ? 1 : i);
+        images += std::string(i ? "," : "") + R"({"uri":")" + name + R"("})";
+        textures += std::string(i ? "," : "") + R"({"source":)" + std::to_string(i) + "}";
+    }
+    std::string materials = R"("materials":[)";
+    std::string primitives;
+    for (uint32_t i = 0; i < 3; ++i) {
+        materials += std::string(i ? "," : "") +
+                     R"({"pbrMetallicRoughness":{"baseColorTexture":{"index":)" +
+                     std::to_string(i * 2) + R"(},"metallicRoughnessTexture":{"index":)" +
+                     std::to_string(i * 2 + 1) + R"(}},"normalTexture":{"index":)" +
+                     std::to_string(5 - i) + "}}";
+        primitives += std::string(i ? "," : "") +
+                      R"({"attributes":{"POSITION":0},"indices":1,"material":)" +
+                      std::to_string(i) + "}";
+    }
+    fs::path path = writeGltf(
+        directory, bin,
+        images + "]," + textures + "]," + materials + "]," +
+            R"("bufferViews":[{"buffer":0,"byteLength":36},)"
+            R"({"buffer":0,"byteOffset":36,"byteLength":12}],)"
+            R"("accessors":[{"bufferView":0,"componentType":5126,"count":3,"type":"VEC3",)"
+            R"("min":[0,0,0],"max":[1,1,0]},)"
+            R"({"bufferView":1,"componentType":5125,"count":3,"type":"SCALAR"}],)"
+            R"("meshes":[{"primitives":[)" +
+            primitives + R"(]}],"nodes":[{"mesh":0}],"scenes":[{"nodes":[0]}],"scene":0)");
+
+    for (TextureCompression compression : {TextureCompression::none, TextureCompression::bc}) {
+        std::vector<char> outputs[2];
+        for (unsigned jobs : {1u, 8u}) {
+            ConvertOptions options;
+            options.jobs = jobs;
+            options.generateTangentSpace = false;
+            options.textureCompression = compression;
+            options.textureQuality = TextureQuality::fast;
+            ConvertStats stats;
+            fs::path     output = directory / ("jobs" + std::to_string(jobs) + ".rtr");
+            {
+                decodeless::pmr_file_writer file(output, size_t(1) << 26);
+                convertFromGltf(file.allocator(), path, options, &stats);
+            }
+            EXPECT_GT(stats.duplicateTextures, 0u);
+            outputs[jobs == 1 ? 0 : 1] = readFile(output);
+        }
+        ASSERT_GT(outputs[0].size(), 0u);
+        EXPECT_TRUE(outputs[0] == outputs[1]) << "compression " << int(compression);
+    }
+    fs::remove_all(directory);
+}
+
+// Data is laid out in the order it is first read and does not vary between
+// runs
+TEST(Converter, Layout) {
+    const int64_t parents[] = {-1, 0, 0, 1, -1};
+    fs::path      path = writeGltf(fs::temp_directory_path() / "rtrtool_test_layout", parents);
+
+    std::vector<ptrdiff_t> offsets[2];
+    for (std::vector<ptrdiff_t>& result : offsets) {
+        decodeless::pmr_memory_writer memory(size_t(1) << 26);
+        convertFromGltf(memory.allocator(), path);
+        auto offset = [&memory](const void* pointer) {
+            return reinterpret_cast<const std::byte*>(pointer) -
+                   reinterpret_cast<const std::byte*>(memory.data());
+        };
+        const auto* sceneHeader = root(memory).findSupported<rtr::SceneHeader>();
+        const auto* meshHeader = root(memory).findSupported<rtr::common::MeshHeader>();
+        const auto* materialHeader = root(memory).findSupported<rtr::common::MaterialHeader>();
+        ASSERT_TRUE(sceneHeader && meshHeader && materialHeader);
+        result = {offset(root(memory).headers.data()),
+                  offset(sceneHeader),
+                  offset(sceneHeader->instances.data()),
+                  offset(meshHeader),
+                  offset(meshHeader->meshes[0].vertexPositions.data()),
+                  offset(materialHeader)};
+        EXPECT_TRUE(std::ranges::is_sorted(result));
+    }
+    EXPECT_EQ(offsets[0], offsets[1]);
+    fs::remove_all(path.parent_path());
+}
+
+// Primitives without indices draw their vertices in order, here a quad as a
+// triangle list and as a strip. Lines and points are rejected.
+TEST(Converter, UnindexedPrimitives) {
+    const glm::vec3 positions[] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 0, 0}, {1, 1, 0},
+                                   {0, 1, 0}, {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+    fs::path        directory = fs::temp_directory_path() / "rtrtool_test_unindexed";
+    auto            write = [&](int mode) {
+        std::string members =
+            R"("bufferViews":[{"buffer":0,"byteLength":120}],)"
+            R"("accessors":[{"bufferView":0,"componentType":5126,"count":6,"type":"VEC3",)"
+            R"("min":[0,0,0],"max":[1,1,0]},)"
+            R"({"bufferView":0,"byteOffset":72,"componentType":5126,"count":4,"type":"VEC3",)"
+            R"("min":[0,0,0],"max":[1,1,0]}],)"
+            R"("meshes":[{"primitives":[{"attributes":{"POSITION":0},"mode":)" +
+            std::to_string(mode) + R"(},{"attributes":{"POSITION":1},"mode":5}]}],)"
+            R"("nodes":[{"mesh":0}],"scenes":[{"nodes":[0]}],"scene":0)";
+        return writeGltf(directory, std::as_bytes(std::span(positions)), members);
+    };
+
+    ConvertOptions options;
+    options.weld = true;
+    options.buildBvh = false;
+    ConvertStats                  stats;
+    decodeless::pmr_memory_writer memory(size_t(1) << 26);
+    convertFromGltf(memory.allocator(), write(4), options, &stats);
+    const auto* meshHeader = root(memory).findSupported<rtr::common::MeshHeader>();
+    ASSERT_TRUE(meshHeader);
+    ASSERT_EQ(meshHeader->meshes.size(), 2u);
+    EXPECT_EQ(stats.weldedVertices, 2u);
+    for (const rtr::common::Mesh& mesh : meshHeader->meshes) {
+        EXPECT_EQ(mesh.vertexPositions.size(), 4u);
+        ASSERT_EQ(mesh.triangleVertices.size(), 2u);
+    }
+
+    // The strip's second triangle keeps the first one's winding
+    const rtr::common::Mesh& strip = meshHeader->meshes[1];
+    EXPECT_EQ(strip.triangleVertices[0], glm::uvec3(0, 1, 2));
+    EXPECT_EQ(strip.triangleVertices[1], glm::uvec3(1, 3, 2));
+
+    decodeless::pmr_memory_writer lines(size_t(1) << 26);
+    EXPECT_THROW(convertFromGltf(lines.allocator(), write(1), options), std::runtime_error);
+    fs::remove_all(directory);
+}
+
+// Primitives that differ only by material share one mesh, and attributes are
+// converted from interleaved, normalized and 16-bit data into it in place
+TEST(Converter, SharedPrimitives) {
+    struct Vertex {
+        glm::vec3 position;
+        uint8_t   texCoord[2];
+        uint8_t   padding[2];
+    };
+    struct Bin {
+        Vertex   vertices[4];
+        uint16_t indices[6];
+    } bin{{{{0, 0, 0}, {0, 0}, {}},
+           {{1, 0, 0}, {255, 0}, {}},
+           {{1, 1, 0}, {255, 255}, {}},
+           {{0, 1, 0}, {0, 255}, {}}},
+          {0, 1, 2, 0, 2, 3}};
+    static_assert(sizeof(Vertex) == 16 && sizeof(Bin) == 76);
+    const std::string primitive =
+        R"({"attributes":{"POSITION":0,"TEXCOORD_0":1},"indices":2,"material":)";
+    fs::path directory = fs::temp_directory_path() / "rtrtool_test_shared";
+    fs::path path = writeGltf(
+        directory, std::as_bytes(std::span(&bin, 1)),
+        R"("bufferViews":[{"buffer":0,"byteLength":64,"byteStride":16},)"
+        R"({"buffer":0,"byteOffset":64,"byteLength":12}],)"
+        R"("accessors":[{"bufferView":0,"componentType":5126,"count":4,"type":"VEC3",)"
+        R"("min":[0,0,0],"max":[1,1,0]},)"
+        R"({"bufferView":0,"byteOffset":12,"componentType":5121,"normalized":true,"count":4,)"
+        R"("type":"VEC2"},)"
+        R"({"bufferView":1,"componentType":5123,"count":6,"type":"SCALAR"}],)"
+        R"("materials":[{},{}],)"
+        R"("meshes":[{"primitives":[)" +
+            primitive + "0}," + primitive + R"(1}]}],)"
+            R"("nodes":[{"mesh":0}],"scenes":[{"nodes":[0]}],"scene":0)");
+
+    ConvertOptions options;
+    options.generateTangentSpace = false;
+    ConvertStats                  stats;
+    decodeless::pmr_memory_writer memory(size_t(1) << 26);
+    convertFromGltf(memory.allocator(), path, options, &stats);
+    const auto* sceneHeader = root(memory).findSupported<rtr::SceneHeader>();
+    const auto* meshHeader = root(memory).findSupported<rtr::common::MeshHeader>();
+    ASSERT_TRUE(sceneHeader && meshHeader);
+    EXPECT_EQ(stats.duplicateMeshes, 1u);
+    ASSERT_EQ(meshHeader->meshes.size(), 1u);
+    ASSERT_EQ(sceneHeader->instances.size(), 2u);
+    EXPECT_EQ(sceneHeader->instances[0].mesh, 0u);
+    EXPECT_EQ(sceneHeader->instances[1].mesh, 0u);
+    EXPECT_NE(sceneHeader->instances[0].material, sceneHeader->instances[1].material);
+
+    const rtr::common::Mesh& mesh = meshHeader->meshes[0];
+    ASSERT_EQ(mesh.vertexPositions.size(), 4u);
+    ASSERT_EQ(mesh.vertexTexCoords0.size(), 4u);
+    ASSERT_EQ(mesh.triangleVertices.size(), 2u);
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(mesh.vertexPositions[i], bin.vertices[i].position);
+        EXPECT_EQ(mesh.vertexTexCoords0[i], glm::vec2(bin.vertices[i].texCoord[0] / 255,
+                                                      bin.vertices[i].texCoord[1] / 255));
+    }
+    EXPECT_EQ(mesh.triangleVertices[0], glm::uvec3(0, 1, 2));
+    EXPECT_EQ(mesh.triangleVertices[1], glm::uvec3(0, 2, 3));
+    fs::remove_all(directory);
+}
+
+// EXT_mesh_gpu_instancing copies become one instance group with a transform
+// per copy, composed from TRS accessors. Rotations here are normalized int16
+// and the last one is -32768, which clamps to -1.
+TEST(Converter, GpuInstancing) {
+    struct Bin {
+        float    positions[9];
+        uint32_t indices[3];
+        float    translations[9];
+        int16_t  rotations[12];
+        float    scales[9];
+    } bin{{0, 0, 0, 1, 0, 0, 0, 1, 0},
+          {0, 1, 2},
+          {0, 0, 0, 5, 0, 0, 0, -2, 3},
+          {0, 0, 0, 32767, 0, 0, 23170, 23170, -32768, 0, 0, 0},
+          {1, 1, 1, 2, 2, 2, -1, 1, 0.5f}};
+    static_assert(sizeof(Bin) == 144);
+    fs::path directory = fs::temp_directory_path() / "rtrtool_test_instancing";
+    fs::path path = writeGltf(
+        directory, std::as_bytes(std::span(&bin, 1)),
+        R"("extensionsUsed":["EXT_mesh_gpu_instancing"],)"
+        R"("bufferViews":[{"buffer":0,"byteLength":36},)"
+        R"({"buffer":0,"byteOffset":36,"byteLength":12},)"
+        R"({"buffer":0,"byteOffset":48,"byteLength":36},)"
+        R"({"buffer":0,"byteOffset":84,"byteLength":24},)"
+        R"({"buffer":0,"byteOffset":108,"byteLength":36}],)"
+        R"("accessors":[{"bufferView":0,"componentType":5126,"count":3,"type":"VEC3",)"
+        R"("min":[0,0,0],"max":[1,1,0]},)"
+        R"({"bufferView":1,"componentType":5125,"count":3,"type":"SCALAR"},)"
+        R"({"bufferView":2,"componentType":5126,"count":3,"type":"VEC3"},)"
+        R"({"bufferView":3,"componentType":5122,"normalized":true,"count":3,"type":"VEC4"},)"
+        R"({"bufferView":4,"componentType":5126,"count":3,"type":"VEC3"}],)"
+        R"("meshes":[{"primitives":[{"attributes":{"POSITION":0},"indices":1}]}],)"
+        R"("nodes":[{"mesh":0,"extensions":{"EXT_mesh_gpu_instancing":{"attributes":)"
+        R"({"TRANSLATION":2,"ROTATION":3,"SCALE":4}}}}],)"
+        R"("scenes":[{"nodes":[0]}],"scene":0)");
+
+    ConvertStats                  stats;
+    decodeless::pmr_memory_writer memory(size_t(1) << 26);
+    convertFromGltf(memory.allocator(), path, {}, &stats);
+    const auto* sceneHeader = root(memory).findSupported<rtr::SceneHeader>();
+    const auto* instancingHeader = root(memory).findSupported<InstancingHeader>();
+    ASSERT_TRUE(sceneHeader && instancingHeader);
+    EXPECT_EQ(stats.gpuInstances, 3u);
+    EXPECT_EQ(sceneHeader->instances.size(), 0u);
+    ASSERT_EQ(instancingHeader->groups.size(), 1u);
+    const InstanceGroup& group = instancingHeader->groups[0];
+    EXPECT_EQ(group.instance.mesh, 0u);
+    ASSERT_EQ(group.transforms.size(), 3u);
+
+    // Same mapping as the normalized accessor conversion
+    std::vector<float> rotations(12);
+    for (size_t i = 0; i < rotations.size(); ++i)
+        rotations[i] = std::max(float(bin.rotations[i]) / 32767.0f, -1.0f);
+    std::vector<glm::mat4x3> expected(3);
+    composeTransforms(bin.translations, rotations.data(), bin.scales, expected.size(),
+                      reinterpret_cast<float*>(expected.data()));
+    for (size_t i = 0; i < expected.size(); ++i)
+        for (glm::length_t c = 0; c < 4; ++c)
+            for (glm::length_t r = 0; r < 3; ++r)
+                EXPECT_NEAR(group.transforms[i][c][r], expected[i][c][r], 1e-5f)
+                    << "copy " << i << " column " << c << " row " << r;
+
+    // Spot check the composition itself: a quarter turn about z scaled by
+    // two, and a half turn about x with a mirrored scale
+    EXPECT_NEAR(group.transforms[1][0].y, 2.0f, 1e-3f);
+    EXPECT_NEAR(group.transforms[1][3].x, 5.0f, 1e-6f);
+    EXPECT_NEAR(group.transforms[2][0].x, -1.0f, 1e-6f);
+    EXPECT_NEAR(group.transforms[2][1].y, -1.0f, 1e-6f);
+    EXPECT_NEAR(group.transforms[2][2].z, -0.5f, 1e-6f);
+    fs::remove_all(directory);
+}
+
+// The instance BVH is rebuilt when optimizing rather than dropped as derived
+// data
+TEST(Converter, OptimizeKeepsBvh) {
+    const int64_t parents[] = {-1, 0, 0, 1};
+    fs::path      path = writeGltf(fs::temp_directory_path() / "rtrtool_test_bvh", parents);
+
+    decodeless::pmr_memory_writer converted(size_t(1) << 26);
+    convertFromGltf(converted.allocator(), path);
+    ASSERT_TRUE(root(converted).findSupported<BvhHeader>());
+
+    OptimizeOptions options;
+    options.passes = {OptimizePass::dedupeMeshes, OptimizePass::prune, OptimizePass::layout};
+    OptimizeStats                 stats;
+    decodeless::pmr_memory_writer optimized(size_t(1) << 26);
+    optimizeFile(optimized.allocator(), root(converted), options, &stats);
+    EXPECT_EQ(stats.droppedHeaders, 0u);
+    const auto* sceneHeader = root(optimized).findSupported<rtr::SceneHeader>();
+    const auto* bvhHeader = root(optimized).findSupported<BvhHeader>();
+    ASSERT_TRUE(sceneHeader && bvhHeader);
+    EXPECT_EQ(bvhHeader->meshBounds.size(), 1u);
+    ASSERT_EQ(bvhHeader->instanceBounds.size(), sceneHeader->instances.size());
+    EXPECT_GT(bvhHeader->nodes.size(), 0u);
+
+    // Every node is one further along x than its parent
+    for (size_t i = 0; i < sceneHeader->instances.size(); ++i) {
+        const Aabb& bounds = bvhHeader->instanceBounds[i];
+        EXPECT_GE(bounds.min.x, 1.0f);
+        EXPECT_LE(bounds.max.x, 4.0f);
+    }
+    fs::remove_all(path.parent_path());
+}
+
+// Measures hierarchy conversion throughput on a 10M node tree. Disabled by
+// default; run with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+TEST(Converter, DISABLED_Benchmark) {
+    constexpr size_t     count = 10000000;
+    constexpr size_t     branching = 8;
+    std::vector<int64_t> parents(count);
+    for (size_t i = 0; i < count; ++i)
+        parents[i] = i ? int64_t((i - 1) / branching) : -1;
+    fs::path path = writeGltf(fs::temp_directory_path() / "rtrtool_benchmark_nodes", parents);
+
+    for (bool buildBvh : {false, true}) {
+        ConvertOptions options;
+        options.buildBvh = buildBvh;
+        decodeless::pmr_memory_writer memory(size_t(16) << 30);
+        auto                          start = std::chrono::steady_clock::now();
+        convertFromGltf(memory.allocator(), path, options);
+        double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << count << " nodes" << (buildBvh ? " with a BVH" : "") << ": "
+                  << seconds * 1000.0 << " ms, " << double(count) / seconds << " nodes/s\n";
+    }
+    fs::remove_all(path.parent_path());
+}
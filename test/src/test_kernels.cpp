@@ -0,0 +1,215 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <rtrtool_cgltf.hpp>
+#include <rtrtool_kernels.hpp>
+#include <vector>
+
+using namespace rtrtool;
+
+namespace {
+
+std::vector<KernelLevel> supportedLevels() {
+    std::vector<KernelLevel> result;
+    for (KernelLevel level : {KernelLevel::scalar, KernelLevel::sse41, KernelLevel::avx2})
+        if (level <= kernelLevel())
+            result.push_back(level);
+    return result;
+}
+
+// Every value of the type, plus a tail that is not a multiple of the vector width
+template <class T>
+std::vector<T> allValues() {
+    std::vector<T> result(size_t(std::numeric_limits<T>::max()) -
+                          size_t(std::numeric_limits<T>::lowest()) + 1 + 13);
+    std::iota(result.begin(), result.end(), std::numeric_limits<T>::lowest());
+    return result;
+}
+
+template <class T>
+void testToFloat() {
+    std::vector<T> values = allValues<T>();
+    for (bool normalized : {false, true}) {
+        std::vector<float> expected(values.size());
+        toFloat(values.data(), values.size(), normalized, expected.data(), KernelLevel::scalar);
+        EXPECT_EQ(expected.back(), normalized ? float(values.back()) /
+                                                    float(std::numeric_limits<T>::max())
+                                              : float(values.back()));
+        if (normalized) {
+            EXPECT_EQ(expected[0], std::is_signed_v<T> ? -1.0f : 0.0f);
+            EXPECT_EQ(expected[size_t(std::numeric_limits<T>::max()) -
+                               size_t(std::numeric_limits<T>::lowest())],
+                      1.0f);
+        }
+        for (KernelLevel level : supportedLevels()) {
+            std::vector<float> result(values.size());
+            toFloat(values.data(), values.size(), normalized, result.data(), level);
+            EXPECT_EQ(result, expected) << "level " << int(level);
+        }
+    }
+}
+
+template <class T>
+void testWiden() {
+    std::vector<T> values = allValues<T>();
+    for (KernelLevel level : supportedLevels()) {
+        std::vector<uint32_t> result(values.size());
+        widen(values.data(), values.size(), result.data(), level);
+        EXPECT_TRUE(std::equal(result.begin(), result.end(), values.begin()))
+            << "level " << int(level);
+    }
+}
+
+} // namespace
+
+TEST(Kernels, Widen) {
+    testWiden<uint8_t>();
+    testWiden<uint16_t>();
+}
+
+TEST(Kernels, ToFloat) {
+    testToFloat<uint8_t>();
+    testToFloat<uint16_t>();
+    testToFloat<int8_t>();
+    testToFloat<int16_t>();
+}
+
+TEST(Kernels, Gather) {
+    for (size_t elementBytes : {2, 4, 8, 12, 16, 20}) {
+        size_t               stride = elementBytes + 4;
+        size_t               count = 37;
+        std::vector<uint8_t> src(stride * count);
+        std::iota(src.begin(), src.end(), uint8_t(0));
+        std::vector<uint8_t> result(elementBytes * count);
+        gather(src.data(), stride, elementBytes, count, result.data());
+        for (size_t i = 0; i < count; ++i)
+            for (size_t b = 0; b < elementBytes; ++b)
+                EXPECT_EQ(result[i * elementBytes + b], src[i * stride + b]);
+    }
+}
+
+// Only unsigned 8 and 16 bit indices are widened, others take the generic
+// conversion
+TEST(Kernels, ConvertIndices) {
+    float             floats[] = {0.0f, 7.0f, 65536.0f};
+    cgltf_buffer      buffer{};
+    cgltf_buffer_view view{};
+    cgltf_accessor    accessor{};
+    buffer.data = floats;
+    buffer.size = sizeof(floats);
+    view.buffer = &buffer;
+    view.size = sizeof(floats);
+    accessor.component_type = cgltf_component_type_r_32f;
+    accessor.type = cgltf_type_scalar;
+    accessor.count = 3;
+    accessor.stride = sizeof(float);
+    accessor.buffer_view = &view;
+    std::vector<uint32_t> result(3);
+    EXPECT_FALSE(convertFast(accessor, std::span(result)));
+    convertInto(accessor, std::span(result));
+    EXPECT_EQ(result, (std::vector<uint32_t>{0, 7, 65536}));
+
+    uint16_t shorts[] = {3, 65535, 9};
+    buffer.data = shorts;
+    accessor.component_type = cgltf_component_type_r_16u;
+    accessor.stride = sizeof(uint16_t);
+    EXPECT_TRUE(convertFast(accessor, std::span(result)));
+    EXPECT_EQ(result, (std::vector<uint32_t>{3, 65535, 9}));
+}
+
+TEST(Kernels, FaceNormals) {
+    std::mt19937                          rng(0);
+    std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+    std::vector<float>                    positions(300 * 3);
+    for (float& value : positions)
+        value = coord(rng);
+    std::vector<uint32_t> triangles(1001 * 3);
+    for (uint32_t& index : triangles)
+        index = uint32_t(rng() % 300);
+    std::vector<float> expected(positions.size(), 0.0f);
+    accumulateFaceNormals(positions.data(), 300, triangles.data(), 1001, expected.data(),
+                          KernelLevel::scalar);
+
+    // A single triangle's normal is the cross product of its edges
+    std::vector<float>    single(9, 0.0f);
+    std::vector<uint32_t> triangle = {0, 1, 2};
+    std::vector<float>    corners = {0, 0, 0, 2, 0, 0, 0, 3, 0};
+    accumulateFaceNormals(corners.data(), 3, triangle.data(), 1, single.data(),
+                          KernelLevel::scalar);
+    EXPECT_EQ(single, (std::vector<float>{0, 0, 6, 0, 0, 6, 0, 0, 6}));
+
+    for (KernelLevel level : supportedLevels()) {
+        std::vector<float> result(positions.size(), 0.0f);
+        accumulateFaceNormals(positions.data(), 300, triangles.data(), 1001, result.data(), level);
+        EXPECT_EQ(result, expected) << "level " << int(level);
+    }
+}
+
+TEST(Kernels, ComposeTransforms) {
+    // 90 degrees about z, scaled by 2, 3 and 4 and translated
+    const float        half = std::sqrt(0.5f);
+    std::vector<float> translations = {10, 20, 30};
+    std::vector<float> rotations = {0, 0, half, half};
+    std::vector<float> scales = {2, 3, 4};
+    std::vector<float> single(12);
+    composeTransforms(translations.data(), rotations.data(), scales.data(), 1, single.data(),
+                      KernelLevel::scalar);
+    std::vector<float> expected = {0, 2, 0, -3, 0, 0, 0, 0, 4, 10, 20, 30};
+    for (size_t i = 0; i < 12; ++i)
+        EXPECT_NEAR(single[i], expected[i], 1e-6f) << i;
+
+    // Random transforms, with a tail that is not a multiple of the vector
+    // width
+    constexpr size_t                      count = 1001;
+    std::mt19937                          rng(0);
+    std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+    translations.resize(count * 3);
+    rotations.resize(count * 4);
+    scales.resize(count * 3);
+    for (std::vector<float>* values : {&translations, &rotations, &scales})
+        for (float& v : *values)
+            v = value(rng);
+    std::vector<float> reference(count * 12);
+    composeTransforms(translations.data(), rotations.data(), scales.data(), count,
+                      reference.data(), KernelLevel::scalar);
+    for (KernelLevel level : supportedLevels()) {
+        std::vector<float> result(count * 12);
+        composeTransforms(translations.data(), rotations.data(), scales.data(), count,
+                          result.data(), level);
+        EXPECT_EQ(result, reference) << "level " << int(level);
+    }
+}
+
+// Compares the scalar and vectorized accessor conversions. Disabled by
+// default; run with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+TEST(Kernels, DISABLED_Benchmark) {
+    constexpr size_t      count = 64 << 20;
+    std::mt19937          rng(0);
+    std::vector<uint16_t> indices(count);
+    std::vector<int16_t>  normals(count);
+    for (size_t i = 0; i < count; ++i) {
+        indices[i] = uint16_t(rng());
+        normals[i] = int16_t(rng());
+    }
+    std::vector<uint32_t> widened(count);
+    std::vector<float>    floats(count);
+    for (KernelLevel level : supportedLevels()) {
+        auto start = std::chrono::steady_clock::now();
+        widen(indices.data(), count, widened.data(), level);
+        auto mid = std::chrono::steady_clock::now();
+        toFloat(normals.data(), count, true, floats.data(), level);
+        auto end = std::chrono::steady_clock::now();
+        auto ms = [](auto duration) {
+            return std::chrono::duration<double, std::milli>(duration).count();
+        };
+        std::cout << "level " << int(level) << ": widen u16 " << ms(mid - start)
+                  << " ms, normalized i16 to float " << ms(end - mid) << " ms\n";
+    }
+}
@@ -0,0 +1,192 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <decodeless/pmr_writer.hpp>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <ktx.h>
+#include <numeric>
+#include <rtrtool_ktx.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace rtrtool;
+
+namespace {
+
+// See the KTX2 spec
+struct Header {
+    uint8_t  identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+constexpr std::array<uint8_t, 12> Identifier = {0xAB, 'K', 'T', 'X', ' ', '2',
+                                                '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+template <class T>
+T read(std::span<const uint8_t> file, size_t offset) {
+    T result;
+    std::memcpy(&result, file.data() + offset, sizeof(result));
+    return result;
+}
+
+// Writes a binary PPM with a different value in every channel of every pixel
+fs::path writePpm(const fs::path& path, uint32_t width, uint32_t height) {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (uint32_t i = 0; i < width * height * 3; ++i)
+        file.put(char(i * 7));
+    return path;
+}
+
+// Expected texel block layout of an output
+struct Block {
+    uint32_t bytes;
+    uint32_t size = 1;
+};
+
+// Checks the container written by KtxSource::allocate() directly, then that
+// libktx loads it
+void checkFile(std::span<const uint8_t> file, uint32_t width, uint32_t height,
+               uint32_t levelCount, Block block) {
+    ASSERT_GE(file.size(), sizeof(Header));
+    EXPECT_TRUE(validKtxFile(file));
+    Header header = read<Header>(file, 0);
+    EXPECT_TRUE(std::ranges::equal(header.identifier, Identifier));
+    EXPECT_EQ(header.pixelWidth, width);
+    EXPECT_EQ(header.pixelHeight, height);
+    EXPECT_EQ(header.pixelDepth, 0u);
+    EXPECT_EQ(header.layerCount, 0u);
+    EXPECT_EQ(header.faceCount, 1u);
+    EXPECT_EQ(header.supercompressionScheme, 0u);
+    ASSERT_EQ(header.levelCount, levelCount);
+
+    // The DFD follows the level index and begins with its own size
+    const size_t levelIndexOffset = sizeof(Header);
+    EXPECT_EQ(header.dfdByteOffset, levelIndexOffset + levelCount * sizeof(LevelIndex));
+    EXPECT_EQ(read<uint32_t>(file, header.dfdByteOffset), header.dfdByteLength);
+
+    // One key/value entry, padded with zeros to 4 bytes
+    const std::string key = "KTXwriter";
+    const std::string value = "rtrtool";
+    const uint32_t    entryBytes = uint32_t(key.size() + value.size() + 2);
+    EXPECT_EQ(header.kvdByteOffset, header.dfdByteOffset + header.dfdByteLength);
+    EXPECT_EQ(header.kvdByteLength, (sizeof(uint32_t) + entryBytes + 3) / 4 * 4);
+    EXPECT_EQ(read<uint32_t>(file, header.kvdByteOffset), entryBytes);
+    const char* entry = reinterpret_cast<const char*>(file.data() + header.kvdByteOffset + 4);
+    EXPECT_EQ(std::string(entry), key);
+    EXPECT_EQ(std::string(entry + key.size() + 1), value);
+    for (size_t i = sizeof(uint32_t) + entryBytes; i < header.kvdByteLength; ++i)
+        EXPECT_EQ(file[header.kvdByteOffset + i], 0u);
+
+    // Levels are stored smallest first after the key/value data, each aligned
+    // to the texel block, and the last byte of the largest ends the file
+    const size_t alignment = std::lcm(size_t(block.bytes), size_t(4));
+    uint64_t     end = header.kvdByteOffset + header.kvdByteLength;
+    for (uint32_t level = levelCount; level-- > 0;) {
+        LevelIndex index = read<LevelIndex>(file, levelIndexOffset + level * sizeof(LevelIndex));
+        uint32_t   blocksX = (std::max(1u, width >> level) + block.size - 1) / block.size;
+        uint32_t   blocksY = (std::max(1u, height >> level) + block.size - 1) / block.size;
+        EXPECT_GE(index.byteOffset, end);
+        EXPECT_LT(index.byteOffset - end, alignment);
+        EXPECT_EQ(index.byteOffset % alignment, 0u);
+        EXPECT_EQ(index.byteLength, uint64_t(blocksX) * blocksY * block.bytes);
+        EXPECT_EQ(index.uncompressedByteLength, index.byteLength);
+        end = index.byteOffset + index.byteLength;
+    }
+    EXPECT_EQ(end, file.size());
+
+    ktxTexture2* texture = nullptr;
+    ASSERT_EQ(ktxTexture2_CreateFromMemory(file.data(), file.size(),
+                                           KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture),
+              KTX_SUCCESS);
+    EXPECT_EQ(texture->vkFormat, header.vkFormat);
+    EXPECT_EQ(texture->baseWidth, width);
+    EXPECT_EQ(texture->baseHeight, height);
+    EXPECT_EQ(texture->numLevels, levelCount);
+    EXPECT_EQ(ktxTexture_GetElementSize(ktxTexture(texture)), block.bytes);
+    unsigned int length = 0;
+    void*        written = nullptr;
+    EXPECT_EQ(ktxHashList_FindValue(&texture->kvDataHead, key.c_str(), &length, &written),
+              KTX_SUCCESS);
+    EXPECT_EQ(length, value.size() + 1);
+    ktxTexture_Destroy(ktxTexture(texture));
+}
+
+} // namespace
+
+// Uncompressed outputs with 1, 2 and 4 channels, with and without mipmaps
+TEST(Ktx, Uncompressed) {
+    fs::path directory = fs::temp_directory_path() / "rtrtool_test_ktx";
+    fs::path path = writePpm(directory / "image.ppm", 6, 5);
+    for (bool mipmaps : {false, true}) {
+        KtxSource source(path, KtxOptions{.mipmaps = mipmaps});
+        size_t    r = source.addOutput({.swizzle = "r"});
+        size_t    rg = source.addOutput({.swizzle = "rg"});
+        size_t    rgba = source.addOutput({.swizzle = "", .color = true});
+        source.prepare(false);
+        EXPECT_NE(source.outputHash(r), source.outputHash(rg));
+
+        decodeless::pmr_memory_writer memory(size_t(1) << 20);
+        std::span<uint8_t>            files[] = {source.allocate(memory.allocator(), r),
+                                                 source.allocate(memory.allocator(), rg),
+                                                 source.allocate(memory.allocator(), rgba)};
+        source.write();
+        uint32_t levels = mipmaps ? 3 : 1;
+        checkFile(files[0], 6, 5, levels, {1});
+        checkFile(files[1], 6, 5, levels, {2});
+        checkFile(files[2], 6, 5, levels, {4});
+
+        // The base level is stored last, so ends the file
+        const size_t base = files[0].size() - 6 * 5;
+        EXPECT_EQ(files[0][base + 0], 0u);
+        EXPECT_EQ(files[0][base + 1], 21u);
+        EXPECT_EQ(files[1][files[1].size() - 6 * 5 * 2 + 1], 7u);
+    }
+    fs::remove_all(directory);
+}
+
+// Block compressed outputs are sized in whole blocks before encoding
+TEST(Ktx, BlockCompressed) {
+    fs::path  directory = fs::temp_directory_path() / "rtrtool_test_ktx_bc";
+    fs::path  path = writePpm(directory / "image.ppm", 6, 5);
+    KtxSource source(path, KtxOptions{.quality = KtxQuality::fast});
+    size_t    bc7 = source.addOutput({.swizzle = "", .encoding = KtxEncoding::bc7, .color = true});
+    size_t    bc4 = source.addOutput({.swizzle = "r", .encoding = KtxEncoding::bc4});
+    source.prepare(true);
+
+    decodeless::pmr_memory_writer memory(size_t(1) << 20);
+    std::span<uint8_t>            bc7File = source.allocate(memory.allocator(), bc7);
+    std::span<uint8_t>            bc4File = source.allocate(memory.allocator(), bc4);
+    source.write();
+    checkFile(bc7File, 6, 5, 3, {16, 4});
+    checkFile(bc4File, 6, 5, 3, {8, 4});
+    fs::remove_all(directory);
+}
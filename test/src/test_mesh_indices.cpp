@@ -0,0 +1,42 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <gtest/gtest.h>
+#include <random>
+#include <rtrtool/mesh_indices.hpp>
+
+using namespace rtrtool;
+
+TEST(MeshIndices, RoundTrip) {
+    std::mt19937            rng(0);
+    std::vector<glm::uvec3> triangles;
+    for (uint32_t i = 0; i < 1000; ++i)
+        triangles.push_back(glm::uvec3(i, i + 1, i + rng() % 64));
+    triangles.push_back(glm::uvec3(0, 0xffffffffu, 0x80000000u));
+    std::vector<uint8_t>    encoded = encodeTriangles(triangles);
+    std::vector<glm::uvec3> decoded(triangles.size());
+    decodeTriangles(encoded, decoded);
+    EXPECT_EQ(decoded, triangles);
+
+    // Local indices take a byte each
+    std::span<const glm::uvec3> local = std::span(triangles).first(1000);
+    EXPECT_LT(encodeTriangles(local).size(), local.size() * 3 * 5 / 4);
+
+    // 16-bit output rejects large indices
+    std::vector<glm::u16vec3> narrow(local.size());
+    decodeTriangles(encodeTriangles(local), narrow);
+    EXPECT_EQ(narrow[999], glm::u16vec3(decoded[999]));
+    narrow.resize(triangles.size());
+    EXPECT_THROW(decodeTriangles(encoded, narrow), std::runtime_error);
+}
+
+TEST(MeshIndices, Malformed) {
+    std::vector<glm::uvec3> triangles = {{1, 2, 3}, {300, 2, 70000}};
+    std::vector<uint8_t>    encoded = encodeTriangles(triangles);
+    std::vector<glm::uvec3> decoded(triangles.size());
+    EXPECT_THROW(decodeTriangles(std::span(encoded).first(encoded.size() - 1), decoded),
+                 std::runtime_error);
+    encoded.push_back(0);
+    EXPECT_THROW(decodeTriangles(encoded, decoded), std::runtime_error);
+    std::vector<uint8_t> overlong(6, 0xff);
+    EXPECT_THROW(decodeTriangles(overlong, std::span(decoded).first(1)), std::runtime_error);
+}
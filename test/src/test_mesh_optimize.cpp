@@ -0,0 +1,118 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <array>
+#include <gtest/gtest.h>
+#include <random>
+#include <rtrtool_mesh_optimize.hpp>
+
+using namespace rtrtool;
+
+namespace {
+
+// Two triangles forming a quad, written unindexed as glTF exporters often do
+MeshData unindexedQuad() {
+    MeshData mesh;
+    mesh.vertexPositions = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 0, 0}, {1, 1, 0}, {0, 1, 0}};
+    mesh.vertexTexCoords0 = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+    mesh.triangleVertices = {{0, 1, 2}, {3, 4, 5}};
+    return mesh;
+}
+
+} // namespace
+
+TEST(MeshOptimize, Weld) {
+    MeshData mesh = unindexedQuad();
+    EXPECT_EQ(weldVertices(mesh, 0.0f), 2u);
+    EXPECT_EQ(mesh.vertexPositions.size(), 4u);
+    EXPECT_EQ(mesh.vertexTexCoords0.size(), 4u);
+    EXPECT_EQ(mesh.triangleVertices[0], glm::uvec3(0, 1, 2));
+    EXPECT_EQ(mesh.triangleVertices[1], glm::uvec3(0, 2, 3));
+    EXPECT_EQ(mesh.vertexPositions[3], glm::vec3(0, 1, 0));
+}
+
+TEST(MeshOptimize, WeldKeepsSeams) {
+    // Same position, different texture coordinates
+    MeshData mesh = unindexedQuad();
+    mesh.vertexTexCoords0[3] = {0.5f, 0.5f};
+    EXPECT_EQ(weldVertices(mesh, 0.0f), 1u);
+    EXPECT_EQ(mesh.vertexPositions.size(), 5u);
+}
+
+TEST(MeshOptimize, WeldEpsilon) {
+    MeshData mesh = unindexedQuad();
+    mesh.vertexPositions[3] = {0.001f, -0.001f, 0.0f};
+    EXPECT_EQ(weldVertices(mesh, 0.0f), 1u);
+    mesh = unindexedQuad();
+    mesh.vertexPositions[3] = {0.001f, -0.001f, 0.0f};
+    EXPECT_EQ(weldVertices(mesh, 0.01f), 2u);
+}
+
+TEST(MeshOptimize, Degenerates) {
+    MeshData mesh = unindexedQuad();
+    mesh.vertexPositions.push_back({2, 0, 0});
+    mesh.vertexTexCoords0.push_back({0, 0});
+    mesh.triangleVertices.push_back({0, 0, 1}); // repeated vertex
+    mesh.triangleVertices.push_back({0, 1, 6}); // collinear
+    EXPECT_EQ(removeDegenerateTriangles(mesh), 2u);
+    EXPECT_EQ(mesh.triangleVertices.size(), 2u);
+    EXPECT_EQ(removeUnusedVertices(mesh), 1u);
+    EXPECT_EQ(mesh.vertexPositions.size(), 6u);
+}
+
+TEST(MeshOptimize, IndexOutOfRange) {
+    MeshData mesh = unindexedQuad();
+    mesh.triangleVertices.push_back({0, 1, 6});
+    EXPECT_THROW(weldVertices(mesh, 0.0f), std::runtime_error);
+}
+
+namespace {
+
+// A regular grid of quads with its triangles shuffled
+MeshData shuffledGrid(uint32_t size) {
+    MeshData mesh;
+    for (uint32_t y = 0; y <= size; ++y)
+        for (uint32_t x = 0; x <= size; ++x)
+            mesh.vertexPositions.push_back({float(x), float(y), 0.0f});
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            uint32_t v = y * (size + 1) + x;
+            mesh.triangleVertices.push_back({v, v + 1, v + size + 2});
+            mesh.triangleVertices.push_back({v, v + size + 2, v + size + 1});
+        }
+    }
+    std::mt19937 rng(0);
+    std::ranges::shuffle(mesh.triangleVertices, rng);
+    return mesh;
+}
+
+// Triangles as positions, sorted, to compare meshes independent of order
+std::vector<std::array<float, 9>> sortedTriangles(const MeshData& mesh) {
+    std::vector<std::array<float, 9>> result;
+    for (const glm::uvec3& triangle : mesh.triangleVertices) {
+        std::array<float, 9>& corners = result.emplace_back();
+        for (glm::length_t c = 0; c < 3; ++c)
+            for (glm::length_t i = 0; i < 3; ++i)
+                corners[size_t(c * 3 + i)] = mesh.vertexPositions[triangle[c]][i];
+    }
+    std::ranges::sort(result);
+    return result;
+}
+
+} // namespace
+
+TEST(MeshOptimize, VertexCache) {
+    MeshData         mesh = shuffledGrid(64);
+    auto             expected = sortedTriangles(mesh);
+    VertexCacheStats before = analyzeVertexCache(mesh);
+    optimizeVertexCache(mesh);
+    optimizeVertexFetch(mesh);
+    VertexCacheStats after = analyzeVertexCache(mesh);
+    EXPECT_GT(before.acmr, 2.0f);
+    EXPECT_LT(after.acmr, 0.8f);
+    EXPECT_LT(after.atvr, before.atvr);
+    EXPECT_EQ(sortedTriangles(mesh), expected);
+
+    // Vertices are in order of first use
+    EXPECT_EQ(mesh.triangleVertices[0], glm::uvec3(0, 1, 2));
+}
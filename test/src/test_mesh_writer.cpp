@@ -0,0 +1,75 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <cstdint>
+#include <decodeless/pmr_writer.hpp>
+#include <gtest/gtest.h>
+#include <rtrtool_mesh_writer.hpp>
+#include <vector>
+
+using namespace rtrtool;
+
+// Identical arrays are written once and later copies point at the first
+TEST(MeshWriter, SharesIdenticalArrays) {
+    decodeless::pmr_memory_writer memory(size_t(1) << 20);
+    ArrayDeduplicator             deduplicator(memory.allocator());
+    const std::vector<uint32_t>   a = {1, 2, 3, 4};
+    const std::vector<uint32_t>   b = a;
+    const std::vector<uint32_t>   c = {1, 2, 3, 5};
+    std::span<uint32_t>           first = deduplicator.write(a);
+    std::span<uint32_t>           second = deduplicator.write(b);
+    std::span<uint32_t>           third = deduplicator.write(c);
+    EXPECT_EQ(first.data(), second.data());
+    EXPECT_EQ(second.size(), b.size());
+    EXPECT_NE(first.data(), third.data());
+    EXPECT_TRUE(std::ranges::equal(third, c));
+    EXPECT_EQ(deduplicator.duplicates(), 1u);
+    EXPECT_EQ(deduplicator.duplicateBytes(), a.size() * sizeof(uint32_t));
+
+    // Empty arrays are not written or counted
+    EXPECT_TRUE(deduplicator.write(std::vector<uint32_t>{}).empty());
+    EXPECT_EQ(deduplicator.duplicates(), 1u);
+}
+
+// Equal bytes are only shared between types with the same element size and
+// alignment, so a reused array is valid for the new type
+TEST(MeshWriter, KeepsOtherElementTypes) {
+    decodeless::pmr_memory_writer   memory(size_t(1) << 20);
+    ArrayDeduplicator               deduplicator(memory.allocator());
+    const std::vector<uint16_t>     shorts = {1, 0, 2, 0, 3, 0};
+    const std::vector<uint32_t>     ints = {1, 2, 3};
+    const std::vector<glm::u16vec3> vectors = {{1, 0, 2}, {0, 3, 0}};
+    const std::vector<uint8_t>      bytes(reinterpret_cast<const uint8_t*>(ints.data()),
+                                          reinterpret_cast<const uint8_t*>(ints.data() + 3));
+    std::span<uint16_t>             shortsWritten = deduplicator.write(shorts);
+    std::span<uint32_t>             intsWritten = deduplicator.write(ints);
+    std::span<glm::u16vec3>         vectorsWritten = deduplicator.write(vectors);
+    std::span<uint8_t>              bytesWritten = deduplicator.write(bytes);
+    const void*                     pointers[] = {shortsWritten.data(), intsWritten.data(),
+                                                  vectorsWritten.data(), bytesWritten.data()};
+    for (size_t i = 0; i < 4; ++i)
+        for (size_t j = i + 1; j < 4; ++j)
+            EXPECT_NE(pointers[i], pointers[j]);
+    EXPECT_EQ(deduplicator.duplicates(), 0u);
+    EXPECT_EQ(deduplicator.duplicateBytes(), 0u);
+}
+
+// Meshes share the arrays they have in common
+TEST(MeshWriter, SharesMeshArrays) {
+    decodeless::pmr_memory_writer memory(size_t(1) << 20);
+    ArrayDeduplicator             deduplicator(memory.allocator());
+    MeshData                      a;
+    a.triangleVertices = {{0, 1, 2}};
+    a.vertexPositions = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+    a.vertexNormals = {{0, 0, 1}, {0, 0, 1}, {0, 0, 1}};
+    MeshData b = a;
+    b.vertexNormals = {{0, 0, -1}, {0, 0, -1}, {0, 0, -1}};
+    MeshArrays first = deduplicator.write(a);
+    MeshArrays second = deduplicator.write(b);
+    EXPECT_EQ(first.triangleVertices.data(), second.triangleVertices.data());
+    EXPECT_EQ(first.vertexPositions.data(), second.vertexPositions.data());
+    EXPECT_NE(first.vertexNormals.data(), second.vertexNormals.data());
+    EXPECT_EQ(deduplicator.duplicates(), 2u);
+    EXPECT_EQ(deduplicator.duplicateBytes(),
+              sizeof(glm::uvec3) + a.vertexPositions.size() * sizeof(glm::vec3));
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <gtest/gtest.h>
+#include <rtrtool_meshlets.hpp>
+
+using namespace rtrtool;
+
+namespace {
+
+// A flat grid in the XY plane, facing +Z
+void grid(uint32_t size, std::vector<glm::uvec3>& triangles, std::vector<glm::vec3>& positions) {
+    for (uint32_t y = 0; y <= size; ++y)
+        for (uint32_t x = 0; x <= size; ++x)
+            positions.push_back(glm::vec3(float(x), float(y), 0.0f));
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            uint32_t i = y * (size + 1) + x;
+            triangles.push_back(glm::uvec3(i, i + 1, i + size + 2));
+            triangles.push_back(glm::uvec3(i, i + size + 2, i + size + 1));
+        }
+    }
+}
+
+bool backfacing(const Meshlet& meshlet, glm::vec3 eye) {
+    glm::vec3 d = meshlet.center - eye;
+    return glm::dot(d, meshlet.coneAxis) >=
+           meshlet.coneCutoff * (glm::length(d) + meshlet.radius) + meshlet.radius;
+}
+
+} // namespace
+
+TEST(Meshlets, Partition) {
+    std::vector<glm::uvec3> triangles;
+    std::vector<glm::vec3>  positions;
+    grid(32, triangles, positions);
+    MeshletData data = buildMeshlets(triangles, positions, 64, 124);
+    EXPECT_GT(data.meshlets.size(), triangles.size() / 124);
+
+    // Every triangle is in exactly one meshlet, in order, within the limits
+    std::vector<glm::uvec3> rebuilt;
+    for (const Meshlet& meshlet : data.meshlets) {
+        EXPECT_LE(meshlet.vertexCount, 64u);
+        EXPECT_LE(meshlet.triangleCount, 124u);
+        EXPECT_EQ(meshlet.triangleOffset, rebuilt.size());
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+            glm::u8vec3 local = data.triangles[meshlet.triangleOffset + t];
+            glm::uvec3  triangle;
+            for (glm::length_t c = 0; c < 3; ++c) {
+                EXPECT_LT(local[c], meshlet.vertexCount);
+                triangle[c] = data.vertices[meshlet.vertexOffset + local[c]];
+                EXPECT_LE(glm::length(positions[triangle[c]] - meshlet.center),
+                          meshlet.radius * 1.0001f);
+            }
+            rebuilt.push_back(triangle);
+        }
+    }
+    EXPECT_EQ(rebuilt, triangles);
+
+    EXPECT_THROW(buildMeshlets(triangles, positions, 257, 124), std::runtime_error);
+}
+
+TEST(Meshlets, NormalCone) {
+    std::vector<glm::uvec3> triangles;
+    std::vector<glm::vec3>  positions;
+    grid(4, triangles, positions);
+    MeshletData data = buildMeshlets(triangles, positions, 64, 124);
+    ASSERT_EQ(data.meshlets.size(), 1u);
+    const Meshlet& meshlet = data.meshlets[0];
+    EXPECT_NEAR(meshlet.coneAxis.z, 1.0f, 1e-6f);
+    EXPECT_NEAR(meshlet.coneCutoff, 0.0f, 1e-3f);
+    EXPECT_TRUE(backfacing(meshlet, glm::vec3(2, 2, -10)));
+    EXPECT_FALSE(backfacing(meshlet, glm::vec3(2, 2, 10)));
+    // Edge on, some triangles could be visible
+    EXPECT_FALSE(backfacing(meshlet, glm::vec3(100, 2, -0.01f)));
+
+    // Folded in half so the normals differ by 180 degrees: never culled
+    for (glm::vec3& position : positions)
+        if (position.x > 2.0f)
+            position = glm::vec3(4.0f - position.x, position.y, 0.0f);
+    data = buildMeshlets(triangles, positions, 64, 124);
+    EXPECT_EQ(data.meshlets[0].coneCutoff, 1.0f);
+    EXPECT_FALSE(backfacing(data.meshlets[0], glm::vec3(2, 2, -10)));
+}
+
+// Mirroring keeps the cone along the front faces' normals, as the viewer swaps
+// its front face to match. A grid facing +Z, mirrored in X, still faces an eye
+// on +Z.
+TEST(Meshlets, MirroredBackfaceTest) {
+    std::vector<glm::uvec3> triangles;
+    std::vector<glm::vec3>  positions;
+    grid(4, triangles, positions);
+    MeshletData    data = buildMeshlets(triangles, positions, 64, 124);
+    const Meshlet& meshlet = data.meshlets[0];
+    auto           culled = [&](const glm::mat4& localToEye) {
+        glm::vec3 center(localToEye * glm::vec4(meshlet.center, 1.0f));
+        return MeshletBackfaceTest(localToEye)(center, meshlet.radius, meshlet.coneAxis,
+                                               meshlet.coneCutoff);
+    };
+    glm::mat4 inFront = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, -10));
+    EXPECT_FALSE(culled(inFront));
+    EXPECT_FALSE(culled(glm::scale(inFront, glm::vec3(-1, 1, 1))));
+    EXPECT_TRUE(culled(glm::scale(inFront, glm::vec3(1, 1, -1))));
+    EXPECT_TRUE(culled(glm::scale(inFront, glm::vec3(-1, 1, -1))));
+
+    // Non-uniform scale is never culled
+    EXPECT_FALSE(culled(glm::scale(inFront, glm::vec3(1, 2, -1))));
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <rtrtool_mipmap.hpp>
+#include <vector>
+
+using namespace rtrtool;
+
+TEST(Mipmap, LevelCount) {
+    EXPECT_EQ(mipLevelCount(1, 1), 1u);
+    EXPECT_EQ(mipLevelCount(6, 5), 3u);
+    EXPECT_EQ(mipLevelCount(1, 8), 4u);
+}
+
+// Even sizes average pairs, halving to 3x1
+TEST(Mipmap, Even) {
+    const float src[] = {0, 2, 4, 6, 8, 10, 1, 3, 5, 7, 9, 11};
+    float       dst[3] = {};
+    downsample(PixelType::float32, 1, false, 6, 2, src, dst);
+    EXPECT_FLOAT_EQ(dst[0], 1.5f);
+    EXPECT_FLOAT_EQ(dst[1], 5.5f);
+    EXPECT_FLOAT_EQ(dst[2], 9.5f);
+}
+
+// Odd sizes round down, but every source texel still contributes equally
+TEST(Mipmap, Odd) {
+    const float five[] = {0, 5, 10, 15, 20};
+    float       two[2] = {};
+    downsample(PixelType::float32, 1, false, 5, 1, five, two);
+    EXPECT_FLOAT_EQ(two[0], 4.0f);  // (0 * 2 + 5 * 2 + 10) / 5
+    EXPECT_FLOAT_EQ(two[1], 16.0f); // (10 + 15 * 2 + 20 * 2) / 5
+    EXPECT_FLOAT_EQ(two[0] + two[1], (0.0f + 5.0f + 10.0f + 15.0f + 20.0f) * 2.0f / 5.0f);
+
+    // 3x3 filters to the mean, including the last row and column
+    std::vector<float> nine(9, 0.0f);
+    nine[8] = 9.0f;
+    float one = 0.0f;
+    downsample(PixelType::float32, 1, false, 3, 3, nine.data(), &one);
+    EXPECT_FLOAT_EQ(one, 1.0f);
+
+    // A dimension of one is kept while the other halves
+    const float column[] = {1, 2, 3};
+    downsample(PixelType::float32, 1, false, 1, 3, column, &one);
+    EXPECT_FLOAT_EQ(one, 2.0f);
+
+    // Integers round to nearest
+    const uint32_t ints[] = {1, 0xFFFFFFF0u, 0xFFFFFFF0u, 0xFFFFFFF3u, 0xFFFFFFF5u};
+    uint32_t       intDst[2] = {};
+    downsample(PixelType::uint32, 1, false, 1, 2, ints, intDst);
+    downsample(PixelType::uint32, 1, false, 3, 1, ints + 2, intDst + 1);
+    EXPECT_EQ(intDst[0], 0x7FFFFFF9u); // (1 + 0xFFFFFFF0) / 2, rounded up
+    EXPECT_EQ(intDst[1], 0xFFFFFFF3u);
+}
+
+// sRGB color is averaged in linear space, alpha and linear data directly
+TEST(Mipmap, Srgb) {
+    const uint8_t src[] = {0, 0, 0, 0, 255, 255, 255, 255};
+    uint8_t       linear[4] = {};
+    uint8_t       srgb[4] = {};
+    downsample(PixelType::unorm8, 4, false, 2, 1, src, linear);
+    downsample(PixelType::unorm8, 4, true, 2, 1, src, srgb);
+    EXPECT_EQ(linear[0], 128u);
+    EXPECT_EQ(linear[3], 128u);
+    EXPECT_EQ(srgb[0], 188u); // linear 0.5 encodes to about 0.735
+    EXPECT_EQ(srgb[2], 188u);
+    EXPECT_EQ(srgb[3], 128u);
+
+    const uint16_t src16[] = {0, 65535};
+    uint16_t       srgb16 = 0;
+    downsample(PixelType::unorm16, 1, true, 2, 1, src16, &srgb16);
+    EXPECT_NEAR(srgb16, 48192, 2);
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <gtest/gtest.h>
+#include <rtrtool/optimizer.hpp>
+#include <rtrtool_optimize.hpp>
+
+using namespace rtrtool;
+
+namespace {
+
+MeshData triangle(float x) {
+    MeshData result;
+    result.triangleVertices = {{0, 1, 2}};
+    result.vertexPositions = {{x, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+    return result;
+}
+
+rtr::common::Material material(uint32_t color, uint32_t normal) {
+    rtr::common::Material result{};
+    result.textures.color = color;
+    result.textures.normal = normal;
+    return result;
+}
+
+} // namespace
+
+TEST(Optimize, PassNames) {
+    for (OptimizePass pass : {OptimizePass::weld, OptimizePass::vertexCache,
+                              OptimizePass::dedupeMeshes, OptimizePass::dedupeTextures,
+                              OptimizePass::prune, OptimizePass::layout})
+        EXPECT_EQ(parseOptimizePass(optimizePassName(pass)), pass);
+    EXPECT_EQ(parseOptimizePass("vertex-cache"), OptimizePass::vertexCache);
+    EXPECT_FALSE(parseOptimizePass("bogus"));
+}
+
+TEST(Optimize, DeduplicateMeshes) {
+    OptimizeDocument document;
+    document.meshes = {triangle(0.0f), triangle(0.5f), triangle(0.0f)};
+    document.meshNames = {"a", "b", "c"};
+    document.instances = {{.node = 0, .mesh = 2, .material = 0},
+                          {.node = 0, .mesh = 1, .material = 0},
+                          {.node = 0, .mesh = 0, .material = 0}};
+    uint64_t before = documentBytes(document);
+    EXPECT_EQ(deduplicateMeshes(document), 1u);
+    ASSERT_EQ(document.meshes.size(), 2u);
+    EXPECT_EQ(document.meshNames, (std::vector<std::string>{"a", "b"}));
+    EXPECT_EQ(document.instances[0].mesh, 0u);
+    EXPECT_EQ(document.instances[1].mesh, 1u);
+    EXPECT_EQ(document.instances[2].mesh, 0u);
+    EXPECT_LT(documentBytes(document), before);
+}
+
+TEST(Optimize, DeduplicateTextures) {
+    const uint8_t    a[] = {1, 2, 3, 4};
+    const uint8_t    b[] = {1, 2, 3, 4};
+    const uint8_t    c[] = {1, 2, 3};
+    OptimizeDocument document;
+    document.textures = {a, c, b};
+    document.materials = {material(2, 1), material(0, 1)};
+    EXPECT_EQ(deduplicateTextures(document), 1u);
+    ASSERT_EQ(document.textures.size(), 2u);
+    EXPECT_EQ(*document.materials[0].textures.color, 0u);
+    EXPECT_EQ(*document.materials[0].textures.normal, 1u);
+    EXPECT_EQ(*document.materials[1].textures.color, 0u);
+    EXPECT_FALSE(document.materials[1].textures.metallic);
+}
+
+// Unpacked metallic and roughness textures with equal bytes still merge. The
+// viewer only reads roughness from the second channel of a shared texture
+// that has one.
+TEST(Optimize, DeduplicateMetallicRoughness) {
+    const uint8_t         metallic[] = {7, 7, 7, 7};
+    const uint8_t         roughness[] = {7, 7, 7, 7};
+    OptimizeDocument      document;
+    rtr::common::Material unpacked{};
+    unpacked.textures.metallic = 0;
+    unpacked.textures.roughness = 1;
+    document.textures = {metallic, roughness};
+    document.materials = {unpacked};
+    EXPECT_EQ(deduplicateTextures(document), 1u);
+    ASSERT_EQ(document.textures.size(), 1u);
+    EXPECT_EQ(document.textures[0].data(), metallic);
+    EXPECT_EQ(*document.materials[0].textures.metallic, 0u);
+    EXPECT_EQ(*document.materials[0].textures.roughness, 0u);
+}
+
+TEST(Optimize, PruneUnused) {
+    const uint8_t    bytes[] = {1, 2, 3, 4};
+    OptimizeDocument document;
+    document.meshes = {triangle(0.0f), triangle(0.5f), triangle(0.25f)};
+    document.meshNames = {"a", "b", "c"};
+    document.materials = {material(0, 0), material(1, 1), material(2, 0)};
+    document.textures = {bytes, bytes, bytes};
+    document.instances = {{.node = 0, .mesh = 2, .material = 2}};
+    EXPECT_EQ(pruneUnused(document), 5u);
+    EXPECT_EQ(document.meshNames, (std::vector<std::string>{"c"}));
+    ASSERT_EQ(document.materials.size(), 1u);
+    EXPECT_EQ(document.textures.size(), 2u);
+    EXPECT_EQ(document.instances[0].mesh, 0u);
+    EXPECT_EQ(document.instances[0].material, 0u);
+    EXPECT_EQ(*document.materials[0].textures.color, 1u);
+    EXPECT_EQ(*document.materials[0].textures.normal, 0u);
+}
+
+TEST(Optimize, PruneKeepsInstanceGroups) {
+    const glm::mat4x3 transforms[2]{};
+    OptimizeDocument  document;
+    document.meshes = {triangle(0.0f), triangle(0.5f), triangle(0.25f)};
+    document.materials = {rtr::common::Material{}, rtr::common::Material{}};
+    document.instances = {{.node = 0, .mesh = 0, .material = 0}};
+    document.instanceGroups = {{.node = 0, .mesh = 2, .material = 1}};
+    document.instanceTransforms = {transforms};
+    EXPECT_EQ(pruneUnused(document), 1u);
+    ASSERT_EQ(document.meshes.size(), 2u);
+    EXPECT_EQ(document.materials.size(), 2u);
+    EXPECT_EQ(document.instanceGroups[0].mesh, 1u);
+    EXPECT_EQ(document.instanceGroups[0].material, 1u);
+}
+
+TEST(Optimize, SortByFirstUse) {
+    const uint8_t    a[] = {1};
+    const uint8_t    b[] = {2};
+    OptimizeDocument document;
+    document.meshes = {triangle(0.0f), triangle(0.5f), triangle(0.25f)};
+    document.meshNames = {"a", "b", "c"};
+    document.materials = {material(0, 0), material(1, 0)};
+    document.textures = {a, b};
+    document.instances = {{.node = 0, .mesh = 2, .material = 1},
+                          {.node = 0, .mesh = 0, .material = 1}};
+    EXPECT_EQ(sortByFirstUse(document), 7u);
+    EXPECT_EQ(document.meshNames, (std::vector<std::string>{"c", "a", "b"}));
+    EXPECT_EQ(document.instances[0].mesh, 0u);
+    EXPECT_EQ(document.instances[1].mesh, 1u);
+    EXPECT_EQ(document.instances[0].material, 0u);
+    EXPECT_EQ(*document.materials[0].textures.color, 0u);
+    EXPECT_EQ(*document.materials[1].textures.color, 1u);
+    EXPECT_EQ(document.textures[0].data(), b);
+    EXPECT_EQ(sortByFirstUse(document), 0u);
+}
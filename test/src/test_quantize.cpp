@@ -0,0 +1,73 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <gtest/gtest.h>
+#include <random>
+#include <rtrtool_quantize.hpp>
+#include <vector>
+
+using namespace rtrtool;
+
+namespace {
+
+std::vector<glm::vec3> randomDirections(size_t count) {
+    std::mt19937                          rng(0);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::vector<glm::vec3>                result;
+    while (result.size() < count) {
+        glm::vec3 v(coord(rng), coord(rng), coord(rng));
+        float     length = glm::length(v);
+        if (length > 0.01f && length <= 1.0f)
+            result.push_back(v / length);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(Quantize, Octahedral) {
+    for (const glm::vec3& v : randomDirections(1000))
+        EXPECT_NEAR(glm::dot(octDecode(octEncode(v)), v), 1.0f, 1e-5f);
+    EXPECT_EQ(octDecode(octEncode(glm::vec3(0.0f))), glm::vec3(0, 0, 1));
+    EXPECT_EQ(octDecode(octEncode(glm::vec3(0, 0, -1))), glm::vec3(0, 0, -1));
+}
+
+TEST(Quantize, Normals) {
+    std::vector<glm::vec3>    normals = randomDirections(10000);
+    std::vector<glm::i16vec2> result(normals.size());
+    float                     error = quantizeNormals(normals, result);
+    EXPECT_GT(error, 0.0f);
+    EXPECT_LT(error, 0.01f);
+}
+
+TEST(Quantize, Tangents) {
+    std::vector<glm::vec4> tangents;
+    for (const glm::vec3& v : randomDirections(10000))
+        tangents.push_back(glm::vec4(v, tangents.size() % 2 ? 1.0f : -1.0f));
+    std::vector<glm::i8vec4> result(tangents.size());
+    EXPECT_LT(quantizeTangents(tangents, result), 1.0f);
+    EXPECT_EQ(result[0].z, -127);
+    EXPECT_EQ(result[1].z, 127);
+}
+
+TEST(Quantize, Positions) {
+    std::vector<glm::vec3>    positions = {{-2, 5, 1}, {6, 5, 3}, {0, 5, 2}};
+    std::vector<glm::u16vec4> result(positions.size());
+    glm::vec3                 offset, scale;
+    float                     error = quantizePositions(positions, result, offset, scale);
+    EXPECT_EQ(offset, glm::vec3(-2, 5, 1));
+    EXPECT_EQ(scale, glm::vec3(8, 0, 2));
+    EXPECT_EQ(result[0], glm::u16vec4(0, 0, 0, 0));
+    EXPECT_EQ(result[1], glm::u16vec4(65535, 0, 65535, 0));
+    EXPECT_LE(error, 8.0f / 65535.0f);
+    EXPECT_THROW(quantizePositions(positions, std::span(result).first(2), offset, scale),
+                 std::runtime_error);
+}
+
+TEST(Quantize, TexCoords) {
+    std::vector<glm::vec2>    texCoords = {{0.0f, 1.0f}, {0.5f, 0.25f}, {0.1f, 3.0f}};
+    std::vector<glm::u16vec2> result(texCoords.size());
+    float                     error = quantizeTexCoords(texCoords, result);
+    EXPECT_EQ(result[0], glm::u16vec2(0x0000, 0x3c00));
+    EXPECT_GT(error, 0.0f);
+    EXPECT_LT(error, 0.001f);
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <glm/ext/matrix_transform.hpp>
+#include <gtest/gtest.h>
+#include <optional>
+#include <rtrtool_scene.hpp>
+#include <stdexcept>
+
+using namespace rtrtool;
+
+namespace {
+
+rtr::Node node(const glm::vec3& translation, std::optional<uint32_t> parentOffset) {
+    rtr::Node result{};
+    result.transform = glm::translate(glm::identity<glm::mat4>(), translation);
+    if (parentOffset)
+        result.parentOffset = *parentOffset;
+    return result;
+}
+
+} // namespace
+
+TEST(Scene, FlattenHierarchy) {
+    // Two scenes: 0 -> {1 -> 2, 3} and 4 -> 5
+    std::vector<rtr::Node> nodes{
+        node({1, 0, 0}, std::nullopt), node({0, 2, 0}, 1), node({0, 0, 3}, 1),
+        node({0, 0, 4}, 3),            node({5, 0, 0}, std::nullopt), node({0, 6, 0}, 1),
+    };
+    WorldTransforms world = flattenHierarchy(nodes);
+    ASSERT_EQ(world.transforms.size(), nodes.size());
+    EXPECT_EQ(glm::vec3(world.transforms[2][3]), glm::vec3(1, 2, 3));
+    EXPECT_EQ(glm::vec3(world.transforms[3][3]), glm::vec3(1, 0, 4));
+    EXPECT_EQ(glm::vec3(world.transforms[5][3]), glm::vec3(5, 6, 0));
+    EXPECT_EQ(world.roots, (std::vector<uint32_t>{0, 0, 0, 0, 4, 4}));
+}
+
+TEST(Scene, ParentAfterChild) {
+    std::vector<rtr::Node> nodes{node({}, std::nullopt), node({}, 2)};
+    EXPECT_THROW(flattenHierarchy(nodes), std::runtime_error);
+}
+
+TEST(Scene, FirstUseOrder) {
+    const uint32_t uses[] = {3, 1, 3, 4, 1};
+    EXPECT_EQ(firstUseOrder(uses, 6), (std::vector<uint32_t>{3, 1, 4, 0, 2, 5}));
+    EXPECT_EQ(firstUseOrder({}, 3), (std::vector<uint32_t>{0, 1, 2}));
+    EXPECT_THROW(firstUseOrder(uses, 4), std::runtime_error);
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2025 Pyarelal Knowles, MIT License
+
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <rtrtool_simplify.hpp>
+
+using namespace rtrtool;
+
+namespace {
+
+// A grid in the XY plane, facing +Z, with an optional height function
+template <class Height>
+void grid(uint32_t size, Height height, std::vector<glm::uvec3>& triangles,
+          std::vector<glm::vec3>& positions) {
+    for (uint32_t y = 0; y <= size; ++y)
+        for (uint32_t x = 0; x <= size; ++x)
+            positions.push_back(glm::vec3(float(x), float(y), height(float(x), float(y))));
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            uint32_t i = y * (size + 1) + x;
+            triangles.push_back(glm::uvec3(i, i + 1, i + size + 2));
+            triangles.push_back(glm::uvec3(i, i + size + 2, i + size + 1));
+        }
+    }
+}
+
+float area(std::span<const glm::uvec3> triangles, std::span<const glm::vec3> positions) {
+    float result = 0.0f;
+    for (const glm::uvec3& t : triangles)
+        result += glm::cross(positions[t.y] - positions[t.x], positions[t.z] - positions[t.x]).z;
+    return result * 0.5f;
+}
+
+} // namespace
+
+TEST(Simplify, FlatGrid) {
+    std::vector<glm::uvec3> triangles;
+    std::vector<glm::vec3>  positions;
+    grid(16, [](float, float) { return 0.0f; }, triangles, positions);
+    std::vector<LodLevel> levels = buildLodChain(triangles, positions, {}, {}, {}, 16, 2);
+    ASSERT_FALSE(levels.empty());
+
+    // A plane simplifies without error down to very few triangles and the
+    // borders keep its outline, so the area is unchanged
+    EXPECT_LE(levels.back().triangles.size(), 8u);
+    for (const LodLevel& level : levels) {
+        EXPECT_NEAR(level.error, 0.0f, 1e-3f);
+        EXPECT_NEAR(area(level.triangles, positions), 16.0f * 16.0f, 1e-3f);
+        for (const glm::uvec3& t : level.triangles)
+            EXPECT_GT(glm::cross(positions[t.y] - positions[t.x], positions[t.z] - positions[t.x]).z,
+                      0.0f);
+    }
+}
+
+TEST(Simplify, HalvingLevels) {
+    std::vector<glm::uvec3> triangles;
+    std::vector<glm::vec3>  positions;
+    grid(
+        16, [](float x, float y) { return 2.0f * std::sin(x * 0.3f) * std::cos(y * 0.2f); },
+        triangles, positions);
+    std::vector<LodLevel> levels = buildLodChain(triangles, positions, {}, {}, {}, 4, 16);
+    ASSERT_EQ(levels.size(), 4u);
+    size_t previousTriangles = triangles.size();
+    float  previousError = 0.0f;
+    for (const LodLevel& level : levels) {
+        EXPECT_LE(level.triangles.size(), previousTriangles / 2);
+        EXPECT_GE(level.triangles.size(), previousTriangles / 2 - 2);
+        EXPECT_GE(level.error, previousError);
+        for (const glm::uvec3& t : level.triangles)
+            EXPECT_TRUE(t.x != t.y && t.y != t.z && t.z != t.x);
+        previousTriangles = level.triangles.size();
+        previousError = level.error;
+    }
+    EXPECT_GT(levels.back().error, 0.0f);
+}
+
+TEST(Simplify, SeamsLocked) {
+    // Two grids sharing an edge by position but not by vertex, e.g. a texture
+    // seam. The shared positions must not move.
+    std::vector<glm::uvec3> triangles;
+    std::vector<glm::vec3>  positions;
+    grid(8, [](float, float) { return 0.0f; }, triangles, positions);
+    std::vector<glm::uvec3> right;
+    std::vector<glm::vec3>  rightPositions;
+    grid(8, [](float, float) { return 0.0f; }, right, rightPositions);
+    uint32_t base = uint32_t(positions.size());
+    for (glm::vec3 p : rightPositions)
+        positions.push_back(p + glm::vec3(8.0f, 0.0f, 0.0f));
+    for (glm::uvec3 t : right)
+        triangles.push_back(t + base);
+    std::vector<LodLevel> levels = buildLodChain(triangles, positions, {}, {}, {}, 3, 2);
+    ASSERT_EQ(levels.size(), 3u);
+    for (uint32_t y = 0; y <= 8; ++y) {
+        uint32_t seamVertex = y * 9 + 8;
+        EXPECT_TRUE(std::ranges::any_of(levels.back().triangles, [&](const glm::uvec3& t) {
+            return t.x == seamVertex || t.y == seamVertex || t.z == seamVertex;
+        }));
+    }
+    EXPECT_NEAR(levels.back().error, 0.0f, 1e-3f);
+    EXPECT_NEAR(area(levels.back().triangles, positions), 16.0f * 8.0f, 1e-3f);
+}
+
+TEST(Simplify, OutOfRange) {
+    std::vector<glm::uvec3> triangles{{0, 1, 3}};
+    std::vector<glm::vec3>  positions(3);
+    EXPECT_THROW(buildLodChain(triangles, positions, {}, {}, {}, 4, 1), std::runtime_error);
+}